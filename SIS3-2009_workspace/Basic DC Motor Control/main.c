@@ -41,10 +41,16 @@
 #include <adc/adc.h>
 #include <pio/pio.h>
 #include <pit/pit.h>
+#include <pmc/pmc.h>
 #include <aic/aic.h>
 #include <dbgu/dbgu.h>
+#include <input/input.h>
 #include <pwmc/pwmc.h>
 #include <utility/trace.h>
+#include <utility/loop.h>
+#include <utility/sst.h>
+#include <utility/critical.h>
+#include <utility/timestamp.h>
 #include "lcd/lcd.h"
 
 #include <stdio.h>
@@ -73,17 +79,6 @@
     #define MIN_DUTY_CYCLE          0
 #endif
 
-#define DISABLE_INTERRUPTS \
-   asm volatile ( \
-         "DisInt:             \n\t" \
-         "mrs  r0, CPSR       \n\t"             /* Get CPSR                   */\
-         "orr  r0, r0, #0xC0  \n\t"             /* Disable IRQ, FIQ           */\
-         "msr  CPSR, r0       \n\t"             /* Write back modified value  */\
-         "mrs  r0, CPSR       \n\t"             /* Back from INT? Get CPSR    */\
-         "ands r0, r0, #0xC0  \n\t"             /* Check interrupts flags     */\
-         "beq  DisInt         \n\t"             /* Interrupts still enabled?  */\
-         : : : "r0" );                          /* Clobber list:  r0          */
-
 #define ENABLE_INTERRUPTS \
    asm volatile ( \
          "mrs  r0, CPSR       \n\t"             /* Get CPSR                   */\
@@ -133,6 +128,34 @@ static const Pin pins[] = {
 #define PINS_INDEX_TIOB2            12
 #define PINS_INDEX_SENSE            13
 
+/// The joystick and switch pins are handed to the input driver, which numbers
+/// them from the first one.
+#define PINS_INDEX_BUTTONS          PINS_INDEX_JOYSTICK_UP
+#define NUM_BUTTONS                 7
+#define BUTTON(index)               ((index) - PINS_INDEX_BUTTONS)
+
+/// PIT periods a button must be stable before a press or release counts.
+#define DEBOUNCE_PERIODS            2
+
+/// PIT periods (100 ms) from the start to the first control period, and
+/// between two toggles of the heartbeat.
+#define STARTUP_PERIODS             10
+#define HEARTBEAT_PERIODS           10
+
+/// PIT periods between two reports of the load on the DBGU.
+#define LOAD_PERIODS                100
+
+/// PIT periods between two polls of the DBGU for a command, and critical
+/// section sites the 'p' command prints.
+#define COMMAND_PERIODS             1
+#define PROFILE_SITES               8
+
+/// Interrupt source (of the SSC, which is not used) and AIC priority of the
+/// control task, above the PIT, and the events its queue holds.
+#define CONTROL_SOURCE              AT91C_ID_SSC
+#define CONTROL_PRIORITY            AT91C_AIC_PRIOR_HIGHEST
+#define CONTROL_QUEUE_SIZE          4
+
 enum MotorDirection {
    Left,
    Right
@@ -143,12 +166,18 @@ enum MotorBreak {
    Off
 };
 
-enum SwitchState {
-   Released,
-   Pressed
-};
+static LoopTimer startTimer;
+static LoopTimer heartBeatTimer;
+static LoopTimer loadTimer;
+#if CRITICAL_PROFILE
+static LoopTimer commandTimer;
+#endif
 
-static volatile UBYTE periodFlag = 0;
+static SstTask controlTask;
+static void *controlQueue[CONTROL_QUEUE_SIZE];
+/// Set once the motor is started, the PIT interrupt then activates the
+/// control task every period.
+static volatile UBYTE running = 0;
 
 static UWORD mSpeed = 0;
 static UWORD setpoint = 0;
@@ -156,7 +185,6 @@ static unsigned short controlSignal = 0;
 static enum MotorDirection mDirection = Left;
 static enum MotorBreak mBreak = Off;
 static unsigned int mCurrent = 0;
-static enum SwitchState switchBreak = Released, switchDirection = Released;
 
 //------------------------------------------------------------------------------
 //         Local functions
@@ -171,64 +199,199 @@ static unsigned int ConvHex2mA( unsigned int valueToConvert )
     return( (ADC_VREF * valueToConvert)/0x3FF);
 }
 
+//  ****************************************************************************
+//     Interrupt handler for the Periodic Interval Timer (PIT)
+//  ****************************************************************************
+
+void ISR_System_Interrupt(void)
+{
+   unsigned int status;
+
+   // Get PIT status
+   status = PIT_GetStatus();
+
+   // Periodic interval has elapsed?
+   if ((status & AT91C_PITC_PITS) == AT91C_PITC_PITS) {
+      // acknowledge the interrupt, PICNT holds the periods elapsed since the
+      // last acknowledge
+      LOOP_Tick(PIT_GetPIVR() >> 20);
+      INPUT_Tick(LOOP_GetTicks());
+
+      // The control task preempts this handler and the loop as soon as it
+      // is posted
+      if (running) {
+         SST_Post(&controlTask, 0);
+      }
+   }
+}
+
+//  ****************************************************************************
+//     Timer and event handlers, run by the event loop
+//  ****************************************************************************
+
 //------------------------------------------------------------------------------
-/// Wait time in ms
+/// Toggles the 'LED'.
 //------------------------------------------------------------------------------
-void UTIL_Loop(unsigned int loop)
+static void HeartBeat(void *pArgument)
 {
-    while(loop--);	
+   static UBYTE heartBeat = 0;
+
+   heartBeat = !heartBeat;
+   LCDSetRect(3, 125, 6, 128, FILL, heartBeat ? WHITE : BLACK);
+   //Backlight(heartBeat);
 }
 
+//------------------------------------------------------------------------------
+/// Prints the load of the core and its wake ups on the DBGU.
+//------------------------------------------------------------------------------
+static void ShowLoad(void *pArgument)
+{
+   LoopLoad load;
+   unsigned int busy;
 
-void UTIL_WaitTimeInMs(unsigned int mck, unsigned int time_ms)
+   LOOP_GetLoad(&load);
+   busy = (load.total - load.idle) / (load.total / 1000);
+   printf("-- load %u.%u %%, %u wake ups --\n\r", busy / 10, busy % 10,
+          load.wakeups);
+}
+
+#if CRITICAL_PROFILE
+//------------------------------------------------------------------------------
+/// Runs the commands typed on the DBGU: 'p' prints the critical sections that
+/// held the interrupts back the longest, 'r' clears their statistics.
+//------------------------------------------------------------------------------
+static void Command(void *pArgument)
 {
-    register unsigned int i = 0;
-    i = (mck / 1000) * time_ms;
-    i = i / 3;
-    UTIL_Loop(i);
+   while (DBGU_IsRxReady()) {
+      switch (DBGU_GetChar()) {
+      case 'p':
+         CRITICAL_PrintProfile(PROFILE_SITES);
+         break;
+      case 'r':
+         CRITICAL_ResetProfile();
+         printf("-- Critical sections cleared --\n\r");
+         break;
+      }
+   }
 }
+#endif
 
 //------------------------------------------------------------------------------
-/// Wait time in us
+/// Shows the state of the motor.
 //------------------------------------------------------------------------------
-void UTIL_WaitTimeInUs(unsigned int mck, unsigned int time_us)
+static void Show(void *pArgument)
 {
-    volatile unsigned int i = 0;
-    i = (mck / 1000000) * time_us;
-    i = i / 3;
-    UTIL_Loop(i);
+   static char s[32];
+   enum MotorBreak motorBreak;
+   enum MotorDirection direction;
+   UWORD set, speed;
+   unsigned short control;
+   unsigned int current;
+   unsigned int sources;
+
+   // Take a consistent copy of the state, holding back only the control
+   // task that writes it, and the levels below
+   sources = CRITICAL_Raise(CONTROL_PRIORITY);
+   motorBreak = mBreak;
+   direction = mDirection;
+   set = setpoint;
+   speed = mSpeed;
+   control = controlSignal;
+   current = mCurrent;
+   CRITICAL_Restore(sources);
+
+   // The heartbeat is drawn by the loop too, the LCD needs no locking
+   sprintf(s, "Break: %s", motorBreak == Off ? "Off" : "On ");
+   LCDPutStr(s, 12, 10, SMALL, WHITE, BLACK);
+   sprintf(s, "Direction: %s", direction == Left ? "Left " : "Right");
+   LCDPutStr(s, 22, 10, SMALL, WHITE, BLACK);
+   sprintf(s, "Setpoint: %3u", set);
+   LCDPutStr(s, 32, 10, SMALL, WHITE, BLACK);
+   sprintf(s, "Speed: %3u", speed);
+   LCDPutStr(s, 42, 10, SMALL, WHITE, BLACK);
+   sprintf(s, "Control: %3u", control);
+   LCDPutStr(s, 52, 10, SMALL, WHITE, BLACK);
+   sprintf(s, "Current: %4u mA", current);
+   LCDPutStr(s, 62, 10, SMALL, WHITE, BLACK);
+}
+
+//------------------------------------------------------------------------------
+/// Starts driving the motor once the start up delay is over.
+//------------------------------------------------------------------------------
+static void Start(void *pArgument)
+{
+   // Set duty cycle of PWM2 and enable channel #2
+   PWMC_SetDutyCycle(CHANNEL_PWM2, MAX_DUTY_CYCLE - MIN_DUTY_CYCLE);
+   PWMC_EnableChannel(CHANNEL_PWM2);
+
+   running = 1;
 }
 
 //  ****************************************************************************
-//     Interrupt handler for the Periodic Interval Timer (PIT)
+//     Control task, preempts the loop
 //  ****************************************************************************
 
-void ISR_System_Interrupt(void)
+//------------------------------------------------------------------------------
+/// Runs one control period: senses the current and applies the buttons,
+/// then leaves the display of the state to the loop.
+//------------------------------------------------------------------------------
+static void Control(void *pEvent)
 {
-   unsigned int status;
-   volatile static UWORD counter = 0;
-
-   // Get PIT status
-   status = PIT_GetStatus();
+   InputEvent event;
+   unsigned int buttons;
 
-   // Periodic interval has elapsed?
-   if ((status & AT91C_PITC_PITS) == AT91C_PITC_PITS) {
-      // acknowledge the interrupt
-      PIT_GetPIVR();
+   // Sense the Motor Current
+   mCurrent = ConvHex2mA(ADC_GetConvertedData(AT91C_BASE_ADC, CHANNEL_ADC_2));
+   ADC_StartConversion(AT91C_BASE_ADC);
 
-      if (++counter == 10) {
-         // Toggle 'LED'
-         LCDSetRect(3, 125, 6, 128, FILL, WHITE);
-         //Backlight(1);
+   // Switch1 toggles the break, Switch2 the direction, once per press
+   while ( INPUT_GetEvent(&event) ) {
+      if ( event.type != INPUT_PRESS ) {
+         continue;
       }
-      else if (counter == 20) {
-         LCDSetRect(3, 125, 6, 128, FILL, BLACK);
-         //Backlight(0);
-         counter = 0;
+      if ( event.button == BUTTON(PINS_INDEX_SWITCH1) ) {
+         if ( mBreak == Off ) {
+            PIO_Set(&pins[PINS_INDEX_BREAK]);
+            mBreak = On;
+         }
+         else {
+            PIO_Clear(&pins[PINS_INDEX_BREAK]);
+            mBreak = Off;
+         }
+      }
+      else if ( event.button == BUTTON(PINS_INDEX_SWITCH2) ) {
+         if ( mDirection == Left ) {
+            PIO_Set(&pins[PINS_INDEX_DIRECTION]);
+            mDirection = Right;
+         }
+         else {
+            PIO_Clear(&pins[PINS_INDEX_DIRECTION]);
+            mDirection = Left;
+         }
       }
+   }
 
-      periodFlag = 1;
+   buttons = INPUT_GetState();
+
+   // Read Joystick Up
+   if ( buttons & (1 << BUTTON(PINS_INDEX_JOYSTICK_UP)) ) {
+      if (controlSignal < MAX_DUTY_CYCLE) {
+       controlSignal++;
+       // Set duty cycle of PWM2
+       PWMC_SetDutyCycle(CHANNEL_PWM2, MAX_DUTY_CYCLE - controlSignal);
+      }
+   }
+   // Read Joystick Down
+   if ( buttons & (1 << BUTTON(PINS_INDEX_JOYSTICK_DOWN)) ) {
+      if (controlSignal > MIN_DUTY_CYCLE) {
+       controlSignal--;
+       // Set duty cycle of PWM2
+       PWMC_SetDutyCycle(CHANNEL_PWM2, MAX_DUTY_CYCLE - controlSignal);
+      }
    }
+
+   // Skipped if the loop is that far behind, the next period shows it
+   LOOP_Post(Show, 0);
 }
 
 //------------------------------------------------------------------------------
@@ -240,8 +403,6 @@ void ISR_System_Interrupt(void)
 //------------------------------------------------------------------------------
 int main(void)
 {
-   static char s[32];
-
    PIO_Configure(pins, PIO_LISTSIZE(pins));
 
    TRACE_CONFIGURE(DBGU_STANDARD, 115200, BOARD_MCK);
@@ -249,12 +410,12 @@ int main(void)
    printf("-- %s\n\r", BOARD_NAME);
    printf("-- Compiled: %s %s --\n\r", __DATE__, __TIME__);
 
-   UTIL_WaitTimeInMs(BOARD_MCK, 1000);
-   UTIL_WaitTimeInUs(BOARD_MCK, 1000);
-
    // Enable PWMC peripheral clock
    AT91C_BASE_PMC->PMC_PCER = 1 << AT91C_ID_PWMC;
 
+   // Start the time stamp, the LCD waits on it
+   TIMESTAMP_Initialize();
+
    // Initialize SPI interface to LCD
    InitSpi();
    // Init LCD
@@ -279,13 +440,14 @@ int main(void)
    // Set clock A to run at 100kHz * MAX_DUTY_CYCLE (clock B is not used)
    PWMC_ConfigureClocks(PWM_FREQUENCY * MAX_DUTY_CYCLE, 0, BOARD_MCK);
 
-   // Configure PWMC channel for PWM2 (left-aligned)
+   // Configure PWMC channel for PWM2 (left-aligned), enabled by Start()
    PWMC_ConfigureChannel(CHANNEL_PWM2, AT91C_PWMC_CPRE_MCKA, AT91C_PWMC_CALG, 0);
    PWMC_SetPeriod(CHANNEL_PWM2, MAX_DUTY_CYCLE);
-   PWMC_SetDutyCycle(CHANNEL_PWM2, MAX_DUTY_CYCLE - MIN_DUTY_CYCLE);
 
-   // Enable channel #2
-   PWMC_EnableChannel(CHANNEL_PWM2);
+   // The core sleeps whenever the loop has nothing to do, until the next
+   // interrupt; the PIT periods are not stretched, every one of them
+   // activates the control task
+   LOOP_Initialize(PMC_DisableProcessorClock);
 
    // Init PIT and AIC
    // Configure PIT for 100 ms (us, MHz)
@@ -296,88 +458,30 @@ int main(void)
    AIC_EnableIT(AT91C_ID_SYS);
    PIT_EnableIT();
 
+   // Buttons interrupt on their edges and are debounced by the PIT
+   INPUT_Initialize(&pins[PINS_INDEX_BUTTONS], NUM_BUTTONS, 0, DEBOUNCE_PERIODS);
+
+   // Sensing and PWM run in a task of their own, so a long LCD render in the
+   // loop does not hold them back
+   SST_CreateTask(&controlTask, CONTROL_SOURCE, CONTROL_PRIORITY, Control,
+                  controlQueue, CONTROL_QUEUE_SIZE);
+
    // Clear the screen
    LCDClearScreen();
 
+   // The motor starts after a second, like it did after the start up wait
+   LOOP_StartTimer(&heartBeatTimer, HeartBeat, 0, HEARTBEAT_PERIODS,
+                   HEARTBEAT_PERIODS);
+   LOOP_StartTimer(&startTimer, Start, 0, STARTUP_PERIODS, 0);
+   LOOP_StartTimer(&loadTimer, ShowLoad, 0, LOAD_PERIODS, LOAD_PERIODS);
+#if CRITICAL_PROFILE
+   LOOP_StartTimer(&commandTimer, Command, 0, COMMAND_PERIODS,
+                   COMMAND_PERIODS);
+#endif
+
    ENABLE_INTERRUPTS;
 
    // Infinite loop
-   while ( TRUE ) {
-      if ( periodFlag ) {
-         // Clear the flag
-         periodFlag = 0;
-
-         // Sense the Motor Current
-         mCurrent = ConvHex2mA(ADC_GetConvertedData(AT91C_BASE_ADC, CHANNEL_ADC_2));
-         ADC_StartConversion(AT91C_BASE_ADC);
-
-         // Read Switch1 - Break
-         if ( switchBreak == Released && !PIO_Get(&pins[PINS_INDEX_SWITCH1]) ) {
-            if ( mBreak == Off ) {
-               PIO_Set(&pins[PINS_INDEX_BREAK]);
-               mBreak = On;
-            }
-            else {
-               PIO_Clear(&pins[PINS_INDEX_BREAK]);
-               mBreak = Off;
-            }
-            switchBreak = Pressed;
-         }
-         else if ( PIO_Get(&pins[PINS_INDEX_SWITCH1]) ) {
-            switchBreak = Released;
-         }
-
-         // Read Switch2 - Direction
-         if ( switchDirection == Released && !PIO_Get(&pins[PINS_INDEX_SWITCH2]) ) {
-            if ( mDirection == Left ) {
-               PIO_Set(&pins[PINS_INDEX_DIRECTION]);
-               mDirection = Right;
-            }
-            else {
-               PIO_Clear(&pins[PINS_INDEX_DIRECTION]);
-               mDirection = Left;
-            }
-            switchDirection = Pressed;
-         }
-         else if ( PIO_Get(&pins[PINS_INDEX_SWITCH2]) ) {
-            switchDirection = Released;
-         }
-
-         // Read Joystick Up
-         if ( !PIO_Get(&pins[PINS_INDEX_JOYSTICK_UP]) ) {
-            if (controlSignal < MAX_DUTY_CYCLE) {
-             controlSignal++;
-             // Set duty cycle of PWM2
-             PWMC_SetDutyCycle(CHANNEL_PWM2, MAX_DUTY_CYCLE - controlSignal);
-            }
-         }
-         // Read Joystick Down
-         if ( !PIO_Get(&pins[PINS_INDEX_JOYSTICK_DOWN]) ) {
-            if (controlSignal > MIN_DUTY_CYCLE) {
-             controlSignal--;
-             // Set duty cycle of PWM2
-             PWMC_SetDutyCycle(CHANNEL_PWM2, MAX_DUTY_CYCLE - controlSignal);
-            }
-         }
-
-         DISABLE_INTERRUPTS;
-
-         sprintf(s, "Break: %s", mBreak == Off ? "Off" : "On ");
-         LCDPutStr(s, 12, 10, SMALL, WHITE, BLACK);
-         sprintf(s, "Direction: %s", mDirection == Left ? "Left " : "Right");
-         LCDPutStr(s, 22, 10, SMALL, WHITE, BLACK);
-         sprintf(s, "Setpoint: %3u", setpoint);
-         LCDPutStr(s, 32, 10, SMALL, WHITE, BLACK);
-         sprintf(s, "Speed: %3u", mSpeed);
-         LCDPutStr(s, 42, 10, SMALL, WHITE, BLACK);
-         sprintf(s, "Control: %3u", controlSignal);
-         LCDPutStr(s, 52, 10, SMALL, WHITE, BLACK);
-         sprintf(s, "Current: %4u mA", mCurrent);
-         LCDPutStr(s, 62, 10, SMALL, WHITE, BLACK);
-
-         ENABLE_INTERRUPTS;
-
-      }
-   }
+   LOOP_Run();
+   return 0;
 }
-
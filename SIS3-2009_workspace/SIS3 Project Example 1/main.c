@@ -14,7 +14,11 @@
 #include <pit/pit.h>
 #include <aic/aic.h>
 #include <dbgu/dbgu.h>
+#include <input/input.h>
 #include <utility/trace.h>
+#include <utility/loop.h>
+#include <utility/timestamp.h>
+#include <utility/critical.h>
 #include "lcd/lcd.h"
 
 #include <stdio.h>
@@ -24,15 +28,49 @@
 #include "criticalSection.h"
 
 
+//  ****************************************************************************
+//     Defines
+//  ****************************************************************************
+// Loop ticks (PIT periods of 10 ms) between two moves of the box, and
+// between two toggles of the heartbeat
+#define POLL_TICKS         2
+#define HEARTBEAT_TICKS    120
+// Loop ticks between two reports of the load on the DBGU
+#define LOAD_TICKS         1000
+// Loop ticks between two polls of the DBGU for a command, and critical
+// section sites the 'p' command prints
+#define COMMAND_TICKS      10
+#define PROFILE_SITES      8
+// PIT periods a button must be stable before a press or release counts
+#define DEBOUNCE_TICKS     2
+// Index of the switches among the buttons, after the joystick
+#define BUTTON_SWITCH1     (JOYSTICK_BUTTON + 1 + SWITCH1)
+#define BUTTON_SWITCH2     (JOYSTICK_BUTTON + 1 + SWITCH2)
+
+
 //  ****************************************************************************
 //     Consts
 //  ****************************************************************************
-//  PIO pins configuration
-static const Pin joystick_pins[] = {PINS_JOYSTICK};
-static const Pin switch_pins[]   = {PINS_SWITCH};
+//  PIO pins configuration; the buttons are watched by the input driver
+static const Pin button_pins[]   = {PINS_JOYSTICK, PINS_SWITCH};
 static const Pin debug_pins[]    = {PINS_DBGU};
 
 
+//  ****************************************************************************
+//     Globals
+//  ****************************************************************************
+static LoopTimer pollTimer;
+static LoopTimer heartBeatTimer;
+static LoopTimer loadTimer;
+
+#if CRITICAL_PROFILE
+static LoopTimer commandTimer;
+#endif
+
+// Position of the box
+static UBYTE x = 2, y = 0;
+
+
 //  ****************************************************************************
 //     Interrupt handler for the Periodic Interval Timer (PIT)
 //  ****************************************************************************
@@ -40,32 +78,157 @@ static const Pin debug_pins[]    = {PINS_DBGU};
 void ISR_System_Interrupt(void)
 {
    unsigned int status;
-   volatile static UBYTE heartBeat = 0;
-   volatile static UWORD counter = 0;
 
    // Get PIT status
    status = PIT_GetStatus();
 
    // Periodic interval has elapsed?
    if ((status & AT91C_PITC_PITS) == AT91C_PITC_PITS) {
-      // acknowledge the interrupt
-      PIT_GetPIVR();
-
-      if (counter++ > 10) {
-         // Toggle 'LED'
-         if (heartBeat) {
-            LCDSetRect(3, 125, 6, 128, FILL, WHITE);
-            //Backlight(1);
-            heartBeat = 0;
-         } else {
-            LCDSetRect(3, 125, 6, 128, FILL, BLACK);
-            //Backlight(0);
-            heartBeat = 1;
-         }
-         counter = 0;
+      // acknowledge the interrupt, PICNT holds the periods elapsed since the
+      // last acknowledge
+      LOOP_Tick(PIT_GetPIVR() >> 20);
+      INPUT_Tick(LOOP_GetTicks());
+   }
+}
+
+
+//  ****************************************************************************
+//     Timer handlers, run by the event loop
+//  ****************************************************************************
+
+// Prints the load of the core and its wake ups on the DBGU
+static void ShowLoad(void *pArgument)
+{
+   LoopLoad load;
+   unsigned int busy;
+
+   LOOP_GetLoad(&load);
+   busy = (load.total - load.idle) / (load.total / 1000);
+   printf("-- load %u.%u %%, %u wake ups --\n\r", busy / 10, busy % 10,
+          load.wakeups);
+}
+
+#if CRITICAL_PROFILE
+// Runs the commands typed on the DBGU: 'p' prints the critical sections that
+// held the interrupts back the longest, 'r' clears their statistics
+static void Command(void *pArgument)
+{
+   while (DBGU_IsRxReady()) {
+      switch (DBGU_GetChar()) {
+      case 'p':
+         CRITICAL_PrintProfile(PROFILE_SITES);
+         break;
+      case 'r':
+         CRITICAL_ResetProfile();
+         printf("-- Critical sections cleared --\n\r");
+         break;
       }
    }
 }
+#endif
+
+// Toggles the 'LED'
+static void HeartBeat(void *pArgument)
+{
+   static UBYTE heartBeat = 0;
+
+   if (heartBeat) {
+      LCDSetRect(3, 125, 6, 128, FILL, WHITE);
+      //Backlight(1);
+      heartBeat = 0;
+   } else {
+      LCDSetRect(3, 125, 6, 128, FILL, BLACK);
+      //Backlight(0);
+      heartBeat = 1;
+   }
+}
+
+// Moves the box while the joystick is held and redraws it; the joystick
+// button centers it, and the switches show the test screen and the picture,
+// once per press
+static void Poll(void *pArgument)
+{
+   static char s[32];
+   InputEvent event;
+   unsigned int buttons;
+   UBYTE testScreen = 0, picture = 0;
+
+   while ( INPUT_GetEvent(&event) ) {
+      if ( event.type != INPUT_PRESS ) {
+         continue;
+      }
+      if ( event.button == JOYSTICK_BUTTON ) {
+         x = 60;
+         y = 60;
+      }
+      else if ( event.button == BUTTON_SWITCH1 ) {
+         testScreen = 1;
+      }
+      else if ( event.button == BUTTON_SWITCH2 ) {
+         picture = 1;
+      }
+   }
+
+   buttons = INPUT_GetState();
+
+   if ( (buttons & (1 << JOYSTICK_UP)) && (x > 2))
+      x--;
+
+   if ( (buttons & (1 << JOYSTICK_DOWN)) && (x < 131-10))
+      x++;
+
+   if ( (buttons & (1 << JOYSTICK_RIGHT)) && (y < 129-10))
+      y++;
+
+   if ( (buttons & (1 << JOYSTICK_LEFT)) && (y > 0))
+      y--;
+
+   if ( testScreen ) {
+      // test screen
+      LCDClearScreen();
+
+      LCDSetPixel(30, 120, RED);
+      LCDSetPixel(34, 120, GREEN);
+      LCDSetPixel(38, 120, BLUE);
+      LCDSetPixel(42, 120, WHITE);
+
+      // draw some characters
+      LCDPutChar('E', 10, 10, SMALL, WHITE, BLACK);
+
+      // draw a string
+      LCDPutStr("Hello World", 60, 10, SMALL, WHITE, BLACK);
+      LCDPutStr("Hello World", 40, 10, MEDIUM, ORANGE, BLACK);
+      LCDPutStr("Hello World", 20, 10, LARGE, PINK, BLACK);
+
+      // draw a filled box
+      LCDSetRect(120, 60, 80, 80, FILL, BROWN);
+
+      // draw a empty box
+      LCDSetRect(120, 85, 80, 105, NOFILL, CYAN);
+
+      // draw some lines
+      LCDSetLine(120, 10, 120, 50, YELLOW);
+      LCDSetLine(120, 50, 80, 50, YELLOW);
+      LCDSetLine(80, 50, 80, 10, YELLOW);
+      LCDSetLine(80, 10, 120, 10, YELLOW);
+
+      LCDSetLine(120, 85, 80, 105, YELLOW);
+      LCDSetLine(80, 85, 120, 105, YELLOW);
+
+      // draw a circle
+      LCDSetCircle(65, 100, 10, RED);
+   }
+   if ( picture ) {
+      LCDWrite130x130bmp((unsigned char *)bmpSkyline);
+   }
+
+   sprintf(s, "x:%03u y:%03u", x, y);
+
+   LCDPutStr(s, 110, 10, SMALL, WHITE, BLACK);
+
+   LCDSetRect(x, y, x+10, y+10, FILL, BLUE);
+   LCDSetRect(x, y, x+10, y+10, NOFILL, WHITE);
+}
 
 
 //  ****************************************************************************
@@ -74,12 +237,8 @@ void ISR_System_Interrupt(void)
 
 int main(void)
 {
-   UBYTE x, y;
-   static char s[32];
-
    // Init input pins
-   PIO_Configure(joystick_pins, PIO_LISTSIZE(joystick_pins));
-   PIO_Configure(switch_pins, PIO_LISTSIZE(switch_pins));
+   PIO_Configure(button_pins, PIO_LISTSIZE(button_pins));
    PIO_Configure(debug_pins, PIO_LISTSIZE(debug_pins));
 
    TRACE_CONFIGURE(DBGU_STANDARD, 115200, BOARD_MCK);
@@ -87,22 +246,31 @@ int main(void)
    printf("-- %s\n\r", BOARD_NAME);
    printf("-- Compiled: %s %s --\n\r", __DATE__, __TIME__);
 
+   // Start the time stamp, the LCD waits on it
+   TIMESTAMP_Initialize();
+
    // Initialize SPI interface to LCD
    InitSpi();
 
    // Init LCD
    InitLcd();
 
+   // The core sleeps whenever the loop has nothing to do, through the tick
+   // interrupts that no timer waits for
+   LOOP_Initialize(LOOP_IdleTickless);
+
    // Init PIT and AIC
-   // Configure PIT for 100 ms (us, MHz)
-   PIT_Init(1, BOARD_MCK/10);
+   // Configure PIT for 10 ms (us, MHz)
+   PIT_Init(1, BOARD_MCK/100);
 
    // Enable PIT interrupt
    AIC_ConfigureIT(AT91C_ID_SYS, 0, ISR_System_Interrupt);
    AIC_EnableIT(AT91C_ID_SYS);
    PIT_EnableIT();
 
-   EnterCritical();
+   // Buttons interrupt on their edges and are debounced by the PIT
+   INPUT_Initialize(button_pins, PIO_LISTSIZE(button_pins), 0, DEBOUNCE_TICKS);
+
    // Clear the screen
    LCDClearScreen();
 
@@ -110,87 +278,21 @@ int main(void)
    LCDWrite130x130bmp((unsigned char *)bmpSkyline);
 
    LCDPutStr("Hello World", 10, 10, SMALL, WHITE, BLACK);
-   ExitCritical();
-
-   //while(1); // stop here
-
-   x = 2;
-   y = 0;
-   // loop forever
-   while (1) {
-      if ( !PIO_Get(&joystick_pins[JOYSTICK_UP]) && (x > 2))
-         x--;
-
-      if ( !PIO_Get(&joystick_pins[JOYSTICK_DOWN]) && (x < 131-10))
-         x++;
-
-      if ( !PIO_Get(&joystick_pins[JOYSTICK_RIGHT]) && (y < 129-10))
-         y++;
 
-      if ( !PIO_Get(&joystick_pins[JOYSTICK_LEFT]) && (y > 0))
-         y--;
+   // The LCD is only drawn by the loop handlers, one at a time, so it needs
+   // no critical section
+   LOOP_StartTimer(&heartBeatTimer, HeartBeat, 0, HEARTBEAT_TICKS,
+                   HEARTBEAT_TICKS);
+   LOOP_StartTimer(&loadTimer, ShowLoad, 0, LOAD_TICKS, LOAD_TICKS);
+   LOOP_StartTimer(&pollTimer, Poll, 0, 0, POLL_TICKS);
 
-      if ( !PIO_Get(&joystick_pins[JOYSTICK_BUTTON]) ) {
-         x = 60;
-         y = 60;
-      }
-
-      if ( !PIO_Get(&switch_pins[SWITCH1]) ) {
-         EnterCritical();
-         // test screen
-         LCDClearScreen();
-
-         LCDSetPixel(30, 120, RED);
-         LCDSetPixel(34, 120, GREEN);
-         LCDSetPixel(38, 120, BLUE);
-         LCDSetPixel(42, 120, WHITE);
-
-         // draw some characters
-         LCDPutChar('E', 10, 10, SMALL, WHITE, BLACK);
-
-         // draw a string
-         LCDPutStr("Hello World", 60, 10, SMALL, WHITE, BLACK);
-         LCDPutStr("Hello World", 40, 10, MEDIUM, ORANGE, BLACK);
-         LCDPutStr("Hello World", 20, 10, LARGE, PINK, BLACK);
-
-         // draw a filled box
-         LCDSetRect(120, 60, 80, 80, FILL, BROWN);
-
-         // draw a empty box
-         LCDSetRect(120, 85, 80, 105, NOFILL, CYAN);
-
-         // draw some lines
-         LCDSetLine(120, 10, 120, 50, YELLOW);
-         LCDSetLine(120, 50, 80, 50, YELLOW);
-         LCDSetLine(80, 50, 80, 10, YELLOW);
-         LCDSetLine(80, 10, 120, 10, YELLOW);
-
-         LCDSetLine(120, 85, 80, 105, YELLOW);
-         LCDSetLine(80, 85, 120, 105, YELLOW);
+#if CRITICAL_PROFILE
+   LOOP_StartTimer(&commandTimer, Command, 0, COMMAND_TICKS, COMMAND_TICKS);
+#endif
 
-         // draw a circle
-         LCDSetCircle(65, 100, 10, RED);
-         ExitCritical();
-      }
-      if ( !PIO_Get(&switch_pins[SWITCH2]) ) {
-         EnterCritical();
-         LCDWrite130x130bmp((unsigned char *)bmpSkyline);
-         ExitCritical();
-      }
-
-      sprintf(s, "x:%03u y:%03u", x, y);
+   ENABLE_INTERRUPTS;
 
-      EnterCritical();
-      LCDPutStr(s, 110, 10, SMALL, WHITE, BLACK);
-
-      LCDSetRect(x, y, x+10, y+10, FILL, BLUE);
-      LCDSetRect(x, y, x+10, y+10, NOFILL, WHITE);
-      ExitCritical();
-
-      Delay(100000);
-   }
+   // loop forever
+   LOOP_Run();
+   return 0;
 }
-
-
-
-
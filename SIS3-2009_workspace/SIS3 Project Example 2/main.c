@@ -15,8 +15,13 @@
 #include <pit/pit.h>
 #include <aic/aic.h>
 #include <dbgu/dbgu.h>
+#include <input/input.h>
 #include <pwmc/pwmc.h>
 #include <utility/trace.h>
+#include <utility/loop.h>
+#include <utility/timestamp.h>
+#include <utility/critical.h>
+#include <utility/fiq.h>
 #include "lcd/lcd.h"
 
 #include <stdio.h>
@@ -32,11 +37,23 @@
 #define BOARD_ADC_FREQ 5000000
 // PWM Settings
 #define MAX_FREQUENCY      11000 // Maximum frequency in Hz -> sound bandwidth
+// Loop ticks (PIT periods of 10 ms) between two measurements, and between two
+// toggles of the heartbeat
+#define UPDATE_TICKS       10
+#define HEARTBEAT_TICKS    120
+// Loop ticks between two reports of the load on the DBGU
+#define LOAD_TICKS         1000
+// Loop ticks between two polls of the DBGU for a command, and critical
+// section sites the 'p' command prints
+#define COMMAND_TICKS      10
+#define PROFILE_SITES      8
+// PIT periods a switch must be stable before a press or release counts
+#define DEBOUNCE_TICKS     2
 
 //  ****************************************************************************
 //     Consts
 //  ****************************************************************************
-//  PIO pins configuration
+//  PIO pins configuration; the switches are watched by the input driver
 static const Pin joystick_pins[] = {PINS_JOYSTICK};
 static const Pin switch_pins[]   = {PINS_SWITCH};
 static const Pin debug_pins[]    = {PINS_DBGU};
@@ -47,6 +64,14 @@ static const Pin other_pins[]    = {PIN_AUDIO_OUT};
 //  ****************************************************************************
 volatile unsigned int freq;
 
+static LoopTimer updateTimer;
+static LoopTimer heartBeatTimer;
+static LoopTimer loadTimer;
+
+#if CRITICAL_PROFILE
+static LoopTimer commandTimer;
+#endif
+
 //  ****************************************************************************
 //     Interrupt handler for the Periodic Interval Timer (PIT)
 //  ****************************************************************************
@@ -54,41 +79,27 @@ volatile unsigned int freq;
 void ISR_System_Interrupt(void)
 {
    unsigned int status;
-   volatile static UBYTE heartBeat = 0;
-   volatile static UWORD counter = 0;
 
    // Get PIT status
    status = PIT_GetStatus();
 
    // Periodic interval has elapsed?
    if ((status & AT91C_PITC_PITS) == AT91C_PITC_PITS) {
-      // acknowledge the interrupt
-      PIT_GetPIVR();
-
-      if (counter++ > 10) {
-         // Toggle 'LED'
-         if (heartBeat) {
-            LCDSetRect(3, 125, 6, 128, FILL, WHITE);
-            //Backlight(1);
-            heartBeat = 0;
-         } else {
-            LCDSetRect(3, 125, 6, 128, FILL, BLACK);
-            //Backlight(0);
-            heartBeat = 1;
-         }
-         counter = 0;
-      }
+      // acknowledge the interrupt, PICNT holds the periods elapsed since the
+      // last acknowledge
+      LOOP_Tick(PIT_GetPIVR() >> 20);
+      INPUT_Tick(LOOP_GetTicks());
    }
 }
 
 //  ****************************************************************************
-//     Audio handler
+//     Audio handler, on the FIQ
 //  ****************************************************************************
 
-void ISR_PWM_Interrupt(void)
+// The previous frequency is the state of the fast interrupt, it stays in a
+// banked register between two calls
+unsigned int ISR_PWM_Interrupt(unsigned int old_freq, void *pArgument)
 {
-   static unsigned int old_freq = 0;
-
    // Interrupt on channel #0
    if ( AT91C_BASE_PWMC->PWMC_ISR & AT91C_PWMC_CHID0 )
    {
@@ -104,19 +115,118 @@ void ISR_PWM_Interrupt(void)
          old_freq = freq;
       }
    }
+   return old_freq;
 }
 
 
 //  ****************************************************************************
-//     Main
+//     Timer handlers, run by the event loop
 //  ****************************************************************************
 
-int main(void)
+// Prints the load of the core and its wake ups on the DBGU
+static void ShowLoad(void *pArgument)
+{
+   LoopLoad load;
+   unsigned int busy;
+
+   LOOP_GetLoad(&load);
+   busy = (load.total - load.idle) / (load.total / 1000);
+   printf("-- load %u.%u %%, %u wake ups --\n\r", busy / 10, busy % 10,
+          load.wakeups);
+}
+
+#if CRITICAL_PROFILE
+// Runs the commands typed on the DBGU: 'p' prints the critical sections that
+// held the interrupts back the longest, 'r' clears their statistics
+static void Command(void *pArgument)
+{
+   while (DBGU_IsRxReady()) {
+      switch (DBGU_GetChar()) {
+      case 'p':
+         CRITICAL_PrintProfile(PROFILE_SITES);
+         break;
+      case 'r':
+         CRITICAL_ResetProfile();
+         printf("-- Critical sections cleared --\n\r");
+         break;
+      }
+   }
+}
+#endif
+
+// Toggles the 'LED'
+static void HeartBeat(void *pArgument)
+{
+   static UBYTE heartBeat = 0;
+
+   if (heartBeat) {
+      LCDSetRect(3, 125, 6, 128, FILL, WHITE);
+      //Backlight(1);
+      heartBeat = 0;
+   } else {
+      LCDSetRect(3, 125, 6, 128, FILL, BLACK);
+      //Backlight(0);
+      heartBeat = 1;
+   }
+}
+
+// Each press of SWITCH1 toggles the backlight and the sound; shows the
+// temperature and the trimmer, which sets the frequency
+static void Update(void *pArgument)
 {
    static UBYTE backlight = 1;
    static unsigned int temp, trim;
    static char s[32];
+   unsigned int cpsr;
+   InputEvent event;
+
+   while ( INPUT_GetEvent(&event) ) {
+      if ( event.type != INPUT_PRESS || event.button != SWITCH1 ) {
+         continue;
+      }
+      // The audio handler writes the same channel registers, and it runs on
+      // the FIQ, which only this holds back
+      cpsr = CRITICAL_Disable();
+      if ( backlight ) {
+         Backlight(0);
+         backlight = 0;
+
+         PWMC_DisableChannel(CHANNEL_PWM_AUDIO_OUT);
+      } else {
+         Backlight(1);
+         backlight = 1;
+
+         PWMC_SetPeriod(CHANNEL_PWM_AUDIO_OUT, freq);
+         PWMC_SetDutyCycle(CHANNEL_PWM_AUDIO_OUT, freq >> 1);
+         PWMC_EnableChannel(CHANNEL_PWM_AUDIO_OUT);
+      }
+      CRITICAL_Enable(cpsr);
+   }
+
+   temp = ADC_GetConvertedData(AT91C_BASE_ADC, CHANNEL_ADC_TEMP);
+   trim = ADC_GetConvertedData(AT91C_BASE_ADC, CHANNEL_ADC_TRIM);
+   // Start the conversion
+   ADC_StartConversion(AT91C_BASE_ADC);
+
+   temp = (temp * 10) / 19; // Celsius *10
+   snprintf(s, 14, "Temp: %3u.%1u", (temp/10), (temp%100)%10);
+
+   freq = ((218 * trim) / 1023) + 2; // frequencies from 100 - 11000 Hz
+
+   LCDPutStr(s, 12, 1, SMALL, WHITE, BLACK);
+   snprintf(s, 14, "Trim: %5u", trim);
+   LCDPutStr(s, 21, 1, SMALL, WHITE, BLACK);
+   snprintf(s, 14, "Freq: %5u", (2 * MAX_FREQUENCY) / freq);
+   LCDPutStr(s, 30, 1, SMALL, WHITE, BLACK);
+}
 
+
+//  ****************************************************************************
+//     Main
+//  ****************************************************************************
+
+int main(void)
+{
    // Init input pins
    PIO_Configure(joystick_pins, PIO_LISTSIZE(joystick_pins));
    PIO_Configure(switch_pins, PIO_LISTSIZE(switch_pins));
@@ -128,6 +238,9 @@ int main(void)
    printf("-- %s\n\r", BOARD_NAME);
    printf("-- Compiled: %s %s --\n\r", __DATE__, __TIME__);
 
+   // Start the time stamp, the LCD waits on it
+   TIMESTAMP_Initialize();
+
    // Initialize SPI interface to LCD
    InitSpi();
 
@@ -150,9 +263,13 @@ int main(void)
 
    ADC_StartConversion(AT91C_BASE_ADC);
 
+   // The core sleeps whenever the loop has nothing to do, through the tick
+   // interrupts that no timer waits for
+   LOOP_Initialize(LOOP_IdleTickless);
+
    // Init PIT and AIC
-   // Configure PIT for 100 ms (us, MHz)
-   PIT_Init(1, BOARD_MCK/10);
+   // Configure PIT for 10 ms (us, MHz)
+   PIT_Init(1, BOARD_MCK/100);
 
    // PWM Initialization
    // Enable PWMC peripheral clock
@@ -167,8 +284,10 @@ int main(void)
    //PWMC_SetPeriod(CHANNEL_PWM_AUDIO_OUT, MAX_DUTY_CYCLE);
    //PWMC_SetDutyCycle(CHANNEL_PWM_AUDIO_OUT, MAX_DUTY_CYCLE);
 
-   // Configure interrupt on channel #0
-   AIC_ConfigureIT(AT91C_ID_PWMC, 2, ISR_PWM_Interrupt);  // priority 2
+   // Configure interrupt on channel #0, on the FIQ: the sample rate
+   // interrupt goes without the AIC vector and the mode switch
+   FIQ_Configure(AT91C_ID_PWMC, AT91C_AIC_SRCTYPE_INT_HIGH_LEVEL,
+                 ISR_PWM_Interrupt, 0, 0);
    AIC_EnableIT(AT91C_ID_PWMC);
    PWMC_EnableChannelIt(CHANNEL_PWM_AUDIO_OUT);
 
@@ -180,7 +299,9 @@ int main(void)
    AIC_EnableIT(AT91C_ID_SYS);
    PIT_EnableIT();
 
-   EnterCritical();
+   // Switches interrupt on their edges and are debounced by the PIT
+   INPUT_Initialize(switch_pins, PIO_LISTSIZE(switch_pins), 0, DEBOUNCE_TICKS);
+
    // Clear the screen
    LCDClearScreen();
 
@@ -188,56 +309,20 @@ int main(void)
    LCDWrite130x130bmp((unsigned char *)bmpFullSpectrum);
    LCDPutStr("Press SWITCH1", 110, 1, SMALL, WHITE, BLACK);
 
-   ExitCritical();
-
-   //while(1); // stop here
-
-   // loop forever
-   while (1) {
-
-      if ( !PIO_Get(&switch_pins[SWITCH1]) ) {
-         EnterCritical();
+   // The LCD is only drawn by the loop handlers, one at a time, so it needs
+   // no critical section
+   LOOP_StartTimer(&heartBeatTimer, HeartBeat, 0, HEARTBEAT_TICKS,
+                   HEARTBEAT_TICKS);
+   LOOP_StartTimer(&loadTimer, ShowLoad, 0, LOAD_TICKS, LOAD_TICKS);
+   LOOP_StartTimer(&updateTimer, Update, 0, 0, UPDATE_TICKS);
 
-         if ( backlight ) {
-            Backlight(0);
-            backlight = 0;
+#if CRITICAL_PROFILE
+   LOOP_StartTimer(&commandTimer, Command, 0, COMMAND_TICKS, COMMAND_TICKS);
+#endif
 
-            PWMC_DisableChannel(CHANNEL_PWM_AUDIO_OUT);
-         } else {
-            Backlight(1);
-            backlight = 1;
+   ENABLE_INTERRUPTS;
 
-            PWMC_SetPeriod(CHANNEL_PWM_AUDIO_OUT, freq);
-            PWMC_SetDutyCycle(CHANNEL_PWM_AUDIO_OUT, freq >> 1);
-            PWMC_EnableChannel(CHANNEL_PWM_AUDIO_OUT);
-         }
-         ExitCritical();
-      }
-
-      temp = ADC_GetConvertedData(AT91C_BASE_ADC, CHANNEL_ADC_TEMP);
-      trim = ADC_GetConvertedData(AT91C_BASE_ADC, CHANNEL_ADC_TRIM);
-      // Start the conversion
-      ADC_StartConversion(AT91C_BASE_ADC);
-
-      temp = (temp * 10) / 19; // Celsius *10
-      snprintf(s, 14, "Temp: %3u.%1u", (temp/10), (temp%100)%10);
-
-      freq = ((218 * trim) / 1023) + 2; // frequencies from 100 - 11000 Hz
-
-      EnterCritical();
-      LCDPutStr(s, 12, 1, SMALL, WHITE, BLACK);
-      snprintf(s, 14, "Trim: %5u", trim);
-      LCDPutStr(s, 21, 1, SMALL, WHITE, BLACK);
-      snprintf(s, 14, "Freq: %5u", (2 * MAX_FREQUENCY) / freq);
-      LCDPutStr(s, 30, 1, SMALL, WHITE, BLACK);
-
-      ExitCritical();
-
-
-      Delay(1000000);
-   }
+   // loop forever
+   LOOP_Run();
+   return 0;
 }
-
-
-
-
@@ -0,0 +1,478 @@
+//------------------------------------------------------------------------------
+//         Placement AI
+//------------------------------------------------------------------------------
+//
+// The search works on a stripped down copy of the playfield (row masks and
+// column heights only). Feature extraction per placement:
+//    - row transitions: popcount of (row ^ row >> 1) over the field and the
+//      two wall bits next to it
+//    - column transitions: popcount of (row ^ row below) over the field
+//    - holes: popcount of the empty cells under the OR of all rows above
+//    - wells: empty cells whose left and right neighbours (or walls) are
+//      filled, i.e. ~row & row << 1 & row >> 1, summed as 1 + 2 + ... + depth
+//
+//------------------------------------------------------------------------------
+
+#include "ai.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// Row mask bits of the ten playfield columns.
+#define FIELD_BITS        (TETRIS_ROW_FULL & ~TETRIS_ROW_WALLS)
+
+/// Bits of (row ^ row >> 1) holding the transitions between the left wall,
+/// the ten columns and the right wall.
+#define TRANSITION_BITS   (FIELD_BITS | (FIELD_BITS >> 1))
+
+/// Score given to a placement when nothing better has been found yet.
+#define WORST_SCORE       ((SLONG) 0x80000000)
+
+//------------------------------------------------------------------------------
+//         Local types
+//------------------------------------------------------------------------------
+
+/// Playfield as seen by the search.
+typedef struct {
+
+    UWORD rows[TETRIS_ROWS + 4];
+    UBYTE heights[TETRIS_WIDTH];
+
+} Board;
+
+//------------------------------------------------------------------------------
+//         Global variables
+//------------------------------------------------------------------------------
+
+/// El-Tetris weights (landing height counted in half rows). Bumpiness is not
+/// part of that set and is left at zero, it is there for tuning.
+const AIWeights aiDefaultWeights = {
+    -2250,      // landingHeight
+     3418,      // erodedCells
+    -3218,      // rowTransitions
+    -9349,      // columnTransitions
+    -7899,      // holes
+    -3386,      // wells
+        0       // bumpiness
+};
+
+/// Search statistics.
+AIStats aiStats;
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Returns the number of bits set in a value, without any table or
+/// multiplication.
+//------------------------------------------------------------------------------
+static unsigned int PopCount(ULONG v)
+{
+    v = v - ((v >> 1) & 0x55555555);
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    v = (v + (v >> 4)) & 0x0F0F0F0F;
+    v += v >> 8;
+    return (v + (v >> 16)) & 0x3F;
+}
+
+//------------------------------------------------------------------------------
+/// Same test as TETRIS_Collides(), on a search board.
+//------------------------------------------------------------------------------
+static unsigned char Collides(
+    const Board *pBoard,
+    unsigned int type,
+    unsigned int rot,
+    int x,
+    int y)
+{
+    const PieceShape *pShape = &pieceShapes[type][rot];
+    int shift = x + TETRIS_COL_OFFSET;
+    unsigned int r;
+
+    // Pieces may not climb (by wall kicks) above the hidden rows
+    if (shift < 0 || y + pShape->bottom < 0 || y + pShape->top >= TETRIS_ROWS) {
+
+        return 1;
+    }
+    for (r = pShape->bottom; r <= pShape->top; r++) {
+
+        if (((ULONG) pShape->rows[r] << shift)
+            & (0xFFFF0000 | pBoard->rows[y + r])) {
+
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the row where a piece dropped from the spawn height lands.
+//------------------------------------------------------------------------------
+static int LandingRow(const Board *pBoard, unsigned int type, unsigned int rot, int x)
+{
+    const PieceShape *pShape = &pieceShapes[type][rot];
+    int y = TETRIS_SPAWN_Y;
+    int distance = TETRIS_ROWS;
+    int gap;
+    unsigned int c;
+
+    // Above the stack the column heights give the answer directly
+    for (c = pShape->left; c <= pShape->right; c++) {
+
+        gap = y + pShape->colBottom[c] - pBoard->heights[x + c];
+        if (gap < 0) {
+
+            break;
+        }
+        if (gap < distance) {
+
+            distance = gap;
+        }
+    }
+    if (c > pShape->right) {
+
+        return y - distance;
+    }
+
+    while (!Collides(pBoard, type, rot, x, y - 1)) {
+
+        y--;
+    }
+    return y;
+}
+
+//------------------------------------------------------------------------------
+/// Locks a piece on a search board and removes the full rows.
+/// \return Eroded piece cells: rows cleared times piece cells in those rows.
+//------------------------------------------------------------------------------
+static unsigned int Place(
+    Board *pBoard,
+    unsigned int type,
+    unsigned int rot,
+    int x,
+    int y)
+{
+    const PieceShape *pShape = &pieceShapes[type][rot];
+    unsigned int shift = x + TETRIS_COL_OFFSET;
+    unsigned int r, c, h, cleared = 0, pieceCells = 0;
+    ULONG full = 0;
+    int src, dst, top;
+
+    for (r = pShape->bottom; r <= pShape->top; r++) {
+
+        pBoard->rows[y + r] |= pShape->rows[r] << shift;
+        if (pBoard->rows[y + r] == TETRIS_ROW_FULL) {
+
+            full |= 1 << (y + r);
+            cleared++;
+            pieceCells += PopCount(pShape->rows[r]);
+        }
+    }
+    top = 0;
+    for (c = 0; c < TETRIS_WIDTH; c++) {
+
+        h = pBoard->heights[c];
+        if (h > top) {
+
+            top = h;
+        }
+    }
+    for (c = pShape->left; c <= pShape->right; c++) {
+
+        // Tetromino columns have no gaps, walk up from the lowest cell
+        r = pShape->colBottom[c] + 1;
+        while (r < 4 && (pShape->rows[r] & (1 << c))) {
+
+            r++;
+        }
+        if (pBoard->heights[x + c] < y + r) {
+
+            pBoard->heights[x + c] = y + r;
+        }
+        if (y + (int) r > top) {
+
+            top = y + r;
+        }
+    }
+    if (full == 0) {
+
+        return 0;
+    }
+
+    // Compact the rows and repair the heights, as the engine does
+    for (dst = y + pShape->bottom; !(full & (1 << dst)); dst++);
+    for (src = dst; src < top; src++) {
+
+        if (!(full & (1 << src))) {
+
+            pBoard->rows[dst++] = pBoard->rows[src];
+        }
+    }
+    for (; dst < top; dst++) {
+
+        pBoard->rows[dst] = TETRIS_ROW_EMPTY;
+    }
+    for (c = 0; c < TETRIS_WIDTH; c++) {
+
+        h = pBoard->heights[c];
+        h -= PopCount(full & ((1 << h) - 1));
+        while (h > 0 && !(pBoard->rows[h - 1] & TETRIS_COL_BIT(c))) {
+
+            h--;
+        }
+        pBoard->heights[c] = h;
+    }
+
+    return cleared * pieceCells;
+}
+
+//------------------------------------------------------------------------------
+/// Scores a playfield after a placement.
+/// \param pBoard  Board after the placement and its line clears.
+/// \param pWeights  Feature weights.
+/// \param landing2  Twice the landing height of the placed piece.
+/// \param eroded  Eroded piece cells of the placement.
+//------------------------------------------------------------------------------
+static SLONG Evaluate(
+    const Board *pBoard,
+    const AIWeights *pWeights,
+    unsigned int landing2,
+    unsigned int eroded)
+{
+    unsigned int rowTransitions = 0, columnTransitions = 0;
+    unsigned int holes = 0, wells = 0, bumpiness = 0;
+    unsigned int row, below, cover, well, top = 0;
+    unsigned char depth[TETRIS_WIDTH];
+    unsigned int c;
+    int r;
+
+    aiStats.placements++;
+
+    for (c = 0; c < TETRIS_WIDTH; c++) {
+
+        if (pBoard->heights[c] > top) {
+
+            top = pBoard->heights[c];
+        }
+        if (c > 0) {
+
+            bumpiness += (pBoard->heights[c] > pBoard->heights[c - 1]) ?
+                         pBoard->heights[c] - pBoard->heights[c - 1] :
+                         pBoard->heights[c - 1] - pBoard->heights[c];
+        }
+        depth[c] = 0;
+    }
+
+    // Bottom-up: row and column transitions, the floor counts as filled
+    below = TETRIS_ROW_FULL;
+    for (r = 0; r < (int) top; r++) {
+
+        row = pBoard->rows[r];
+        rowTransitions += PopCount((row ^ (row >> 1)) & TRANSITION_BITS);
+        columnTransitions += PopCount((row ^ below) & FIELD_BITS);
+        below = row;
+    }
+    // Empty visible rows above the stack: one transition at each wall. A
+    // stack into the hidden rows has none, the difference would wrap
+    if (top < TETRIS_HEIGHT) {
+
+        rowTransitions += 2 * (TETRIS_HEIGHT - top);
+    }
+    columnTransitions += PopCount(below & FIELD_BITS);
+
+    // Top-down: holes under the cover and cumulative well depths
+    cover = 0;
+    for (r = top - 1; r >= 0; r--) {
+
+        row = pBoard->rows[r];
+        holes += PopCount(~row & cover & FIELD_BITS);
+        cover |= row;
+
+        well = ~row & (row << 1) & (row >> 1) & FIELD_BITS;
+        for (c = 0; c < TETRIS_WIDTH; c++) {
+
+            if (well & TETRIS_COL_BIT(c)) {
+
+                wells += ++depth[c];
+            }
+            else {
+
+                depth[c] = 0;
+            }
+        }
+    }
+
+    return pWeights->landingHeight * (SLONG) landing2
+           + pWeights->erodedCells * (SLONG) eroded
+           + pWeights->rowTransitions * (SLONG) rowTransitions
+           + pWeights->columnTransitions * (SLONG) columnTransitions
+           + pWeights->holes * (SLONG) holes
+           + pWeights->wells * (SLONG) wells
+           + pWeights->bumpiness * (SLONG) bumpiness;
+}
+
+//------------------------------------------------------------------------------
+/// Tests whether a rotation state can be reached at the spawn position by
+/// rotating one way, without kicks.
+//------------------------------------------------------------------------------
+static unsigned char CanRotate(const Board *pBoard, unsigned int type, unsigned int rot)
+{
+    if (Collides(pBoard, type, rot, TETRIS_SPAWN_X, TETRIS_SPAWN_Y)) {
+
+        return 0;
+    }
+    // State 2 is reached through state 1
+    if (rot == 2
+        && Collides(pBoard, type, 1, TETRIS_SPAWN_X, TETRIS_SPAWN_Y)) {
+
+        return 0;
+    }
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Finds the best placement of one piece on a board, optionally looking one
+/// piece ahead.
+/// \param pBoard  Board to place the piece on.
+/// \param pWeights  Feature weights.
+/// \param type  Piece to place.
+/// \param next  Piece to place afterwards, or PIECE_COUNT for no lookahead.
+/// \param pBest  Best placement found.
+//------------------------------------------------------------------------------
+static void Search(
+    const Board *pBoard,
+    const AIWeights *pWeights,
+    unsigned int type,
+    unsigned int next,
+    AIPlacement *pBest)
+{
+    const PieceShape *pShape;
+    AIPlacement reply;
+    Board after;
+    unsigned int rot, eroded, rotations;
+    int x, y, left, right;
+    SLONG score;
+
+    aiStats.searches++;
+    pBest->valid = 0;
+    pBest->score = WORST_SCORE;
+    rotations = (type == PIECE_O) ? 1 : PIECE_ROTATIONS;
+
+    for (rot = 0; rot < rotations; rot++) {
+
+        if (!CanRotate(pBoard, type, rot)) {
+
+            continue;
+        }
+
+        // Columns reachable by shifting at the spawn height
+        for (left = TETRIS_SPAWN_X;
+             !Collides(pBoard, type, rot, left - 1, TETRIS_SPAWN_Y);
+             left--);
+        for (right = TETRIS_SPAWN_X;
+             !Collides(pBoard, type, rot, right + 1, TETRIS_SPAWN_Y);
+             right++);
+
+        pShape = &pieceShapes[type][rot];
+        for (x = left; x <= right; x++) {
+
+            y = LandingRow(pBoard, type, rot, x);
+            memcpy(&after, pBoard, sizeof(Board));
+            eroded = Place(&after, type, rot, x, y);
+
+            if (next < PIECE_COUNT) {
+
+                Search(&after, pWeights, next, PIECE_COUNT, &reply);
+                if (!reply.valid) {
+
+                    continue;
+                }
+                score = reply.score;
+            }
+            else {
+
+                score = Evaluate(&after, pWeights,
+                                 2 * y + pShape->bottom + pShape->top, eroded);
+            }
+
+            if (score > pBest->score || !pBest->valid) {
+
+                pBest->rot = rot;
+                pBest->x = x;
+                pBest->y = y;
+                pBest->score = score;
+                pBest->valid = 1;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Clears the search statistics.
+//------------------------------------------------------------------------------
+void AI_ResetStats(void)
+{
+    aiStats.placements = 0;
+    aiStats.searches = 0;
+}
+
+//------------------------------------------------------------------------------
+/// Finds the best placement of the active piece.
+/// \param pGame  Game state, with the active piece at its spawn position.
+/// \param pWeights  Feature weights, e.g. &aiDefaultWeights.
+/// \param lookahead  1 to also place the next piece before scoring.
+/// \param pBest  Best placement found, check its valid field.
+//------------------------------------------------------------------------------
+void AI_Search(
+    const Tetris *pGame,
+    const AIWeights *pWeights,
+    unsigned char lookahead,
+    AIPlacement *pBest)
+{
+    Board board;
+
+    memcpy(board.rows, pGame->rows, sizeof(board.rows));
+    memcpy(board.heights, pGame->heights, sizeof(board.heights));
+
+    Search(&board, pWeights, pGame->piece.type,
+           lookahead ? pGame->next : PIECE_COUNT, pBest);
+}
+
+//------------------------------------------------------------------------------
+/// Returns the actions that bring the active piece one step closer to a
+/// placement: rotate first, then shift, then hard drop.
+/// \param pGame  Game state.
+/// \param pTarget  Placement returned by AI_Search().
+/// \return TETRIS_ACTION_xxx flags for the next TETRIS_Tick().
+//------------------------------------------------------------------------------
+unsigned int AI_Actions(const Tetris *pGame, const AIPlacement *pTarget)
+{
+    const Piece *pPiece = &pGame->piece;
+
+    if (!pTarget->valid) {
+
+        return TETRIS_ACTION_HARD_DROP;
+    }
+    if (pPiece->rot != pTarget->rot) {
+
+        return (pTarget->rot == ((pPiece->rot + 3) & 3)) ?
+               TETRIS_ACTION_ROTATE_CCW : TETRIS_ACTION_ROTATE_CW;
+    }
+    if (pPiece->x < pTarget->x) {
+
+        return TETRIS_ACTION_RIGHT;
+    }
+    if (pPiece->x > pTarget->x) {
+
+        return TETRIS_ACTION_LEFT;
+    }
+    return TETRIS_ACTION_HARD_DROP;
+}
@@ -0,0 +1,87 @@
+//------------------------------------------------------------------------------
+//         Placement AI
+//------------------------------------------------------------------------------
+//
+// Enumerates every placement of the active piece (and optionally of the next
+// piece) that can be reached by rotating at the spawn height, shifting
+// sideways and dropping, and scores the resulting playfield with the
+// Dellacherie / El-Tetris features. All features are computed with bit
+// operations on the row masks and all weights are integers, as the ARM7 has
+// no floating point unit.
+//
+// Used by the attract/demo mode and as a CPU benchmark.
+//
+//------------------------------------------------------------------------------
+
+#ifndef __AI_H__
+#define __AI_H__
+
+#include "typedef.h"
+#include "tetris.h"
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// Feature weights, scaled by 1000.
+typedef struct {
+
+    SLONG landingHeight;
+    SLONG erodedCells;
+    SLONG rowTransitions;
+    SLONG columnTransitions;
+    SLONG holes;
+    SLONG wells;
+    SLONG bumpiness;
+
+} AIWeights;
+
+/// A placement chosen by the AI.
+typedef struct {
+
+    UBYTE rot;
+    SBYTE x;
+    SBYTE y;
+
+    /// Evaluation of the placement, higher is better.
+    SLONG score;
+
+    /// 0 if no legal placement was found.
+    UBYTE valid;
+
+} AIPlacement;
+
+/// Search statistics.
+typedef struct {
+
+    /// Playfields evaluated since the last AI_ResetStats().
+    ULONG placements;
+
+    /// Searches run since the last AI_ResetStats().
+    ULONG searches;
+
+} AIStats;
+
+//------------------------------------------------------------------------------
+//         Global variables
+//------------------------------------------------------------------------------
+
+extern const AIWeights aiDefaultWeights;
+
+extern AIStats aiStats;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void AI_ResetStats(void);
+
+extern void AI_Search(
+    const Tetris *pGame,
+    const AIWeights *pWeights,
+    unsigned char lookahead,
+    AIPlacement *pBest);
+
+extern unsigned int AI_Actions(const Tetris *pGame, const AIPlacement *pTarget);
+
+#endif //#ifndef __AI_H__
@@ -0,0 +1,478 @@
+//------------------------------------------------------------------------------
+//         Host benchmark
+//------------------------------------------------------------------------------
+//
+// Built and run by 'make bench'. Reports the size of the flash tables and the
+// cost of the engine primitives, of the placement AI and of the perfect clear
+// solver on the build machine, and runs a statistical self-test of the PRNG. The exit status is 1 if the
+// self-test fails.
+//
+//------------------------------------------------------------------------------
+
+#include "tetris.h"
+#include "ai.h"
+#include "solver.h"
+
+#include <utility/prng.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// Iterations of every micro benchmark.
+#define ITERATIONS      10000000
+
+/// Games played by the AI benchmark, and the piece limit of every game.
+#define AI_GAMES        4
+#define AI_PIECES       2000
+
+/// Games steered by the solver, the piece limit of every game, and the nodes
+/// searched per piece (the board gets a few thousand per frame).
+#define SOLVER_GAMES    4
+#define SOLVER_PIECES   250
+#define SOLVER_BUDGET   200000
+
+/// Perfect clear puzzles: four garbage rows, solved with a larger budget.
+#define SOLVER_PUZZLES  20
+#define SOLVER_PUZZLE_BUDGET 500000
+
+/// Smallest sequence value the solver's first move replaces the AI's for: a
+/// combo of two pieces, or any perfect clear.
+#define SOLVER_STEER    2
+
+/// Draws per PRNG self-test.
+#define PRNG_DRAWS      7000000
+
+/// Chi-square values exceeded with a probability of 0.001, for 6 and 48
+/// degrees of freedom.
+#define CHI2_6          22.46
+#define CHI2_48         84.04
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+static Tetris game;
+
+/// Solver and its transposition table.
+static Solver solver;
+static ULONG solverArena[SOLVER_ARENA_HOST / sizeof(ULONG)];
+
+/// Sink for results, so the compiler cannot drop the measured work.
+static volatile unsigned int sink;
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Returns a monotonic time stamp in nanoseconds.
+//------------------------------------------------------------------------------
+static double Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//------------------------------------------------------------------------------
+/// Prints the footprint of the generated piece tables.
+//------------------------------------------------------------------------------
+static void ReportTables(void)
+{
+    printf("Tables:\n");
+    printf("  pieceShapes  %5u bytes\n", (unsigned int) sizeof(pieceShapes));
+    printf("  pieceKicks   %5u bytes\n", (unsigned int) sizeof(pieceKicks));
+    printf("  Tetris state %5u bytes\n", (unsigned int) sizeof(Tetris));
+}
+
+//------------------------------------------------------------------------------
+/// Measures a rotation with wall kicks and a single collision test, on a
+/// playfield with a ragged stack.
+//------------------------------------------------------------------------------
+static void BenchRotation(void)
+{
+    unsigned int i, rotated = 0, hits = 0;
+    double start, elapsed;
+
+    TETRIS_Init(&game, 1);
+    for (i = 0; i < 8; i++) {
+
+        game.rows[i] = TETRIS_ROW_FULL & ~TETRIS_COL_BIT(i) & ~TETRIS_COL_BIT(9 - i);
+    }
+
+    start = Now();
+    for (i = 0; i < ITERATIONS; i++) {
+
+        game.piece.type = i % PIECE_COUNT;
+        game.piece.x = i & 7;
+        game.piece.y = 6;
+        rotated += TETRIS_Rotate(&game, i & 1);
+    }
+    elapsed = Now() - start;
+    printf("  rotate        %6.1f ns (%u of %u rotated)\n",
+           elapsed / ITERATIONS, rotated, ITERATIONS);
+
+    start = Now();
+    for (i = 0; i < ITERATIONS; i++) {
+
+        hits += TETRIS_Collides(&game, i % PIECE_COUNT, i & 3, i & 7, 6);
+    }
+    elapsed = Now() - start;
+    printf("  collides      %6.1f ns\n", elapsed / ITERATIONS);
+
+    sink = rotated + hits;
+}
+
+//------------------------------------------------------------------------------
+/// Lets the AI play a few games, with and without lookahead.
+//------------------------------------------------------------------------------
+static void BenchAI(unsigned char lookahead)
+{
+    AIPlacement target;
+    unsigned int g;
+    ULONG pieces = 0, lines = 0;
+    double start, elapsed;
+
+    AI_ResetStats();
+    start = Now();
+    for (g = 0; g < AI_GAMES; g++) {
+
+        TETRIS_Init(&game, g + 1);
+        while (!game.gameOver && game.pieces < AI_PIECES) {
+
+            AI_Search(&game, &aiDefaultWeights, lookahead, &target);
+            while (!(TETRIS_Tick(&game, AI_Actions(&game, &target))
+                     & (TETRIS_EVENT_LOCKED | TETRIS_EVENT_GAME_OVER)));
+        }
+        pieces += game.pieces;
+        lines += game.lines;
+    }
+    elapsed = Now() - start;
+
+    printf("  lookahead %u   %8.0f placements/s, %6.1f us/piece, "
+           "%lu pieces, %lu lines\n",
+           lookahead,
+           aiStats.placements / (elapsed / 1e9),
+           elapsed / 1e3 / pieces,
+           (unsigned long) pieces, (unsigned long) lines);
+}
+
+//------------------------------------------------------------------------------
+/// Plays a few games where the solver gets a node budget on every spawn and
+/// takes over from the AI whenever it finds a combo or a perfect clear.
+//------------------------------------------------------------------------------
+static void BenchSolver(void)
+{
+    AIPlacement target;
+    unsigned int g, rot;
+    int x;
+    ULONG nodes, lines, totalLines = 0, searches = 0, depths = 0, steered = 0, perfect = 0;
+    double start, elapsed;
+
+    SOLVER_Init(&solver, solverArena, sizeof(solverArena));
+    printf("  table        %7u entries of %u bytes\n",
+           (unsigned int) (solver.tableMask + 1),
+           (unsigned int) sizeof(SolverEntry));
+
+    start = Now();
+    for (g = 0; g < SOLVER_GAMES; g++) {
+
+        TETRIS_Init(&game, g + 1);
+        while (!game.gameOver && game.pieces < SOLVER_PIECES) {
+
+            AI_Search(&game, &aiDefaultWeights, 0, &target);
+            if (SOLVER_Start(&solver, &game, SOLVER_MAX_DEPTH)) {
+
+                nodes = solver.stats.nodes;
+                while (SOLVER_Step(&solver, 256) == SOLVER_RUNNING
+                       && solver.stats.nodes - nodes < SOLVER_BUDGET);
+                searches++;
+                depths += solver.result.depth;
+                if (solver.result.valid && solver.result.value >= SOLVER_STEER) {
+
+                    SOLVER_Placement(&solver, 0, &rot, &x);
+                    target.rot = rot;
+                    target.x = x;
+                    target.valid = 1;
+                    steered++;
+                }
+            }
+
+            lines = game.lines;
+            while (!(TETRIS_Tick(&game, AI_Actions(&game, &target))
+                     & (TETRIS_EVENT_LOCKED | TETRIS_EVENT_GAME_OVER)));
+            if (game.lines != lines && game.rows[0] == TETRIS_ROW_EMPTY) {
+
+                perfect++;
+            }
+        }
+        totalLines += game.lines;
+    }
+    elapsed = Now() - start;
+
+    printf("  search       %8.0f nodes/s, %lu searches, mean depth %.1f\n",
+           solver.stats.nodes / (elapsed / 1e9),
+           (unsigned long) searches,
+           searches ? (double) depths / searches : 0.0);
+    printf("  table        %5.1f%% hits of %lu probes, %lu stores\n",
+           solver.stats.probes ? 100.0 * solver.stats.hits / solver.stats.probes : 0.0,
+           (unsigned long) solver.stats.probes,
+           (unsigned long) solver.stats.stores);
+    printf("  games        %lu pieces steered, %lu lines, %lu perfect clears\n",
+           (unsigned long) steered, (unsigned long) totalLines,
+           (unsigned long) perfect);
+}
+
+//------------------------------------------------------------------------------
+/// Searches perfect clears on playfields with four garbage rows, which one
+/// vertical I piece clears if nothing else gets in the way.
+//------------------------------------------------------------------------------
+static void BenchPuzzles(void)
+{
+    unsigned int p, found = 0, pieces = 0;
+    ULONG nodes = solver.stats.nodes;
+    double start, elapsed;
+
+    start = Now();
+    for (p = 0; p < SOLVER_PUZZLES; p++) {
+
+        TETRIS_Init(&game, p + 1);
+        TETRIS_AddGarbage(&game, 4, p % TETRIS_WIDTH);
+        SOLVER_Start(&solver, &game, SOLVER_MAX_DEPTH);
+        while (SOLVER_Step(&solver, 256) == SOLVER_RUNNING
+               && solver.stats.nodes - nodes < SOLVER_PUZZLE_BUDGET);
+        if (solver.result.valid
+            && solver.result.value > SOLVER_PERFECT - SOLVER_MAX_DEPTH - 1) {
+
+            found++;
+            pieces += SOLVER_PERFECT - solver.result.value;
+        }
+        nodes = solver.stats.nodes;
+    }
+    elapsed = Now() - start;
+
+    printf("  puzzles      %u of %u perfect clears found, %.1f pieces each, "
+           "%.0f ms each\n",
+           found, SOLVER_PUZZLES, found ? (double) pieces / found : 0.0,
+           elapsed / 1e6 / SOLVER_PUZZLES);
+}
+
+//------------------------------------------------------------------------------
+/// Measures the PRNG against the at91lib rand() LCG followed by a modulo,
+/// which is what callers used to do to get a piece type.
+//------------------------------------------------------------------------------
+static void BenchPrng(void)
+{
+    Prng prng;
+    unsigned long int lcg = 1;
+    unsigned int i, sum = 0;
+    double start, elapsed;
+
+    PRNG_Seed(&prng, 1, 0);
+
+    start = Now();
+    for (i = 0; i < ITERATIONS; i++) {
+
+        sum += PRNG_Next(&prng);
+    }
+    elapsed = Now() - start;
+    printf("  next          %6.1f ns\n", elapsed / ITERATIONS);
+
+    start = Now();
+    for (i = 0; i < ITERATIONS; i++) {
+
+        sum += PRNG_Range(&prng, PIECE_COUNT);
+    }
+    elapsed = Now() - start;
+    printf("  range(7)      %6.1f ns\n", elapsed / ITERATIONS);
+
+    start = Now();
+    for (i = 0; i < ITERATIONS; i++) {
+
+        lcg = lcg * 1103515245 + 12345;
+        sum += ((unsigned int) (lcg / 131072) % 65536) % PIECE_COUNT;
+    }
+    elapsed = Now() - start;
+    printf("  rand() %% 7    %6.1f ns\n", elapsed / ITERATIONS);
+
+    sink = sum;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the chi-square statistic of observed counts against a uniform
+/// distribution.
+//------------------------------------------------------------------------------
+static double ChiSquare(const unsigned int *pCounts, unsigned int cells,
+                        unsigned int total)
+{
+    double expected = (double) total / cells;
+    double chi2 = 0, d;
+    unsigned int i;
+
+    for (i = 0; i < cells; i++) {
+
+        d = pCounts[i] - expected;
+        chi2 += d * d / expected;
+    }
+    return chi2;
+}
+
+//------------------------------------------------------------------------------
+/// Prints the outcome of one self-test.
+/// \return 1 if the test failed.
+//------------------------------------------------------------------------------
+static unsigned int Report(const char *pName, double value, double limit)
+{
+    printf("  %-24s %10.2f (limit %.2f) %s\n", pName, value, limit,
+           (value <= limit) ? "pass" : "FAIL");
+    return value > limit;
+}
+
+//------------------------------------------------------------------------------
+/// Statistical self-test of the PRNG: uniformity and serial correlation of
+/// PRNG_Range(), bit balance of PRNG_Next(), bag permutations and stream
+/// independence.
+/// \return Number of failed tests.
+//------------------------------------------------------------------------------
+static unsigned int TestPrng(void)
+{
+    Prng prng, other;
+    PrngBag bag;
+    unsigned int counts[PIECE_COUNT * PIECE_COUNT];
+    unsigned int bits[32];
+    unsigned int i, b, v, last, seen, failures = 0;
+    double worst, d, sigma;
+
+    // Uniformity of single values and of consecutive pairs
+    PRNG_Seed(&prng, 12345, 0);
+    for (i = 0; i < PIECE_COUNT; i++) {
+
+        counts[i] = 0;
+    }
+    for (i = 0; i < PRNG_DRAWS; i++) {
+
+        counts[PRNG_Range(&prng, PIECE_COUNT)]++;
+    }
+    failures += Report("range(7) chi-square",
+                       ChiSquare(counts, PIECE_COUNT, PRNG_DRAWS), CHI2_6);
+
+    for (i = 0; i < PIECE_COUNT * PIECE_COUNT; i++) {
+
+        counts[i] = 0;
+    }
+    last = PRNG_Range(&prng, PIECE_COUNT);
+    for (i = 0; i < PRNG_DRAWS; i++) {
+
+        v = PRNG_Range(&prng, PIECE_COUNT);
+        counts[last * PIECE_COUNT + v]++;
+        last = v;
+    }
+    failures += Report("pairs chi-square",
+                       ChiSquare(counts, PIECE_COUNT * PIECE_COUNT, PRNG_DRAWS),
+                       CHI2_48);
+
+    // Every bit set half of the time, within 5 standard deviations
+    for (b = 0; b < 32; b++) {
+
+        bits[b] = 0;
+    }
+    for (i = 0; i < PRNG_DRAWS; i++) {
+
+        v = PRNG_Next(&prng);
+        for (b = 0; b < 32; b++) {
+
+            bits[b] += (v >> b) & 1;
+        }
+    }
+    sigma = 0.5 * sqrt(PRNG_DRAWS);
+    worst = 0;
+    for (b = 0; b < 32; b++) {
+
+        d = fabs(bits[b] - PRNG_DRAWS / 2.0) / sigma;
+        if (d > worst) {
+
+            worst = d;
+        }
+    }
+    failures += Report("bit balance (sigma)", worst, 5.0);
+
+    // Every bag is a permutation, and every piece is equally likely in every
+    // bag position
+    PRNG_BagInit(&bag);
+    for (i = 0; i < PIECE_COUNT * PIECE_COUNT; i++) {
+
+        counts[i] = 0;
+    }
+    v = 0;
+    for (i = 0; i < PRNG_DRAWS / PIECE_COUNT; i++) {
+
+        seen = 0;
+        for (b = 0; b < PIECE_COUNT; b++) {
+
+            last = PRNG_BagNext(&prng, &bag);
+            seen |= 1 << last;
+            counts[b * PIECE_COUNT + last]++;
+        }
+        v += seen != (1 << PIECE_COUNT) - 1;
+    }
+    failures += Report("bags not a permutation", v, 0);
+    failures += Report("bag positions chi-square",
+                       ChiSquare(counts, PIECE_COUNT * PIECE_COUNT,
+                                 PRNG_DRAWS / PIECE_COUNT * PIECE_COUNT),
+                       CHI2_48);
+
+    // Two streams with the same seed must not agree more often than chance
+    PRNG_Seed(&prng, 12345, 0);
+    PRNG_Seed(&other, 12345, 1);
+    for (i = 0; i < PIECE_COUNT * PIECE_COUNT; i++) {
+
+        counts[i] = 0;
+    }
+    for (i = 0; i < PRNG_DRAWS; i++) {
+
+        counts[PRNG_Range(&prng, PIECE_COUNT) * PIECE_COUNT
+               + PRNG_Range(&other, PIECE_COUNT)]++;
+    }
+    failures += Report("streams chi-square",
+                       ChiSquare(counts, PIECE_COUNT * PIECE_COUNT, PRNG_DRAWS),
+                       CHI2_48);
+
+    return failures;
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+    unsigned int failures;
+
+    ReportTables();
+
+    printf("Lookups:\n");
+    BenchRotation();
+
+    printf("AI (%u games, up to %u pieces each):\n", AI_GAMES, AI_PIECES);
+    BenchAI(0);
+    BenchAI(1);
+
+    printf("Solver (%u games, up to %u pieces, %u nodes per piece):\n",
+           SOLVER_GAMES, SOLVER_PIECES, SOLVER_BUDGET);
+    BenchSolver();
+    BenchPuzzles();
+
+    printf("PRNG:\n");
+    BenchPrng();
+
+    printf("PRNG self-test (%u draws):\n", PRNG_DRAWS);
+    failures = TestPrng();
+
+    return failures != 0;
+}
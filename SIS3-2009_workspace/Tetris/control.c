@@ -0,0 +1,77 @@
+//------------------------------------------------------------------------------
+//         Player controls
+//------------------------------------------------------------------------------
+
+#include "control.h"
+#include "tetris.h"
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Resets the control state, as if no button had been held.
+/// \param pControl  Control state.
+//------------------------------------------------------------------------------
+void CONTROL_Init(Control *pControl)
+{
+    pControl->held = 0;
+    pControl->shiftTicks = 0;
+}
+
+//------------------------------------------------------------------------------
+/// Computes the engine actions of one logic tick.
+/// \param pControl  Control state.
+/// \param buttons  CONTROL_BUTTON_xxx flags held during this tick.
+/// \return TETRIS_ACTION_xxx flags to pass to TETRIS_Tick().
+//------------------------------------------------------------------------------
+unsigned int CONTROL_Update(Control *pControl, unsigned int buttons)
+{
+    unsigned int pressed = buttons & ~pControl->held;
+    unsigned int shift = buttons & (CONTROL_BUTTON_LEFT | CONTROL_BUTTON_RIGHT);
+    unsigned int actions = 0;
+
+    // Holding both directions cancels the shift
+    if (shift == (CONTROL_BUTTON_LEFT | CONTROL_BUTTON_RIGHT)) {
+
+        shift = 0;
+    }
+
+    if (shift == 0) {
+
+        pControl->shiftTicks = 0;
+    }
+    else if (pressed & shift) {
+
+        // First step on the press, then wait for DAS to charge
+        pControl->shiftTicks = 0;
+        actions |= (shift == CONTROL_BUTTON_LEFT) ?
+                   TETRIS_ACTION_LEFT : TETRIS_ACTION_RIGHT;
+    }
+    else if (++pControl->shiftTicks >= CONTROL_DAS_TICKS) {
+
+        pControl->shiftTicks = CONTROL_DAS_TICKS - CONTROL_ARR_TICKS;
+        actions |= (shift == CONTROL_BUTTON_LEFT) ?
+                   TETRIS_ACTION_LEFT : TETRIS_ACTION_RIGHT;
+    }
+
+    if (pressed & CONTROL_BUTTON_UP) {
+
+        actions |= TETRIS_ACTION_ROTATE_CW;
+    }
+    if (pressed & CONTROL_BUTTON_SWITCH1) {
+
+        actions |= TETRIS_ACTION_ROTATE_CCW;
+    }
+    if (pressed & CONTROL_BUTTON_PUSH) {
+
+        actions |= TETRIS_ACTION_HARD_DROP;
+    }
+    if (buttons & CONTROL_BUTTON_DOWN) {
+
+        actions |= TETRIS_ACTION_SOFT_DROP;
+    }
+
+    pControl->held = buttons;
+    return actions;
+}
@@ -0,0 +1,60 @@
+//------------------------------------------------------------------------------
+//         Player controls
+//------------------------------------------------------------------------------
+//
+// Turns the held-button state sampled once per logic tick into engine
+// actions. Left/right use delayed auto-shift (DAS): one step on the press,
+// then after CONTROL_DAS_TICKS one step every CONTROL_ARR_TICKS. Rotations
+// and hard drop trigger on the press only, soft drop acts on every tick.
+//
+// All timings are counted in logic ticks, so they are exactly as
+// deterministic as the game itself.
+//
+//------------------------------------------------------------------------------
+
+#ifndef __CONTROL_H__
+#define __CONTROL_H__
+
+#include "typedef.h"
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Buttons, as sampled by the application.
+#define CONTROL_BUTTON_LEFT       (1 << 0)
+#define CONTROL_BUTTON_RIGHT      (1 << 1)
+#define CONTROL_BUTTON_UP         (1 << 2)
+#define CONTROL_BUTTON_DOWN       (1 << 3)
+#define CONTROL_BUTTON_PUSH       (1 << 4)
+#define CONTROL_BUTTON_SWITCH1    (1 << 5)
+#define CONTROL_BUTTON_SWITCH2    (1 << 6)
+
+/// Delayed auto-shift, in logic ticks.
+#define CONTROL_DAS_TICKS         10
+/// Auto-repeat rate once DAS has charged, in logic ticks.
+#define CONTROL_ARR_TICKS         2
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+
+    /// Buttons held during the previous tick.
+    UBYTE held;
+
+    /// Ticks the current horizontal direction has been held.
+    UBYTE shiftTicks;
+
+} Control;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void CONTROL_Init(Control *pControl);
+
+extern unsigned int CONTROL_Update(Control *pControl, unsigned int buttons);
+
+#endif //#ifndef __CONTROL_H__
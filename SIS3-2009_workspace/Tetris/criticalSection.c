@@ -0,0 +1,39 @@
+//------------------------------------------------------------------------------
+//         Critical Section
+//------------------------------------------------------------------------------
+//
+// Author: Krzysztof Sierszecki  February 24, 2008
+//
+//------------------------------------------------------------------------------
+
+#include "criticalSection.h"
+#include "typedef.h"
+#include <utility/critical.h>
+
+volatile UWORD nestedCritical = 0;
+// Interrupt masks before the outermost section, which it leaves as it found
+static unsigned int savedCpsr;
+
+// Masks the IRQ and the FIQ, for what must be truly atomic; sections that
+// only share data with handlers should use CRITICAL_Raise() instead
+void EnterCritical(void) 
+{
+   unsigned int cpsr = CRITICAL_Disable();
+
+   if ( !nestedCritical++ ) {
+      savedCpsr = cpsr;
+      // The section is charged to the caller, not to this function
+      CRITICAL_SetSite(__builtin_return_address(0));
+   }
+   else {
+      // Already masked, only the outermost section counts
+      CRITICAL_Enable(cpsr);
+   }
+}
+
+void ExitCritical(void) 
+{
+   if ( !--nestedCritical ) {
+      CRITICAL_Enable(savedCpsr);
+   }
+}
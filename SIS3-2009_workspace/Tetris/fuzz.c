@@ -0,0 +1,272 @@
+//------------------------------------------------------------------------------
+//         Engine fuzzer
+//------------------------------------------------------------------------------
+//
+// Usage: tetris-fuzz [-n games] [-t ticks] [-s seed]
+//
+// Plays games with random input streams and checks the playfield invariants
+// after every tick:
+//    - every row mask has both walls set, the rows above the playfield are
+//      empty and no full row is left after a lock
+//    - the colour grid matches the row masks
+//    - every column height is the index of its highest filled cell + 1
+//    - the active piece is valid and does not overlap anything
+//    - after every lock, TETRIS_Save() and TETRIS_Restore() give back the
+//      same state
+//
+// Every other game is steered by the AI with random inputs mixed in, so that
+// line clears are covered as well. Garbage rows are inserted at random.
+//
+// The first violation is printed with the seed and tick that reproduce it.
+// Built and run by 'make fuzz'.
+//
+//------------------------------------------------------------------------------
+
+#include "tetris.h"
+#include "ai.h"
+
+#include <utility/prng.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+#define DEFAULT_GAMES   2000
+#define DEFAULT_TICKS   20000
+
+/// PRNG stream of the input generator.
+#define INPUT_STREAM    1
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+static Tetris game;
+static Tetris restored;
+static UBYTE saved[TETRIS_SAVE_SIZE];
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Prints the playfield, the active piece is not drawn.
+//------------------------------------------------------------------------------
+static void Print(const Tetris *pGame)
+{
+    int r;
+    unsigned int c;
+
+    for (r = TETRIS_ROWS - 1; r >= 0; r--) {
+
+        printf("  %2d %04x |", r, pGame->rows[r]);
+        for (c = 0; c < TETRIS_WIDTH; c++) {
+
+            putchar((pGame->rows[r] & TETRIS_COL_BIT(c)) ?
+                    '0' + pGame->colors[r][c] : '.');
+        }
+        printf("|\n");
+    }
+    printf("  heights");
+    for (c = 0; c < TETRIS_WIDTH; c++) {
+
+        printf(" %u", pGame->heights[c]);
+    }
+    printf("\n  piece %u rot %u at (%d, %d)\n", pGame->piece.type,
+           pGame->piece.rot, pGame->piece.x, pGame->piece.y);
+}
+
+//------------------------------------------------------------------------------
+/// Checks the playfield invariants.
+/// \return Description of the first violated invariant, or 0.
+//------------------------------------------------------------------------------
+static const char * Check(const Tetris *pGame)
+{
+    unsigned int r, c, h;
+    UBYTE filled;
+
+    for (r = 0; r < TETRIS_ROWS + 4; r++) {
+
+        if ((pGame->rows[r] & TETRIS_ROW_WALLS) != TETRIS_ROW_WALLS) {
+
+            return "row mask outside the walls";
+        }
+        if (r >= TETRIS_ROWS && pGame->rows[r] != TETRIS_ROW_EMPTY) {
+
+            return "row above the playfield not empty";
+        }
+        if (pGame->rows[r] == TETRIS_ROW_FULL) {
+
+            return "full row not cleared";
+        }
+    }
+
+    for (r = 0; r < TETRIS_ROWS; r++) {
+
+        for (c = 0; c < TETRIS_WIDTH; c++) {
+
+            filled = (pGame->rows[r] & TETRIS_COL_BIT(c)) != 0;
+            if (filled != (pGame->colors[r][c] != 0)) {
+
+                return "colour grid does not match the row masks";
+            }
+            if (pGame->colors[r][c] > TETRIS_GARBAGE) {
+
+                return "invalid colour";
+            }
+        }
+    }
+
+    for (c = 0; c < TETRIS_WIDTH; c++) {
+
+        for (h = TETRIS_ROWS; h > 0; h--) {
+
+            if (pGame->rows[h - 1] & TETRIS_COL_BIT(c)) {
+
+                break;
+            }
+        }
+        if (pGame->heights[c] != h) {
+
+            return "column height inconsistent with the row masks";
+        }
+    }
+
+    if (pGame->piece.type >= PIECE_COUNT
+        || pGame->piece.rot >= PIECE_ROTATIONS
+        || pGame->next >= PIECE_COUNT) {
+
+        return "invalid piece";
+    }
+    if (!pGame->gameOver
+        && TETRIS_Collides(pGame, pGame->piece.type, pGame->piece.rot,
+                           pGame->piece.x, pGame->piece.y)) {
+
+        return "active piece overlaps the stack or the walls";
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    Prng input;
+    AIPlacement target;
+    unsigned long games = DEFAULT_GAMES, ticks = DEFAULT_TICKS, seed = 1;
+    unsigned long g, t, total = 0, pieces = 0, lines = 0;
+    unsigned int actions, events = 0, n;
+    const char *pError;
+    int arg;
+
+    for (arg = 1; arg + 1 < argc; arg += 2) {
+
+        if (strcmp(argv[arg], "-n") == 0) {
+
+            games = strtoul(argv[arg + 1], 0, 0);
+        }
+        else if (strcmp(argv[arg], "-t") == 0) {
+
+            ticks = strtoul(argv[arg + 1], 0, 0);
+        }
+        else if (strcmp(argv[arg], "-s") == 0) {
+
+            seed = strtoul(argv[arg + 1], 0, 0);
+        }
+        else {
+
+            break;
+        }
+    }
+    if (arg < argc) {
+
+        fprintf(stderr, "usage: %s [-n games] [-t ticks] [-s seed]\n", argv[0]);
+        return 2;
+    }
+
+    for (g = seed; g < seed + games; g++) {
+
+        TETRIS_Init(&game, g);
+        PRNG_Seed(&input, g, INPUT_STREAM);
+
+        // Every game draws its own input density, from button mashing to
+        // mostly idle
+        n = PRNG_Range(&input, 4);
+
+        for (t = 1; t <= ticks && !game.gameOver; t++) {
+
+            actions = PRNG_Next(&input) & (TETRIS_ACTION_LEFT
+                                           | TETRIS_ACTION_RIGHT
+                                           | TETRIS_ACTION_ROTATE_CW
+                                           | TETRIS_ACTION_ROTATE_CCW
+                                           | TETRIS_ACTION_SOFT_DROP
+                                           | TETRIS_ACTION_HARD_DROP);
+            if (PRNG_Range(&input, 1 << (2 * n)) != 0) {
+
+                actions &= ~TETRIS_ACTION_HARD_DROP;
+            }
+            if (PRNG_Range(&input, 1 << n) != 0) {
+
+                actions = 0;
+            }
+            if (g & 1) {
+
+                if (t == 1 || (events & TETRIS_EVENT_SPAWNED)) {
+
+                    AI_Search(&game, &aiDefaultWeights, 0, &target);
+                }
+                if (PRNG_Range(&input, 8) != 0) {
+
+                    actions = AI_Actions(&game, &target);
+                }
+            }
+
+            events = TETRIS_Tick(&game, actions);
+
+            // Versus garbage, now and then
+            if (PRNG_Range(&input, 256) == 0) {
+
+                events |= TETRIS_AddGarbage(&game,
+                                            1 + PRNG_Range(&input, TETRIS_MAX_GARBAGE),
+                                            PRNG_Range(&input, TETRIS_WIDTH));
+            }
+            pError = Check(&game);
+            if (!pError && (events & TETRIS_EVENT_LOCKED)) {
+
+                if (TETRIS_Save(&game, saved) != TETRIS_SAVE_SIZE) {
+
+                    pError = "save size";
+                }
+                else if (!TETRIS_Restore(&restored, saved)) {
+
+                    pError = "saved state rejected";
+                }
+                else if (memcmp(&restored, &game, sizeof(Tetris)) != 0) {
+
+                    pError = "restored state differs";
+                }
+            }
+            if (pError) {
+
+                printf("FAIL seed %lu tick %lu (actions %02x): %s\n",
+                       g, t, actions, pError);
+                Print(&game);
+                return 1;
+            }
+        }
+        total += t - 1;
+        pieces += game.pieces;
+        lines += game.lines;
+    }
+
+    printf("OK: %lu games, %lu ticks, %lu pieces, %lu lines\n",
+           games, total, pieces, lines);
+    return 0;
+}
@@ -0,0 +1,229 @@
+//------------------------------------------------------------------------------
+//         Piece table generator (host tool)
+//------------------------------------------------------------------------------
+//
+// Runs on the build machine and prints pieces_tables.c: the row masks and
+// bounding boxes of every piece in every rotation state, and the SRS wall
+// kick offsets of every rotation. The firmware only ever reads these const
+// tables from flash, so rotating a piece costs a table lookup and a few
+// collision tests.
+//
+// Usage: gentables > pieces_tables.c
+//
+//------------------------------------------------------------------------------
+
+#include "pieces.h"
+
+#include <stdio.h>
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+/// Spawn orientation of every piece, top box row first, bit 0 = left column.
+static const UBYTE spawnRows[PIECE_COUNT][4] = {
+    {0x0, 0xF, 0x0, 0x0},   // I  ....  ####  ....  ....
+    {0x6, 0x6, 0x0, 0x0},   // O  .##.  .##.
+    {0x2, 0x7, 0x0, 0x0},   // T  .#.   ###
+    {0x6, 0x3, 0x0, 0x0},   // S  .##   ##.
+    {0x3, 0x6, 0x0, 0x0},   // Z  ##.   .##
+    {0x1, 0x7, 0x0, 0x0},   // J  #..   ###
+    {0x4, 0x7, 0x0, 0x0}    // L  ..#   ###
+};
+
+/// Size of the rotation box of every piece (0 = does not rotate).
+static const unsigned int boxSize[PIECE_COUNT] = {4, 0, 3, 3, 3, 3, 3};
+
+/// Piece names, for the comments of the generated file.
+static const char pieceNames[PIECE_COUNT] = {'I', 'O', 'T', 'S', 'Z', 'J', 'L'};
+
+/// SRS kick offsets (x right, y up) of the J, L, S, T and Z pieces, indexed
+/// by the starting rotation state and the direction (0 = CW, 1 = CCW).
+static const int kicksJLSTZ[PIECE_ROTATIONS][2][PIECE_KICKS][2] = {
+    {{{0, 0}, {-1, 0}, {-1,  1}, {0, -2}, {-1, -2}},    // 0 -> R
+     {{0, 0}, { 1, 0}, { 1,  1}, {0, -2}, { 1, -2}}},   // 0 -> L
+    {{{0, 0}, { 1, 0}, { 1, -1}, {0,  2}, { 1,  2}},    // R -> 2
+     {{0, 0}, { 1, 0}, { 1, -1}, {0,  2}, { 1,  2}}},   // R -> 0
+    {{{0, 0}, { 1, 0}, { 1,  1}, {0, -2}, { 1, -2}},    // 2 -> L
+     {{0, 0}, {-1, 0}, {-1,  1}, {0, -2}, {-1, -2}}},   // 2 -> R
+    {{{0, 0}, {-1, 0}, {-1, -1}, {0,  2}, {-1,  2}},    // L -> 0
+     {{0, 0}, {-1, 0}, {-1, -1}, {0,  2}, {-1,  2}}}    // L -> 2
+};
+
+/// SRS kick offsets of the I piece.
+static const int kicksI[PIECE_ROTATIONS][2][PIECE_KICKS][2] = {
+    {{{0, 0}, {-2, 0}, { 1, 0}, {-2, -1}, { 1,  2}},    // 0 -> R
+     {{0, 0}, {-1, 0}, { 2, 0}, {-1,  2}, { 2, -1}}},   // 0 -> L
+    {{{0, 0}, {-1, 0}, { 2, 0}, {-1,  2}, { 2, -1}},    // R -> 2
+     {{0, 0}, { 2, 0}, {-1, 0}, { 2,  1}, {-1, -2}}},   // R -> 0
+    {{{0, 0}, { 2, 0}, {-1, 0}, { 2,  1}, {-1, -2}},    // 2 -> L
+     {{0, 0}, { 1, 0}, {-2, 0}, { 1, -2}, {-2,  1}}},   // 2 -> R
+    {{{0, 0}, { 1, 0}, {-2, 0}, { 1, -2}, {-2,  1}},    // L -> 0
+     {{0, 0}, {-2, 0}, { 1, 0}, {-2, -1}, { 1,  2}}}    // L -> 2
+};
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Rotates a top-down 4x4 grid clockwise inside its n x n rotation box.
+//------------------------------------------------------------------------------
+static void RotateClockwise(const UBYTE *pSrc, UBYTE *pDst, unsigned int n)
+{
+    unsigned int r, c;
+
+    for (r = 0; r < 4; r++) {
+
+        pDst[r] = 0;
+    }
+    for (r = 0; r < n; r++) {
+
+        for (c = 0; c < n; c++) {
+
+            if (pSrc[n - 1 - c] & (1 << r)) {
+
+                pDst[r] |= 1 << c;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Fills a PieceShape from a top-down 4x4 grid.
+//------------------------------------------------------------------------------
+static void BuildShape(PieceShape *pShape, const UBYTE *pGrid)
+{
+    unsigned int r, c;
+
+    pShape->left = 3;
+    pShape->right = 0;
+    pShape->bottom = 3;
+    pShape->top = 0;
+    for (c = 0; c < 4; c++) {
+
+        pShape->colBottom[c] = -1;
+    }
+
+    for (r = 0; r < 4; r++) {
+
+        // Box row r (bottom-up) is grid row 3 - r (top-down)
+        pShape->rows[r] = pGrid[3 - r];
+        for (c = 0; c < 4; c++) {
+
+            if (pShape->rows[r] & (1 << c)) {
+
+                if (pShape->colBottom[c] < 0) {
+
+                    pShape->colBottom[c] = r;
+                }
+                if (c < pShape->left)   pShape->left = c;
+                if (c > pShape->right)  pShape->right = c;
+                if (r < pShape->bottom) pShape->bottom = r;
+                if (r > pShape->top)    pShape->top = r;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Prints the shape table.
+//------------------------------------------------------------------------------
+static void PrintShapes(void)
+{
+    PieceShape shape;
+    UBYTE grid[4], next[4];
+    unsigned int type, rot, r;
+
+    printf("const PieceShape pieceShapes[PIECE_COUNT][PIECE_ROTATIONS] = {\n");
+    for (type = 0; type < PIECE_COUNT; type++) {
+
+        for (r = 0; r < 4; r++) {
+
+            grid[r] = spawnRows[type][r];
+        }
+        printf("    {   // %c\n", pieceNames[type]);
+        for (rot = 0; rot < PIECE_ROTATIONS; rot++) {
+
+            BuildShape(&shape, grid);
+            printf("        {{0x%X, 0x%X, 0x%X, 0x%X}, {%d, %d, %d, %d}, "
+                   "%u, %u, %u, %u}%s\n",
+                   shape.rows[0], shape.rows[1], shape.rows[2], shape.rows[3],
+                   shape.colBottom[0], shape.colBottom[1],
+                   shape.colBottom[2], shape.colBottom[3],
+                   shape.left, shape.right, shape.bottom, shape.top,
+                   rot < PIECE_ROTATIONS - 1 ? "," : "");
+            if (boxSize[type] != 0) {
+
+                RotateClockwise(grid, next, boxSize[type]);
+                for (r = 0; r < 4; r++) {
+
+                    grid[r] = next[r];
+                }
+            }
+        }
+        printf("    }%s\n", type < PIECE_COUNT - 1 ? "," : "");
+    }
+    printf("};\n\n");
+}
+
+//------------------------------------------------------------------------------
+/// Prints the kick table. The O piece only gets the in-place test.
+//------------------------------------------------------------------------------
+static void PrintKicks(void)
+{
+    const int (*pKicks)[2][PIECE_KICKS][2];
+    unsigned int type, rot, dir, i, count;
+
+    printf("const PieceKicks pieceKicks[PIECE_COUNT][PIECE_ROTATIONS][2] = {\n");
+    for (type = 0; type < PIECE_COUNT; type++) {
+
+        pKicks = (type == PIECE_I) ? kicksI : kicksJLSTZ;
+        count = (type == PIECE_O) ? 1 : PIECE_KICKS;
+        printf("    {   // %c\n", pieceNames[type]);
+        for (rot = 0; rot < PIECE_ROTATIONS; rot++) {
+
+            printf("        {");
+            for (dir = 0; dir < 2; dir++) {
+
+                printf("{%u, {", count);
+                for (i = 0; i < PIECE_KICKS; i++) {
+
+                    printf("%d%s", i < count ? pKicks[rot][dir][i][0] : 0,
+                           i < PIECE_KICKS - 1 ? ", " : "");
+                }
+                printf("}, {");
+                for (i = 0; i < PIECE_KICKS; i++) {
+
+                    printf("%d%s", i < count ? pKicks[rot][dir][i][1] : 0,
+                           i < PIECE_KICKS - 1 ? ", " : "");
+                }
+                printf("}}%s", dir == 0 ? ", " : "");
+            }
+            printf("}%s\n", rot < PIECE_ROTATIONS - 1 ? "," : "");
+        }
+        printf("    }%s\n", type < PIECE_COUNT - 1 ? "," : "");
+    }
+    printf("};\n");
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+    printf("//------------------------------------------------------------------------------\n");
+    printf("//         Piece tables\n");
+    printf("//------------------------------------------------------------------------------\n");
+    printf("//\n");
+    printf("// Generated by gentables.c, do not edit.\n");
+    printf("//\n");
+    printf("//------------------------------------------------------------------------------\n\n");
+    printf("#include \"pieces.h\"\n\n");
+
+    PrintShapes();
+    PrintKicks();
+
+    return 0;
+}
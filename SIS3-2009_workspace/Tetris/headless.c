@@ -0,0 +1,191 @@
+//------------------------------------------------------------------------------
+//         Headless host runner
+//------------------------------------------------------------------------------
+//
+// Usage: tetris-headless [-t ticks] [-s seed] [-m ai|ai2|random]
+//
+// Runs games back to back for a fixed number of logic ticks, as fast as the
+// host allows, and reports the engine throughput and the line clear rates.
+// Games are driven by the AI (ai: no lookahead, ai2: one piece lookahead) or
+// by a random input stream. Built and run by 'make headless'; everything
+// that runs here is the same code that is flashed on the board.
+//
+//------------------------------------------------------------------------------
+
+#include "tetris.h"
+#include "ai.h"
+
+#include <utility/prng.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+#define DEFAULT_TICKS   1000000
+
+/// How the games are driven.
+#define MODE_AI         0
+#define MODE_AI2        1
+#define MODE_RANDOM     2
+
+/// PRNG stream of the random input mode.
+#define INPUT_STREAM    1
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+static Tetris game;
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Returns a monotonic time stamp in nanoseconds.
+//------------------------------------------------------------------------------
+static double Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the number of bits set in a word.
+//------------------------------------------------------------------------------
+static unsigned int CountBits(ULONG value)
+{
+    unsigned int count = 0;
+
+    for (; value; value &= value - 1) {
+
+        count++;
+    }
+    return count;
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    AIPlacement target;
+    Prng input;
+    unsigned long ticks = DEFAULT_TICKS, seed = 1, t;
+    unsigned long games = 0, pieces = 0, lines = 0, score = 0;
+    unsigned long clears[5] = {0, 0, 0, 0, 0};
+    unsigned int mode = MODE_AI, actions, events, n;
+    double start, elapsed;
+    int arg;
+
+    for (arg = 1; arg + 1 < argc; arg += 2) {
+
+        if (strcmp(argv[arg], "-t") == 0) {
+
+            ticks = strtoul(argv[arg + 1], 0, 0);
+        }
+        else if (strcmp(argv[arg], "-s") == 0) {
+
+            seed = strtoul(argv[arg + 1], 0, 0);
+        }
+        else if (strcmp(argv[arg], "-m") == 0 && strcmp(argv[arg + 1], "ai") == 0) {
+
+            mode = MODE_AI;
+        }
+        else if (strcmp(argv[arg], "-m") == 0 && strcmp(argv[arg + 1], "ai2") == 0) {
+
+            mode = MODE_AI2;
+        }
+        else if (strcmp(argv[arg], "-m") == 0 && strcmp(argv[arg + 1], "random") == 0) {
+
+            mode = MODE_RANDOM;
+        }
+        else {
+
+            break;
+        }
+    }
+    if (arg < argc) {
+
+        fprintf(stderr, "usage: %s [-t ticks] [-s seed] [-m ai|ai2|random]\n",
+                argv[0]);
+        return 2;
+    }
+
+    PRNG_Seed(&input, seed, INPUT_STREAM);
+    AI_ResetStats();
+    game.gameOver = 1;
+
+    start = Now();
+    for (t = 0; t < ticks; t++) {
+
+        if (game.gameOver) {
+
+            if (games) {
+
+                pieces += game.pieces;
+                lines += game.lines;
+                score += game.score;
+            }
+            TETRIS_Init(&game, seed + games++);
+            if (mode != MODE_RANDOM) {
+
+                AI_Search(&game, &aiDefaultWeights, mode == MODE_AI2, &target);
+            }
+        }
+
+        if (mode == MODE_RANDOM) {
+
+            // Mostly idle ticks, so pieces get time to fall and lock
+            n = PRNG_Next(&input);
+            actions = ((n & 0x3) == 0) ? (n >> 8) & 0x1F : 0;
+            if ((n >> 16) % 64 == 0) {
+
+                actions |= TETRIS_ACTION_HARD_DROP;
+            }
+        }
+        else {
+
+            actions = AI_Actions(&game, &target);
+        }
+
+        events = TETRIS_Tick(&game, actions);
+        if (events & TETRIS_EVENT_LOCKED) {
+
+            clears[CountBits(game.clearedRows)]++;
+        }
+        if ((events & TETRIS_EVENT_SPAWNED) && mode != MODE_RANDOM) {
+
+            AI_Search(&game, &aiDefaultWeights, mode == MODE_AI2, &target);
+        }
+    }
+    elapsed = Now() - start;
+
+    pieces += game.pieces;
+    lines += game.lines;
+    score += game.score;
+
+    printf("%lu ticks, %lu games, %lu pieces, %lu lines, score %lu\n",
+           ticks, games, pieces, lines, score);
+    printf("  %12.0f ticks/s\n", ticks / (elapsed / 1e9));
+    printf("  %12.0f pieces/s\n", pieces / (elapsed / 1e9));
+    if (mode != MODE_RANDOM) {
+
+        printf("  %12.0f placements/s evaluated by the AI\n",
+               aiStats.placements / (elapsed / 1e9));
+    }
+    printf("  %12.2f lines per 1000 ticks, %.3f lines per piece\n",
+           lines * 1000.0 / ticks, pieces ? (double) lines / pieces : 0.0);
+    printf("  clears: single %lu, double %lu, triple %lu, tetris %lu\n",
+           clears[1], clears[2], clears[3], clears[4]);
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+//------------------------------------------------------------------------------
+//         Input to photon latency
+//------------------------------------------------------------------------------
+
+#include "latency.h"
+
+#include <stdio.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Forgets all the samples.
+//------------------------------------------------------------------------------
+void LATENCY_Reset(Latency *pLatency)
+{
+    memset(pLatency, 0, sizeof(Latency));
+    pLatency->min = ~0;
+}
+
+//------------------------------------------------------------------------------
+/// Adds a sample.
+/// \param pLatency  Histogram.
+/// \param us  Latency in microseconds.
+//------------------------------------------------------------------------------
+void LATENCY_Add(Latency *pLatency, ULONG us)
+{
+    ULONG bin = us / LATENCY_BIN_US;
+
+    if (bin >= LATENCY_BINS) {
+
+        bin = LATENCY_BINS - 1;
+    }
+    // A full bin stops counting, the exact statistics go on
+    if (pLatency->bins[bin] != 0xFFFF) {
+
+        pLatency->bins[bin]++;
+    }
+    pLatency->count++;
+    pLatency->sum += us;
+    if (us < pLatency->min) {
+
+        pLatency->min = us;
+    }
+    if (us > pLatency->max) {
+
+        pLatency->max = us;
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Returns the upper bound of the bin holding a percentile.
+/// \param pLatency  Histogram.
+/// \param percent  Percentile, 1 to 100.
+/// \return Latency in microseconds, the maximum if the percentile falls in the
+/// last bin, 0 without samples.
+//------------------------------------------------------------------------------
+ULONG LATENCY_Percentile(const Latency *pLatency, unsigned int percent)
+{
+    ULONG total = 0, rank, seen = 0;
+    unsigned int bin;
+
+    for (bin = 0; bin < LATENCY_BINS; bin++) {
+
+        total += pLatency->bins[bin];
+    }
+    if (total == 0) {
+
+        return 0;
+    }
+
+    // Smallest bin with at least percent % of the samples at or below it
+    rank = (total * percent + 99) / 100;
+    for (bin = 0; bin < LATENCY_BINS - 1; bin++) {
+
+        seen += pLatency->bins[bin];
+        if (seen >= rank) {
+
+            return (bin + 1) * LATENCY_BIN_US;
+        }
+    }
+    return pLatency->max;
+}
+
+//------------------------------------------------------------------------------
+/// Prints the statistics and the non-empty bins on stdout (the DBGU).
+/// \param pName  What the samples measure, the first word of the output.
+//------------------------------------------------------------------------------
+void LATENCY_Print(const Latency *pLatency, const char *pName)
+{
+    unsigned int bin;
+
+    if (pLatency->count == 0) {
+
+        printf("-- %s: no samples --\n\r", pName);
+        return;
+    }
+    printf("-- %s samples=%u min=%u avg=%u p99<=%u max=%u us\n\r", pName,
+           (unsigned int) pLatency->count,
+           (unsigned int) pLatency->min,
+           (unsigned int) (pLatency->sum / pLatency->count),
+           (unsigned int) LATENCY_Percentile(pLatency, 99),
+           (unsigned int) pLatency->max);
+    for (bin = 0; bin < LATENCY_BINS; bin++) {
+
+        if (pLatency->bins[bin]) {
+
+            printf("%3u ms%s %u\n\r", bin * LATENCY_BIN_US / 1000,
+                   (bin == LATENCY_BINS - 1) ? "+" : " ",
+                   pLatency->bins[bin]);
+        }
+    }
+}
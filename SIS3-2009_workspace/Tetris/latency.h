@@ -0,0 +1,58 @@
+//------------------------------------------------------------------------------
+//         Input to photon latency
+//------------------------------------------------------------------------------
+//
+// Collects the time from the first edge of a button press to the end of the
+// SPI transfer of the frame showing its effect, which includes the debounce
+// period, the wait for the next logic tick and the render. Samples go into a
+// histogram of LATENCY_BINS bins of LATENCY_BIN_US microseconds (the last
+// bin takes everything above) next to the exact minimum, maximum and sum, so
+// the 99th percentile is known to one bin.
+//
+// The same histogram also collects the render time of every frame.
+//
+//------------------------------------------------------------------------------
+
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include "typedef.h"
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Histogram geometry: 1 ms bins up to 100 ms.
+#define LATENCY_BINS          100
+#define LATENCY_BIN_US        1000
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+
+    /// Samples and their count per bin.
+    ULONG count;
+    UWORD bins[LATENCY_BINS];
+
+    /// Exact statistics, in microseconds.
+    ULONG min;
+    ULONG max;
+    uint64_t sum;
+
+} Latency;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void LATENCY_Reset(Latency *pLatency);
+
+extern void LATENCY_Add(Latency *pLatency, ULONG us);
+
+extern ULONG LATENCY_Percentile(const Latency *pLatency, unsigned int percent);
+
+extern void LATENCY_Print(const Latency *pLatency, const char *pName);
+
+#endif //#ifndef __LATENCY_H__
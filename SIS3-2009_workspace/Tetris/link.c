@@ -0,0 +1,500 @@
+//------------------------------------------------------------------------------
+//         Versus link
+//------------------------------------------------------------------------------
+
+#include "link.h"
+#include "linkport.h"
+#include "replay.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// Packet types and sizes.
+#define PACKET_HELLO          0xC3
+#define PACKET_FRAME          0xA5
+#define PACKET_SYNC           0x5A
+#define HELLO_SIZE            12
+#define FRAME_SIZE            10
+#define SYNC_SIZE             12
+
+/// Ticks between two hello packets while connecting.
+#define HELLO_INTERVAL        10
+
+/// Bits of the TETRIS_ACTION_xxx flags.
+#define ACTIONS_MASK          0x3F
+
+/// Inputs repeated in every frame packet.
+#define FRAME_INPUTS          3
+
+#define HISTORY_MASK          (LINK_HISTORY - 1)
+#define ROLLBACK_MASK         (LINK_ROLLBACK - 1)
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Returns the Fletcher check of the bytes of a packet, whose last two bytes
+/// hold it. Unlike a plain sum it depends on the byte positions, so a packet
+/// that lost a byte and took one of the next packet is seldom accepted.
+//------------------------------------------------------------------------------
+static UWORD Check(const UBYTE *pPacket, unsigned int size)
+{
+    UBYTE sum = 0, sumOfSums = 0;
+
+    while (size--) {
+
+        sum += *pPacket++;
+        sumOfSums += sum;
+    }
+    return sum | (sumOfSums << 8);
+}
+
+//------------------------------------------------------------------------------
+/// Appends the check to a packet and queues it for transmission.
+//------------------------------------------------------------------------------
+static void Send(UBYTE *pPacket, unsigned int size)
+{
+    UWORD check = Check(pPacket, size - 2);
+
+    pPacket[size - 2] = check & 0xFF;
+    pPacket[size - 1] = check >> 8;
+    LINKPORT_Write(pPacket, size);
+}
+
+//------------------------------------------------------------------------------
+/// Expands a 16-bit tick number to the tick nearest to a reference tick.
+//------------------------------------------------------------------------------
+static ULONG Expand(ULONG reference, unsigned int low, unsigned int high)
+{
+    UWORD tick = low | (high << 8);
+
+    return reference + (SWORD) (tick - (UWORD) reference);
+}
+
+//------------------------------------------------------------------------------
+/// Sends a hello packet carrying the local nonce and the peer's.
+/// \param flags  LINK_HELLO_ANSWER for an answer to the peer's hello.
+//------------------------------------------------------------------------------
+static void SendHello(Link *pLink, unsigned int flags)
+{
+    UBYTE packet[HELLO_SIZE];
+
+    packet[0] = PACKET_HELLO;
+    packet[1] = pLink->nonce & 0xFF;
+    packet[2] = (pLink->nonce >> 8) & 0xFF;
+    packet[3] = (pLink->nonce >> 16) & 0xFF;
+    packet[4] = pLink->nonce >> 24;
+    packet[5] = pLink->peerNonce & 0xFF;
+    packet[6] = (pLink->peerNonce >> 8) & 0xFF;
+    packet[7] = (pLink->peerNonce >> 16) & 0xFF;
+    packet[8] = pLink->peerNonce >> 24;
+    packet[9] = flags;
+    Send(packet, HELLO_SIZE);
+}
+
+//------------------------------------------------------------------------------
+/// Sends the local inputs of a tick and of the two ticks before it.
+//------------------------------------------------------------------------------
+static void SendFrame(Link *pLink, ULONG tick)
+{
+    UBYTE packet[FRAME_SIZE];
+    unsigned int i;
+
+    packet[0] = PACKET_FRAME;
+    packet[1] = tick & 0xFF;
+    packet[2] = (tick >> 8) & 0xFF;
+    for (i = 0; i < FRAME_INPUTS; i++) {
+
+        packet[3 + i] = pLink->inputs[pLink->player][(tick - i) & HISTORY_MASK];
+    }
+    packet[6] = pLink->confirmed & 0xFF;
+    packet[7] = (pLink->confirmed >> 8) & 0xFF;
+    Send(packet, FRAME_SIZE);
+}
+
+//------------------------------------------------------------------------------
+/// Sends the hash of the confirmed state at the start of the last sync tick.
+/// \param flags  LINK_SYNC_ANSWER for an answer to the peer's hash.
+//------------------------------------------------------------------------------
+static void SendSync(Link *pLink, unsigned int flags)
+{
+    UBYTE packet[SYNC_SIZE];
+    ULONG tick = pLink->localSyncTick;
+    ULONG hash = pLink->localSyncHash;
+
+    if (pLink->peerSyncTick == tick) {
+
+        flags |= LINK_SYNC_HAVE;
+    }
+    packet[0] = PACKET_SYNC;
+    packet[1] = tick & 0xFF;
+    packet[2] = (tick >> 8) & 0xFF;
+    packet[3] = hash & 0xFF;
+    packet[4] = (hash >> 8) & 0xFF;
+    packet[5] = (hash >> 16) & 0xFF;
+    packet[6] = hash >> 24;
+    packet[7] = pLink->localSyncSent & 0xFF;
+    packet[8] = (pLink->localSyncSent >> 8) & 0xFF;
+    packet[9] = flags;
+    pLink->syncTimer = LINK_SYNC_RESEND;
+    Send(packet, SYNC_SIZE);
+}
+
+//------------------------------------------------------------------------------
+/// Compares the local and peer state hashes once both cover the same tick.
+//------------------------------------------------------------------------------
+static void CompareSync(Link *pLink)
+{
+    if (pLink->localSyncTick == pLink->peerSyncTick
+        && pLink->localSyncTick != 0) {
+
+        pLink->stats.syncs++;
+        if (pLink->localSyncHash != pLink->peerSyncHash) {
+
+            pLink->desync = 1;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Handles a complete packet with a valid check.
+//------------------------------------------------------------------------------
+static void Receive(Link *pLink, const UBYTE *pPacket)
+{
+    ULONG tick, nonce, echo;
+    unsigned int i, actions;
+    unsigned char fresh;
+
+    switch (pPacket[0]) {
+
+    case PACKET_HELLO:
+        nonce = pPacket[1] | (pPacket[2] << 8) | ((ULONG) pPacket[3] << 16)
+                | ((ULONG) pPacket[4] << 24);
+        echo = pPacket[5] | (pPacket[6] << 8) | ((ULONG) pPacket[7] << 16)
+               | ((ULONG) pPacket[8] << 24);
+        if (nonce == pLink->nonce) {
+
+            // Both units picked the same nonce (or hear their own echo)
+            break;
+        }
+        if (pLink->connected && nonce != pLink->peerNonce) {
+
+            // Not the unit this match is played with
+            break;
+        }
+        pLink->peerNonce = nonce;
+
+        // The peer keeps saying hello until its nonce comes back, answer
+        // even once connected since the last answer may have been lost
+        if (!(pPacket[9] & LINK_HELLO_ANSWER)) {
+
+            SendHello(pLink, LINK_HELLO_ANSWER);
+        }
+        if (pLink->connected || echo != pLink->nonce) {
+
+            break;
+        }
+        pLink->player = (pLink->nonce < nonce) ? 0 : 1;
+        pLink->peer = 1 - pLink->player;
+        VERSUS_Init(&pLink->state, pLink->nonce ^ nonce);
+        pLink->connected = 1;
+        break;
+
+    case PACKET_FRAME:
+        if (!pLink->connected) {
+
+            break;
+        }
+        if ((pPacket[3] | pPacket[4] | pPacket[5]) & ~ACTIONS_MASK) {
+
+            pLink->stats.errors++;
+            break;
+        }
+        tick = Expand(pLink->confirmed, pPacket[1], pPacket[2]);
+        pLink->peerConfirmed = Expand(pLink->peerConfirmed, pPacket[6], pPacket[7]);
+
+        // Take the inputs that extend the confirmed range, oldest first
+        for (i = FRAME_INPUTS; i-- > 0;) {
+
+            if (tick - i != pLink->confirmed) {
+
+                continue;
+            }
+            actions = pPacket[3 + i];
+            pLink->inputs[pLink->peer][pLink->confirmed & HISTORY_MASK] = actions;
+
+            // Already simulated with no actions predicted
+            if (pLink->confirmed < pLink->tick && actions != 0
+                && pLink->confirmed < pLink->rollbackFrom) {
+
+                pLink->rollbackFrom = pLink->confirmed;
+            }
+            pLink->confirmed++;
+        }
+        if ((SLONG) (tick - pLink->confirmed) >= 0) {
+
+            // Older inputs are missing, they will be sent again
+            pLink->stats.errors++;
+        }
+        break;
+
+    case PACKET_SYNC:
+        tick = Expand(pLink->syncTick, pPacket[1], pPacket[2]);
+        fresh = (tick != pLink->peerSyncTick);
+        pLink->peerSyncTick = tick;
+        pLink->peerSyncHash = pPacket[3] | (pPacket[4] << 8)
+                              | ((ULONG) pPacket[5] << 16)
+                              | ((ULONG) pPacket[6] << 24);
+        if (pLink->peerSyncTick != pLink->localSyncTick) {
+
+            // Not reached on this side yet, or skipped
+            break;
+        }
+        if (pPacket[9] & LINK_SYNC_HAVE) {
+
+            pLink->peerSyncAcked = pLink->peerSyncTick;
+        }
+
+        // The peer keeps sending its hash until it gets this answer
+        if (!(pPacket[9] & LINK_SYNC_ANSWER)) {
+
+            SendSync(pLink, LINK_SYNC_ANSWER);
+        }
+        if (fresh) {
+
+            CompareSync(pLink);
+        }
+        break;
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Reads the received bytes and handles the complete packets. Bytes that do
+/// not form a valid packet are skipped one at a time until the stream is in
+/// sync again.
+//------------------------------------------------------------------------------
+static void ReadPackets(Link *pLink)
+{
+    UBYTE bytes[32];
+    unsigned int count, i, size;
+
+    while ((count = LINKPORT_Read(bytes, sizeof(bytes))) > 0) {
+
+        for (i = 0; i < count; i++) {
+
+            pLink->rx[pLink->rxCount++] = bytes[i];
+            while (pLink->rxCount) {
+
+                switch (pLink->rx[0]) {
+
+                case PACKET_HELLO: size = HELLO_SIZE; break;
+                case PACKET_FRAME: size = FRAME_SIZE; break;
+                case PACKET_SYNC:  size = SYNC_SIZE; break;
+                default:           size = 0; break;
+                }
+                if (size && pLink->rxCount < size) {
+
+                    break;
+                }
+                if (size && Check(pLink->rx, size - 2)
+                            == (pLink->rx[size - 2] | (pLink->rx[size - 1] << 8))) {
+
+                    Receive(pLink, pLink->rx);
+                    pLink->silence = 0;
+                    pLink->rxCount = 0;
+                    break;
+                }
+                pLink->stats.errors++;
+                memmove(pLink->rx, pLink->rx + 1, --pLink->rxCount);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Saves the state and simulates one tick, predicting no actions for the
+/// peer when its input is not known yet.
+//------------------------------------------------------------------------------
+static void Simulate(Link *pLink)
+{
+    UBYTE actions[VERSUS_PLAYERS];
+    ULONG tick = pLink->tick;
+
+    memcpy(&pLink->saved[tick & ROLLBACK_MASK], &pLink->state, sizeof(Versus));
+
+    actions[pLink->player] = pLink->inputs[pLink->player][tick & HISTORY_MASK];
+    actions[pLink->peer] = (tick < pLink->confirmed) ?
+                           pLink->inputs[pLink->peer][tick & HISTORY_MASK] : 0;
+    VERSUS_Tick(&pLink->state, actions);
+    pLink->tick++;
+}
+
+//------------------------------------------------------------------------------
+/// Hashes the state at the start of the next sync tick once it is confirmed
+/// and still saved.
+//------------------------------------------------------------------------------
+static void Sync(Link *pLink)
+{
+    ULONG tick = pLink->syncTick;
+    const Versus *pState;
+
+    if (pLink->confirmed < tick || pLink->tick < tick) {
+
+        return;
+    }
+    pLink->syncTick += LINK_SYNC_INTERVAL;
+    if (pLink->tick - tick > LINK_ROLLBACK) {
+
+        // Confirmed too late, this one is skipped on this side
+        return;
+    }
+    pState = (pLink->tick == tick) ?
+             &pLink->state : &pLink->saved[tick & ROLLBACK_MASK];
+
+    pLink->localSyncTick = tick;
+    pLink->localSyncHash = LINK_Hash(pState);
+    pLink->localSyncSent = pState->sent[pLink->player];
+    SendSync(pLink, 0);
+    CompareSync(pLink);
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Prepares a link, the transport must be configured already.
+/// \param pLink  Link state.
+/// \param nonce  Random value; the unit with the lower one is player 0 and
+///               the match seed is derived from both.
+//------------------------------------------------------------------------------
+void LINK_Init(Link *pLink, ULONG nonce)
+{
+    memset(pLink, 0, sizeof(Link));
+    pLink->nonce = nonce;
+    pLink->rollbackFrom = ~0;
+    pLink->syncTick = LINK_SYNC_INTERVAL;
+}
+
+//------------------------------------------------------------------------------
+/// Looks for the peer, to be called once per tick until it returns 1. The
+/// peer may still be connecting then, LINK_Advance() waits for it.
+/// \param pLink  Link state.
+/// \return 1 once both units agreed on the players and the seed.
+//------------------------------------------------------------------------------
+unsigned char LINK_Connect(Link *pLink)
+{
+    if (!pLink->connected && pLink->helloTimer-- == 0) {
+
+        pLink->helloTimer = HELLO_INTERVAL;
+        SendHello(pLink, 0);
+    }
+    ReadPackets(pLink);
+    return pLink->connected;
+}
+
+//------------------------------------------------------------------------------
+/// Receives the peer's packets and corrects the mispredicted ticks. May be
+/// called more often than once per tick.
+/// \param pLink  Link state.
+//------------------------------------------------------------------------------
+void LINK_Poll(Link *pLink)
+{
+    ULONG target = pLink->tick;
+
+    ReadPackets(pLink);
+
+    if (pLink->rollbackFrom < target) {
+
+        memcpy(&pLink->state, &pLink->saved[pLink->rollbackFrom & ROLLBACK_MASK],
+               sizeof(Versus));
+        pLink->stats.rollbacks++;
+        pLink->stats.resimulated += target - pLink->rollbackFrom;
+        pLink->tick = pLink->rollbackFrom;
+        while (pLink->tick != target) {
+
+            Simulate(pLink);
+        }
+    }
+    pLink->rollbackFrom = ~0;
+
+    Sync(pLink);
+}
+
+//------------------------------------------------------------------------------
+/// Returns 1 if the next call to LINK_Advance() simulates a tick, 0 if it
+/// waits for the peer's inputs and drops the local ones.
+/// \param pLink  Link state.
+//------------------------------------------------------------------------------
+unsigned char LINK_Ready(const Link *pLink)
+{
+    return (SLONG) (pLink->tick - pLink->confirmed) < LINK_ROLLBACK;
+}
+
+//------------------------------------------------------------------------------
+/// Runs one tick of the match, call LINK_Poll() first and once per tick
+/// also while stalled, so the missing inputs are sent again and a silent
+/// peer is noticed.
+/// \param pLink  Link state.
+/// \param actions  Local TETRIS_ACTION_xxx flags, they apply LINK_DELAY
+///                 ticks later.
+/// \return 1 if the tick was simulated, 0 if the peer is too far behind and
+/// the local input was dropped (see LINK_Ready()).
+//------------------------------------------------------------------------------
+unsigned char LINK_Advance(Link *pLink, unsigned int actions)
+{
+    ULONG frame = pLink->tick + LINK_DELAY;
+
+    if (pLink->silence < LINK_TIMEOUT) {
+
+        pLink->silence++;
+    }
+    else {
+
+        pLink->lost = 1;
+    }
+
+    // Inputs the peer reported missing are sent again
+    if ((SLONG) (frame - FRAME_INPUTS - pLink->peerConfirmed) >= 0) {
+
+        SendFrame(pLink, pLink->peerConfirmed + FRAME_INPUTS - 1);
+    }
+
+    // So is the last state hash, until the peer has answered it
+    if (pLink->localSyncTick != 0
+        && (pLink->peerSyncTick != pLink->localSyncTick
+            || pLink->peerSyncAcked != pLink->localSyncTick)
+        && --pLink->syncTimer == 0) {
+
+        SendSync(pLink, 0);
+    }
+
+    if (!LINK_Ready(pLink)) {
+
+        // The last frame again, it shows the peer what is missing here and
+        // that this side is still alive
+        SendFrame(pLink, frame - 1);
+        pLink->stats.stalls++;
+        return 0;
+    }
+
+    pLink->inputs[pLink->player][frame & HISTORY_MASK] = actions;
+    SendFrame(pLink, frame);
+    Simulate(pLink);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Returns a hash of a match state.
+/// \param pVersus  Match state.
+//------------------------------------------------------------------------------
+ULONG LINK_Hash(const Versus *pVersus)
+{
+    return REPLAY_Hash(&pVersus->games[0])
+           ^ (REPLAY_Hash(&pVersus->games[1]) * 31)
+           ^ (pVersus->pending[0] << 8) ^ (pVersus->pending[1] << 16);
+}
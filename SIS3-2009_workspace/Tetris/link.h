@@ -0,0 +1,182 @@
+//------------------------------------------------------------------------------
+//         Versus link
+//------------------------------------------------------------------------------
+//
+// Both units simulate the whole versus match (both games and the garbage
+// between them) from the input frames of both players:
+//
+//    - the actions of local tick t are scheduled for tick t + LINK_DELAY and
+//      sent to the peer right away, which hides most of the link latency
+//    - when the peer's actions for a tick have not arrived yet, the tick is
+//      simulated anyway, predicting no actions, and the state before it is
+//      saved
+//    - when the actions arrive and differ from the prediction, the state is
+//      restored to that tick and the ticks since are simulated again
+//    - the simulation only stalls when it gets LINK_ROLLBACK ticks ahead of
+//      the last confirmed peer input; LINK_Ready() tells when, so the
+//      caller can leave the local input queued meanwhile
+//    - the link is lost when nothing arrives from the peer for LINK_TIMEOUT
+//      ticks; a stalled unit sends its last frame again every tick, so a
+//      peer that is alive is never silent that long
+//
+// Each unit sends a hello every few ticks while connecting; a hello that is
+// not an answer is answered with one that echoes its nonce, also once
+// connected, and a unit only connects when its own nonce comes back. So a
+// lost hello or answer only costs the next hello, and neither unit starts
+// the match before the peer knows it.
+//
+// Every frame packet repeats the two previous inputs and acknowledges the
+// peer's inputs received so far; inputs the peer is still missing are sent
+// again, so a corrupted packet does not stall the match. Every
+// LINK_SYNC_INTERVAL ticks both sides exchange a hash of the confirmed state
+// and the garbage sent so far, to detect desynchronization. A hash is sent
+// again every LINK_SYNC_RESEND ticks until the peer answers with its own
+// hash for the same tick and reports having ours; the answer is never
+// answered, so a lost hash or answer only costs a resend.
+//
+// Packets (c0 c1 = Fletcher check of the previous bytes):
+//    0xC3 n0 n1 n2 n3 e0 e1 e2 e3 f c0 c1       hello, with a random nonce,
+//                                               the peer's nonce (0 if not
+//                                               known yet) and
+//                                               LINK_HELLO_xxx flags
+//    0xA5 t0 t1 a(t) a(t-1) a(t-2) k0 k1 c0 c1  input frame, k = ack
+//    0x5A t0 t1 h0 h1 h2 h3 g0 g1 f c0 c1       state hash, garbage sent and
+//                                               LINK_SYNC_xxx flags
+//
+//------------------------------------------------------------------------------
+
+#ifndef __LINK_H__
+#define __LINK_H__
+
+#include "typedef.h"
+#include "versus.h"
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Ticks between a local input and the tick it applies to.
+#define LINK_DELAY            2
+/// Most ticks simulated ahead of the confirmed peer input (power of two).
+#define LINK_ROLLBACK         8
+/// Input history per player (power of two, more than 2 * LINK_ROLLBACK +
+/// LINK_DELAY).
+#define LINK_HISTORY          32
+/// Ticks between two state hash exchanges.
+#define LINK_SYNC_INTERVAL    64
+/// Ticks between two sends of a state hash the peer has not answered.
+#define LINK_SYNC_RESEND      8
+/// Ticks without a packet from the peer before the link is lost.
+#define LINK_TIMEOUT          (5 * TETRIS_TICKS_PER_SECOND)
+
+/// Flags of a state hash packet: the sender has the receiver's hash for the
+/// same tick, and the packet answers one of the receiver's.
+#define LINK_SYNC_HAVE        0x01
+#define LINK_SYNC_ANSWER      0x02
+
+/// Flag of a hello packet: the packet answers one of the receiver's.
+#define LINK_HELLO_ANSWER     0x01
+
+/// Longest packet.
+#define LINK_PACKET_SIZE      12
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+
+    /// Rollbacks, and ticks simulated again by them.
+    ULONG rollbacks;
+    ULONG resimulated;
+
+    /// Calls to LINK_Advance() that had to wait for the peer.
+    ULONG stalls;
+
+    /// Bytes skipped because of a bad check, and frames received out of
+    /// sequence.
+    ULONG errors;
+
+    /// State hashes compared with the peer.
+    ULONG syncs;
+
+} LinkStats;
+
+typedef struct {
+
+    /// Match state at the start of tick 'tick'.
+    Versus state;
+
+    /// State at the start of each of the last LINK_ROLLBACK ticks.
+    Versus saved[LINK_ROLLBACK];
+
+    /// Actions of both players, indexed by tick modulo LINK_HISTORY.
+    UBYTE inputs[VERSUS_PLAYERS][LINK_HISTORY];
+
+    /// Next tick to simulate.
+    ULONG tick;
+
+    /// The peer's actions are known for every tick before this one.
+    ULONG confirmed;
+
+    /// First tick simulated with a wrong prediction, or ~0 if none.
+    ULONG rollbackFrom;
+
+    /// The peer has received our inputs for every tick before this one.
+    ULONG peerConfirmed;
+
+    /// Local player index, and the peer's.
+    UBYTE player;
+    UBYTE peer;
+
+    /// Local and peer nonces, the peer's is known once it said hello.
+    UBYTE connected;
+    ULONG nonce;
+    ULONG peerNonce;
+    UWORD helloTimer;
+
+    /// Next tick whose state hash is exchanged, and the hashes of the last
+    /// exchange.
+    ULONG syncTick;
+    ULONG localSyncTick;
+    ULONG localSyncHash;
+    UWORD localSyncSent;
+    ULONG peerSyncTick;
+    ULONG peerSyncHash;
+    UBYTE desync;
+
+    /// Last tick whose local hash the peer reported having, and ticks until
+    /// the local hash is sent again.
+    ULONG peerSyncAcked;
+    UWORD syncTimer;
+
+    /// Ticks since the last packet from the peer, and set once they reached
+    /// LINK_TIMEOUT.
+    UWORD silence;
+    UBYTE lost;
+
+    /// Packet being received.
+    UBYTE rx[LINK_PACKET_SIZE];
+    UBYTE rxCount;
+
+    LinkStats stats;
+
+} Link;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void LINK_Init(Link *pLink, ULONG nonce);
+
+extern unsigned char LINK_Connect(Link *pLink);
+
+extern void LINK_Poll(Link *pLink);
+
+extern unsigned char LINK_Ready(const Link *pLink);
+
+extern unsigned char LINK_Advance(Link *pLink, unsigned int actions);
+
+extern ULONG LINK_Hash(const Versus *pVersus);
+
+#endif //#ifndef __LINK_H__
@@ -0,0 +1,31 @@
+//------------------------------------------------------------------------------
+//         Link transport
+//------------------------------------------------------------------------------
+//
+// Byte transport used by the versus link. Neither call ever waits:
+//    - linkport_usart.c: USART0 with PDC transfers in both directions (target)
+//    - linkport_host.c: a pair of non-blocking file descriptors, e.g. pipes
+//      or a pty (host)
+//
+//------------------------------------------------------------------------------
+
+#ifndef __LINKPORT_H__
+#define __LINKPORT_H__
+
+#include "typedef.h"
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+#ifdef HOST
+extern void LINKPORT_Open(int fdIn, int fdOut);
+#else
+extern void LINKPORT_Configure(void);
+#endif
+
+extern unsigned char LINKPORT_Write(const UBYTE *pData, unsigned int size);
+
+extern unsigned int LINKPORT_Read(UBYTE *pData, unsigned int size);
+
+#endif //#ifndef __LINKPORT_H__
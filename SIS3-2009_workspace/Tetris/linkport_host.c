@@ -0,0 +1,111 @@
+//------------------------------------------------------------------------------
+//         Link transport over file descriptors (host)
+//------------------------------------------------------------------------------
+//
+// Lets two host processes play a linked versus match over a pair of pipes,
+// or one host process talk to a board through a serial port or pty.
+//
+//------------------------------------------------------------------------------
+
+#include "linkport.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// Bytes that may wait for the other side to drain the pipe.
+#define TX_SIZE           4096
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+static int input = -1;
+static int output = -1;
+
+static UBYTE txBuffer[TX_SIZE];
+static unsigned int txCount;
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Writes as much of the pending output as the descriptor accepts.
+//------------------------------------------------------------------------------
+static void Flush(void)
+{
+    ssize_t written;
+    unsigned int i;
+
+    if (txCount == 0) {
+
+        return;
+    }
+    written = write(output, txBuffer, txCount);
+    if (written <= 0) {
+
+        return;
+    }
+    for (i = written; i < txCount; i++) {
+
+        txBuffer[i - written] = txBuffer[i];
+    }
+    txCount -= written;
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Selects the descriptors of the link and makes them non-blocking.
+/// \param fdIn  Descriptor the peer's bytes are read from.
+/// \param fdOut  Descriptor the bytes for the peer are written to.
+//------------------------------------------------------------------------------
+void LINKPORT_Open(int fdIn, int fdOut)
+{
+    input = fdIn;
+    output = fdOut;
+    fcntl(input, F_SETFL, fcntl(input, F_GETFL) | O_NONBLOCK);
+    fcntl(output, F_SETFL, fcntl(output, F_GETFL) | O_NONBLOCK);
+    txCount = 0;
+}
+
+//------------------------------------------------------------------------------
+/// Queues a packet for transmission.
+/// \return 1 if the whole packet was queued, 0 if there was no room for it.
+//------------------------------------------------------------------------------
+unsigned char LINKPORT_Write(const UBYTE *pData, unsigned int size)
+{
+    unsigned int i;
+
+    Flush();
+    if (txCount + size > TX_SIZE) {
+
+        return 0;
+    }
+    for (i = 0; i < size; i++) {
+
+        txBuffer[txCount++] = pData[i];
+    }
+    Flush();
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Copies the bytes received so far.
+/// \return Number of bytes copied.
+//------------------------------------------------------------------------------
+unsigned int LINKPORT_Read(UBYTE *pData, unsigned int size)
+{
+    ssize_t count;
+
+    Flush();
+    // Nothing received yet (EAGAIN) and a closed peer both read as 0 bytes
+    count = read(input, pData, size);
+    return (count > 0) ? count : 0;
+}
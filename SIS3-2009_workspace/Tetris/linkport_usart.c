@@ -0,0 +1,90 @@
+//------------------------------------------------------------------------------
+//         Link transport over USART0
+//------------------------------------------------------------------------------
+//
+// Both directions go through rings that the PDC fills and empties on its
+// own, both of its banks following the free space or the data of the ring;
+// the calls below only move the indexes and copy the packets.
+//
+//------------------------------------------------------------------------------
+
+#include "linkport.h"
+
+#include <board.h>
+#include <pio/pio.h>
+#include <pmc/pmc.h>
+#include <usart/usart.h>
+#include <utility/ring.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+#define LINK_USART        AT91C_BASE_US0
+#define LINK_USART_ID     AT91C_ID_US0
+#define LINK_BAUDRATE     115200
+
+/// Size of the receive ring, must be a power of two.
+#define RX_SIZE           256
+
+/// Size of the transmit ring, must be a power of two.
+#define TX_SIZE           128
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+static const Pin usartPins[] = {PIN_USART0_RXD, PIN_USART0_TXD};
+
+RING_DECLARE(rxRing, UBYTE, RX_SIZE);
+RING_DECLARE(txRing, UBYTE, TX_SIZE);
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Configures USART0 and starts the reception.
+//------------------------------------------------------------------------------
+void LINKPORT_Configure(void)
+{
+    PIO_Configure(usartPins, PIO_LISTSIZE(usartPins));
+    PMC_EnablePeripheral(LINK_USART_ID);
+    USART_Configure(LINK_USART, USART_MODE_ASYNCHRONOUS, LINK_BAUDRATE, BOARD_MCK);
+
+    USART_ReadRing(LINK_USART, &rxRing);
+
+    USART_SetTransmitterEnabled(LINK_USART, 1);
+    USART_SetReceiverEnabled(LINK_USART, 1);
+}
+
+//------------------------------------------------------------------------------
+/// Queues a packet for transmission.
+/// \param pData  Packet.
+/// \param size  Packet size.
+/// \return 1 if the whole packet was queued, 0 if there was no room for it.
+//------------------------------------------------------------------------------
+unsigned char LINKPORT_Write(const UBYTE *pData, unsigned int size)
+{
+    USART_WriteRing(LINK_USART, &txRing);
+    if (RING_Space(&txRing) < size) {
+
+        return 0;
+    }
+    RING_Push(&txRing, pData, size);
+    USART_WriteRing(LINK_USART, &txRing);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Copies the bytes received so far.
+/// \param pData  Destination buffer.
+/// \param size  Size of the destination buffer.
+/// \return Number of bytes copied.
+//------------------------------------------------------------------------------
+unsigned int LINKPORT_Read(UBYTE *pData, unsigned int size)
+{
+    USART_WriteRing(LINK_USART, &txRing);
+    USART_ReadRing(LINK_USART, &rxRing);
+    return RING_Pop(&rxRing, pData, size);
+}
@@ -0,0 +1,1155 @@
+//  ****************************************************************************
+//                          main.c
+//
+//      Tetris for the Olimex SAM7-EX256
+//
+//      Joystick left/right : move
+//      Joystick up         : rotate clockwise
+//      Joystick down       : soft drop
+//      Joystick button     : hard drop
+//      SWITCH1             : rotate counter-clockwise
+//      SWITCH2             : new game
+//
+//      SWITCH2 on the title screen starts a versus match against a second
+//      board linked through USART0 (RXD/TXD crossed, common ground); SWITCH2
+//      returns to the title once the match is over.
+//
+//      The AI plays a demo when the title screen is left alone, any button
+//      returns to the title; the perfect clear solver searches ahead in the
+//      idle time of every frame and takes over when it finds a combo.
+//      Holding SWITCH1 at reset runs the AI and solver benchmarks and prints
+//      the results on the DBGU.
+//
+//      Every game is recorded; sending 'r' on the DBGU prints the replay log
+//      of the current game, for the host tool replay-verify. Sending 'l'
+//      prints the histogram of the input to photon latency: from the first
+//      edge of a button press to the end of the SPI transfer of the frame
+//      that shows what it did, 'f' the histogram of the render time of the
+//      frames, and 'u' the load of the core since the previous 'u': it
+//      sleeps between the logic ticks.
+//
+//      Sending 'o' streams the button events of the next games on the DBGU,
+//      and 'i' plays back such a stream: a session starts a game with its
+//      seed, even from the title or the demo, and its events go through the
+//      input driver as if the buttons had been pressed (see session.h and
+//      session.py).
+//
+//      Built with CRITICAL_PROFILE=1, 'p' prints the critical sections that
+//      held the interrupts back the longest, the flash writes of the saves
+//      among them, and 'c' clears their statistics.
+//
+//      The game is saved to the flash every minute, when a piece locks;
+//      after a power cycle it resumes from the last save, without the title.
+//  ****************************************************************************
+
+//  ****************************************************************************
+//                Header Files
+//  ****************************************************************************
+
+#include <board.h>
+#include <pio/pio.h>
+#include <pit/pit.h>
+#include <pmc/pmc.h>
+#include <aic/aic.h>
+#include <dbgu/dbgu.h>
+#include <input/input.h>
+#include <utility/trace.h>
+#include <utility/timestamp.h>
+#include <utility/critical.h>
+#include <utility/ring.h>
+#include "lcd/lcd.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "typedef.h"
+#include "tetris.h"
+#include "control.h"
+#include "ai.h"
+#include "solver.h"
+#include "replay.h"
+#include "link.h"
+#include "linkport.h"
+#include "savestate.h"
+#include "latency.h"
+#include "session.h"
+#include "criticalSection.h"
+
+
+//  ****************************************************************************
+//     Defines
+//  ****************************************************************************
+// Playfield geometry on the LCD (x = row from the top, y = column)
+#define CELL_SIZE          6
+#define FIELD_TOP          6
+#define FIELD_LEFT         8
+#define INFO_LEFT          (FIELD_LEFT + TETRIS_WIDTH * CELL_SIZE + 8)
+
+// Logic ticks run before the loop gives up catching up and drops time
+#define MAX_CATCH_UP       4
+
+// Title screen idle time before the demo starts, in logic ticks
+#define DEMO_TIMEOUT       (10 * TETRIS_TICKS_PER_SECOND)
+
+// Pieces placed by the boot time AI benchmark
+#define BENCH_PIECES       1000
+
+// Placements the solver tries between two checks for a pending tick, and
+// nodes searched by the boot time solver benchmark
+#define SOLVER_NODES       32
+#define BENCH_NODES        20000
+
+// Smallest sequence value the demo follows the solver for: a combo of two
+// pieces, or any perfect clear
+#define SOLVER_STEER       2
+
+// Critical section sites the 'p' command prints
+#define PROFILE_SITES      8
+
+// Least logic ticks between two saves of the game to the flash; every save
+// wears a flash page (see savestate.h), a power cycle loses at most this
+// much play
+#define SAVE_INTERVAL      (60 * TETRIS_TICKS_PER_SECOND)
+
+// Logic ticks a button must be stable before a press or release counts:
+// between 17 and 33 ms
+#define DEBOUNCE_TICKS     2
+
+// Latency probe: no press being measured, press waiting for the tick that
+// handles it, press waiting for the frame that shows it
+#define PROBE_IDLE         0
+#define PROBE_INPUT        1
+#define PROBE_DRAW         2
+
+// Bytes received on the DBGU and not read yet the ring holds, a power of
+// two; a session sent too far ahead of its time loses the rest
+#define RX_SIZE            256
+
+// Session played back from the DBGU: none (the DBGU takes commands), its
+// records being read, or its game waiting for the next tick to start
+#define PLAYBACK_OFF       0
+#define PLAYBACK_ON        1
+#define PLAYBACK_START     2
+
+// Streaming of the button events: off, waiting for the next game, on
+#define STREAM_OFF         0
+#define STREAM_ARMED       1
+#define STREAM_ON          2
+
+// LCD size in pixels
+#define LCD_SIZE           132
+
+// Choices of the title screen
+#define MODE_DEMO          0
+#define MODE_SINGLE        1
+#define MODE_VERSUS        2
+
+
+//  ****************************************************************************
+//     Consts
+//  ****************************************************************************
+//  PIO pins configuration; the buttons in the order of the CONTROL_BUTTON_xxx
+//  bits, which are also their INPUT_GetState() bits
+static const Pin button_pins[]   = {
+   PIN_JOYSTICK_LEFT, PIN_JOYSTICK_RIGHT, PIN_JOYSTICK_UP, PIN_JOYSTICK_DOWN,
+   PIN_JOYSTICK_BUTTON, PIN_SWITCH1, PIN_SWITCH2
+};
+static const Pin debug_pins[]    = {PINS_DBGU};
+
+// Colour of every cell value (0 = empty, piece type + 1 or TETRIS_GARBAGE
+// otherwise)
+static const int cellColors[TETRIS_GARBAGE + 1] = {
+   BLACK, CYAN, YELLOW, MAGENTA, GREEN, RED, BLUE, ORANGE, BROWN
+};
+
+
+//  ****************************************************************************
+//     Globals
+//  ****************************************************************************
+static Tetris game;
+static Control control;
+static AIPlacement target;
+static Solver solver;
+// Transposition table of the solver, a few kilobytes of the 64 KB SRAM
+static ULONG solverArena[SOLVER_ARENA_TARGET / sizeof(ULONG)];
+static Replay replay;
+static Link link;
+static UBYTE saveBuffer[TETRIS_SAVE_SIZE];
+// Set when the game was resumed from the flash, it has no replay log
+static UBYTE resumed = 0;
+
+// Colour index of every playfield cell as the LCD shows it, and the counters
+// drawn beside the field; LCDClearScreen() leaves every cell empty
+static UBYTE drawn[TETRIS_HEIGHT][TETRIS_WIDTH];
+static ULONG drawnScore, drawnLines;
+static UBYTE drawnOver;
+
+// Input to photon latency, and the press being measured (time stamp of its
+// first edge, PROBE_xxx)
+static Latency latency;
+static ULONG probeStart;
+static UBYTE probeState = PROBE_IDLE;
+// Render time of the frames
+static Latency frameTimes;
+
+// Frame sent to the LCD and waiting for the end of its transfer: its start,
+// whether it shows the press being measured and the first edge of that
+// press, and the time stamp the SPI interrupt takes once the last byte is
+// out
+static UBYTE framePending = 0;
+static UBYTE frameProbe;
+static ULONG frameStart, frameProbeStart;
+static volatile ULONG frameEnd;
+static volatile UBYTE frameDone;
+
+// Bytes received on the DBGU: the PDC fills the ring, even while the main
+// loop is busy for a whole frame, and the main loop empties it
+RING_DECLARE(rxRing, UBYTE, RX_SIZE);
+
+// Session played back (PLAYBACK_xxx), its decoder, the record waiting for
+// room in the injection queue, the seed of its game and the tick its last
+// record was due at
+static UBYTE playback = PLAYBACK_OFF;
+static SessionParser parser;
+static SessionRecord record;
+static UBYTE recordHeld = 0;
+static ULONG playbackSeed;
+static ULONG playbackTick;
+
+// Streaming of the button events (STREAM_xxx), and the tick of the last
+// record sent
+static UBYTE streaming = STREAM_OFF;
+static ULONG streamTick;
+
+// Logic ticks elapsed, advanced by the PIT interrupt only
+static volatile ULONG tickCount = 0;
+// Raised by the PIT interrupt, cleared by the main loop
+static volatile UBYTE tickFlag = 0;
+
+// Microseconds the core slept waiting for a tick and its wake ups, since the
+// logic tick loadTick; the 'u' command prints them and starts again
+static ULONG idleUs, wakeups, loadTick;
+
+
+//  ****************************************************************************
+//     Interrupt handler of the system peripherals (PIT)
+//  ****************************************************************************
+
+void ISR_System_Interrupt(void)
+{
+   unsigned int status;
+
+   // Get PIT status
+   status = PIT_GetStatus();
+
+   // Periodic interval has elapsed?
+   if ((status & AT91C_PITC_PITS) == AT91C_PITC_PITS) {
+      // acknowledge the interrupt, PICNT holds the periods elapsed since the
+      // last acknowledge so no tick is lost if the interrupt was held off
+      tickCount += PIT_GetPIVR() >> 20;
+      tickFlag = 1;
+      INPUT_Tick(tickCount);
+   }
+}
+
+
+//  ****************************************************************************
+//     Interrupt handler of the SPI, end of the transfer of a frame
+//  ****************************************************************************
+
+void ISR_Spi(void)
+{
+   frameEnd = TIMESTAMP_Now();
+   AT91C_BASE_SPI0->SPI_IDR = AT91C_SPI_TXEMPTY;
+   frameDone = 1;
+}
+
+
+// Returns the microseconds from a time stamp to the end of the transfer of
+// the last frame; longer than a second counts as a second
+static ULONG Elapsed(ULONG start)
+{
+   ULONG counts;
+
+   counts = frameEnd - start;
+
+   if (counts > TIMESTAMP_FREQUENCY) {
+      counts = TIMESTAMP_FREQUENCY;
+   }
+   return TIMESTAMP_ToUs(counts);
+}
+
+
+//  ****************************************************************************
+//     Idle
+//  ****************************************************************************
+
+// Stops the core until the next logic tick, and takes it. The flag is
+// checked with the IRQ masked, so a tick counted meanwhile wakes the core up
+// instead of being missed; the interrupt that woke it runs once the IRQ is
+// unmasked again.
+static void WaitTick(void)
+{
+   unsigned int cpsr;
+   ULONG start;
+
+   while (1) {
+      cpsr = CRITICAL_Lock();
+      if (tickFlag) {
+         tickFlag = 0;
+         CRITICAL_Unlock(cpsr);
+         return;
+      }
+      start = TIMESTAMP_Now();
+      CRITICAL_Suspend();
+      PMC_DisableProcessorClock();
+      CRITICAL_Resume();
+      idleUs += TIMESTAMP_ToUs(TIMESTAMP_Now() - start);
+      wakeups++;
+      CRITICAL_Unlock(cpsr);
+   }
+}
+
+// Prints the load of the core and its wake ups since the previous call on
+// the DBGU
+static void ShowLoad(void)
+{
+   ULONG ms = (tickCount - loadTick) * 1000 / TETRIS_TICKS_PER_SECOND;
+   ULONG idle;
+   unsigned int busy;
+
+   // Microseconds idle per millisecond are the idle time in per mille
+   idle = ms ? idleUs / ms : 0;
+   busy = (idle < 1000) ? 1000 - idle : 0;
+   printf("-- load %u.%u %%, %u wake ups --\n\r", busy / 10, busy % 10,
+          (unsigned int) wakeups);
+
+   idleUs = 0;
+   wakeups = 0;
+   loadTick = tickCount;
+}
+
+
+//  ****************************************************************************
+//     Drawing
+//  ****************************************************************************
+
+// Opens a drawing window on the LCD, pixel rows x0..x1 and columns y0..y1,
+// for the pixels written next
+static void SetWindow(int x0, int y0, int x1, int y1)
+{
+   WriteSpiCommand(PASET);
+   WriteSpiData(x0);
+   WriteSpiData(x1);
+   WriteSpiCommand(CASET);
+   WriteSpiData(y0);
+   WriteSpiData(y1);
+   WriteSpiCommand(RAMWR);
+}
+
+// Fills the cells col0..col1 of a playfield row with one colour. Unlike
+// LCDSetRect(), writes exactly the pixels of the window: the 130 extra pixel
+// pairs it adds would cost more than the cells themselves.
+static void FillCells(int row, int col0, int col1, int color)
+{
+   int x = FIELD_TOP + (TETRIS_HEIGHT - 1 - row) * CELL_SIZE;
+   int y = FIELD_LEFT + col0 * CELL_SIZE;
+   int pairs = (col1 - col0 + 1) * CELL_SIZE * CELL_SIZE / 2;
+
+   SetWindow(x, y, x + CELL_SIZE - 1, y + (col1 - col0 + 1) * CELL_SIZE - 1);
+   while (pairs--) {
+      WriteSpiData((color >> 4) & 0xFF);
+      WriteSpiData(((color & 0xF) << 4) | ((color >> 8) & 0xF));
+      WriteSpiData(color & 0xFF);
+   }
+   WriteSpiCommand(NOP);
+}
+
+// Clears the LCD; the next DrawGame() then draws the occupied cells and the
+// counters only
+static void ClearScreen(void)
+{
+   LCDClearScreen();
+   memset(drawn, 0, sizeof(drawn));
+   drawnScore = drawnLines = ~0;
+   drawnOver = 0;
+}
+
+// Draws the cells that differ from what the LCD shows: rows the active piece
+// does not cover and whose colours did not change are skipped outright, and
+// consecutive changed cells of the same colour share one window. A falling
+// piece costs a window or two per row it leaves or enters, a line clear only
+// the rows above it that look different afterwards.
+static void DrawField(const Tetris *pGame)
+{
+   const PieceShape *pShape = &pieceShapes[pGame->piece.type][pGame->piece.rot];
+   UBYTE cells[TETRIS_WIDTH];
+   unsigned int pieceBits;
+   int row, col, first, r;
+
+   for (row = 0; row < TETRIS_HEIGHT; row++) {
+
+      // Columns the active piece covers in this row
+      r = row - pGame->piece.y;
+      pieceBits = 0;
+      if (r >= pShape->bottom && r <= pShape->top) {
+         pieceBits = (pGame->piece.x >= 0) ?
+                     pShape->rows[r] << pGame->piece.x :
+                     pShape->rows[r] >> -pGame->piece.x;
+      }
+      if (!pieceBits
+          && memcmp(pGame->colors[row], drawn[row], TETRIS_WIDTH) == 0) {
+         continue;
+      }
+
+      for (col = 0; col < TETRIS_WIDTH; col++) {
+         cells[col] = (pieceBits & (1 << col)) ?
+                      pGame->piece.type + 1 : pGame->colors[row][col];
+      }
+      col = 0;
+      while (col < TETRIS_WIDTH) {
+         if (cells[col] == drawn[row][col]) {
+            col++;
+            continue;
+         }
+         first = col;
+         while (col < TETRIS_WIDTH && cells[col] == cells[first]
+                && cells[col] != drawn[row][col]) {
+            col++;
+         }
+         FillCells(row, first, col - 1, cellColors[cells[first]]);
+      }
+      memcpy(drawn[row], cells, TETRIS_WIDTH);
+   }
+}
+
+static void DrawGame(const Tetris *pGame)
+{
+   static char s[16];
+
+   DrawField(pGame);
+
+   if (pGame->score != drawnScore) {
+      snprintf(s, sizeof(s), "%6u", (unsigned int) pGame->score);
+      LCDPutStr(s, 20, INFO_LEFT, SMALL, WHITE, BLACK);
+      drawnScore = pGame->score;
+   }
+   if (pGame->lines != drawnLines) {
+      snprintf(s, sizeof(s), "L%5u", (unsigned int) pGame->lines);
+      LCDPutStr(s, 30, INFO_LEFT, SMALL, WHITE, BLACK);
+      drawnLines = pGame->lines;
+   }
+   if (pGame->gameOver && !drawnOver) {
+      LCDPutStr("GAME", 50, INFO_LEFT, SMALL, RED, BLACK);
+      LCDPutStr("OVER", 60, INFO_LEFT, SMALL, RED, BLACK);
+      drawnOver = 1;
+   }
+}
+
+
+// Draws the whole screen with one drawing window, in a single pass of two
+// pixels per three bytes: far fewer SPI transfers than clearing the screen
+// and drawing every cell in its own window. Used to show a resumed game.
+static void FlushScreen(const Tetris *pGame)
+{
+   static UBYTE grid[TETRIS_HEIGHT][TETRIS_WIDTH];
+   static int line[LCD_SIZE];
+   const PieceShape *pShape;
+   int x, y, row, col, r, c, c0, c1, color;
+
+   // Locked cells with the active piece on top
+   for (row = 0; row < TETRIS_HEIGHT; row++) {
+      for (col = 0; col < TETRIS_WIDTH; col++) {
+         grid[row][col] = pGame->colors[row][col];
+      }
+   }
+   pShape = &pieceShapes[pGame->piece.type][pGame->piece.rot];
+   for (r = pShape->bottom; r <= pShape->top; r++) {
+      row = pGame->piece.y + r;
+      for (c = pShape->left; c <= pShape->right; c++) {
+         if ((pShape->rows[r] & (1 << c)) && row < TETRIS_HEIGHT) {
+            grid[row][pGame->piece.x + c] = pGame->piece.type + 1;
+         }
+      }
+   }
+
+   SetWindow(0, 0, LCD_SIZE - 1, LCD_SIZE - 1);
+
+   for (y = 0; y < LCD_SIZE; y++) {
+      line[y] = BLACK;
+   }
+   row = TETRIS_HEIGHT;
+   for (x = 0; x < LCD_SIZE; x++) {
+
+      // A new row of cells starts every CELL_SIZE pixel rows
+      if (x >= FIELD_TOP && x < FIELD_TOP + TETRIS_HEIGHT * CELL_SIZE
+          && (x - FIELD_TOP) % CELL_SIZE == 0) {
+         row--;
+         for (col = 0; col < TETRIS_WIDTH; col++) {
+            color = cellColors[grid[row][col]];
+            for (c = 0; c < CELL_SIZE; c++) {
+               line[FIELD_LEFT + col * CELL_SIZE + c] = color;
+            }
+         }
+      }
+      else if (x == FIELD_TOP + TETRIS_HEIGHT * CELL_SIZE) {
+         for (y = 0; y < LCD_SIZE; y++) {
+            line[y] = BLACK;
+         }
+      }
+
+      for (y = 0; y < LCD_SIZE; y += 2) {
+         c0 = line[y];
+         c1 = line[y + 1];
+         WriteSpiData((c0 >> 4) & 0xFF);
+         WriteSpiData(((c0 & 0xF) << 4) | ((c1 >> 8) & 0xF));
+         WriteSpiData(c1 & 0xFF);
+      }
+   }
+   WriteSpiCommand(NOP);
+
+   // The LCD now shows the field, the counters are still to be drawn
+   memcpy(drawn, grid, sizeof(drawn));
+   drawnScore = drawnLines = ~0;
+   drawnOver = 0;
+}
+
+
+//  ****************************************************************************
+//     Serial
+//  ****************************************************************************
+
+// Takes the next byte received on the DBGU, returns 0 if there is none
+static UBYTE ReadSerial(UBYTE *pByte)
+{
+   DBGU_ReadRing(&rxRing);
+   return RING_Pop(&rxRing, pByte, 1);
+}
+
+// Sends binary data on the DBGU, next to the printf() text
+static void WriteSerial(const UBYTE *pData, unsigned int length)
+{
+   while (length--) {
+      DBGU_PutChar(*pData++);
+   }
+}
+
+
+//  ****************************************************************************
+//     Input
+//  ****************************************************************************
+
+// Returns the CONTROL_BUTTON_xxx flags of the buttons held now or pressed
+// since the last call: a tap released before this call still counts for
+// one tick
+static unsigned int ReadButtons(void)
+{
+   InputEvent event;
+   unsigned int buttons = INPUT_GetState();
+   UBYTE bytes[SESSION_MAX_EVENT];
+   unsigned int length;
+
+   while (INPUT_GetEvent(&event)) {
+      if (streaming == STREAM_ON) {
+         length = SESSION_EncodeEvent(bytes, event.button, event.type,
+                                      event.tick - streamTick);
+         streamTick = event.tick;
+         WriteSerial(bytes, length);
+      }
+      if (event.type == INPUT_PRESS) {
+         buttons |= 1 << event.button;
+         // Measure the latency of one press at a time
+         if (probeState == PROBE_IDLE) {
+            probeStart = event.time;
+            probeState = PROBE_INPUT;
+         }
+      }
+   }
+   return buttons;
+}
+
+
+//  ****************************************************************************
+//     Sessions and commands
+//  ****************************************************************************
+
+// Plays one record of the session read from the DBGU; returns 0 if the
+// injection queue is full and the record must be tried again
+static UBYTE PlayRecord(const SessionRecord *pRecord)
+{
+   switch (pRecord->code) {
+   case SESSION_SEED:
+      // The game starts on the next tick, the records after the seed wait
+      playbackSeed = pRecord->seed;
+      playback = PLAYBACK_START;
+      break;
+   case SESSION_EVENT:
+      if (pRecord->button >= PIO_LISTSIZE(button_pins)) {
+         break;
+      }
+      if (!INPUT_Inject(pRecord->button, pRecord->type,
+                        playbackTick + pRecord->delta)) {
+         return 0;
+      }
+      playbackTick += pRecord->delta;
+      break;
+   case SESSION_WAIT:
+      playbackTick += pRecord->delta;
+      break;
+   case SESSION_END:
+      playback = PLAYBACK_OFF;
+      printf("-- session played --\n\r");
+      break;
+   }
+   return 1;
+}
+
+// Runs a command received on the DBGU
+static void RunCommand(unsigned char command)
+{
+   if (command == 'r' && resumed) {
+      printf("-- no replay, the game was resumed --\n\r");
+   }
+   else if (command == 'r') {
+      REPLAY_Dump(&replay);
+   }
+   else if (command == 'l') {
+      LATENCY_Print(&latency, "latency");
+   }
+   else if (command == 'f') {
+      LATENCY_Print(&frameTimes, "frame");
+   }
+   else if (command == 'u') {
+      ShowLoad();
+   }
+#if CRITICAL_PROFILE
+   else if (command == 'p') {
+      CRITICAL_PrintProfile(PROFILE_SITES);
+   }
+   else if (command == 'c') {
+      CRITICAL_ResetProfile();
+      printf("-- Critical sections cleared --\n\r");
+   }
+#endif
+   else if (command == 'o') {
+      streaming = (streaming == STREAM_OFF) ? STREAM_ARMED : STREAM_OFF;
+      printf("-- session stream %s --\n\r", streaming ? "armed" : "off");
+   }
+   else if (command == 'i') {
+      // Until SESSION_END, the DBGU only takes session records
+      playback = PLAYBACK_ON;
+      playbackTick = tickCount;
+      recordHeld = 0;
+      SESSION_Reset(&parser);
+      printf("-- session playback --\n\r");
+   }
+}
+
+// Reads what the DBGU received: commands, or the records of a session as far
+// as the injection queue takes them
+static void PollSerial(void)
+{
+   UBYTE byte;
+
+   while (playback != PLAYBACK_START) {
+      if (playback == PLAYBACK_OFF) {
+         if (!ReadSerial(&byte)) {
+            return;
+         }
+         RunCommand(byte);
+         continue;
+      }
+      if (!recordHeld) {
+         if (!ReadSerial(&byte)) {
+            return;
+         }
+         if (!SESSION_Parse(&parser, byte, &record)) {
+            continue;
+         }
+         recordHeld = 1;
+      }
+      if (!PlayRecord(&record)) {
+         return;
+      }
+      recordHeld = 0;
+   }
+}
+
+
+//  ****************************************************************************
+//     Title, demo and benchmark
+//  ****************************************************************************
+
+// Shows the title until the joystick button (MODE_SINGLE) or SWITCH2
+// (MODE_VERSUS) is pressed, or until DEMO_TIMEOUT ticks have passed
+// (MODE_DEMO)
+static UBYTE TitleScreen(void)
+{
+   ULONG start;
+   unsigned int buttons;
+
+   ClearScreen();
+   LCDPutStr("TETRIS", 50, 40, MEDIUM, WHITE, BLACK);
+   LCDPutStr("Press button", 70, 30, SMALL, WHITE, BLACK);
+   LCDPutStr("SW2: versus", 85, 30, SMALL, WHITE, BLACK);
+
+   // Wait for the buttons that left the demo to be released
+   while (ReadButtons()) {
+      WaitTick();
+   }
+
+   start = tickCount;
+   while (tickCount - start < DEMO_TIMEOUT) {
+      PollSerial();
+      if (playback == PLAYBACK_START) {
+         return MODE_SINGLE;
+      }
+      buttons = ReadButtons();
+      if (buttons & CONTROL_BUTTON_PUSH) {
+         return MODE_SINGLE;
+      }
+      if (buttons & CONTROL_BUTTON_SWITCH2) {
+         return MODE_VERSUS;
+      }
+      WaitTick();
+   }
+   return MODE_DEMO;
+}
+
+// Lets the AI play without rendering, then runs the solver, and prints their
+// speed on the DBGU
+static void RunBenchmark(void)
+{
+   ULONG start, ticks, seed = 1;
+
+   LCDPutStr("AI benchmark", 50, 30, SMALL, WHITE, BLACK);
+   printf("-- AI benchmark, %u pieces --\n\r", BENCH_PIECES);
+
+   AI_ResetStats();
+   game.pieces = 0;
+   game.gameOver = 1;
+   start = tickCount;
+   while (aiStats.searches < BENCH_PIECES) {
+      if (game.gameOver) {
+         TETRIS_Init(&game, seed++);
+      }
+      AI_Search(&game, &aiDefaultWeights, 0, &target);
+      while (!(TETRIS_Tick(&game, AI_Actions(&game, &target))
+               & (TETRIS_EVENT_LOCKED | TETRIS_EVENT_GAME_OVER)));
+   }
+   ticks = tickCount - start;
+
+   printf("%u placements in %u ticks: %u placements/s, %u pieces/s\n\r",
+          (unsigned int) aiStats.placements, (unsigned int) ticks,
+          (unsigned int) (aiStats.placements * TETRIS_TICKS_PER_SECOND / ticks),
+          (unsigned int) (aiStats.searches * TETRIS_TICKS_PER_SECOND / ticks));
+
+   // The solver reads and writes its table all over, which stresses the
+   // memory rather than the core
+   printf("-- Solver benchmark, %u nodes --\n\r", BENCH_NODES);
+   TETRIS_Init(&game, seed);
+   SOLVER_Start(&solver, &game, SOLVER_MAX_DEPTH);
+   start = tickCount;
+   while (solver.stats.nodes < BENCH_NODES
+          && SOLVER_Step(&solver, SOLVER_NODES) == SOLVER_RUNNING);
+   ticks = tickCount - start;
+
+   printf("%u nodes in %u ticks: %u nodes/s, depth %u, %u of %u probes hit\n\r",
+          (unsigned int) solver.stats.nodes, (unsigned int) ticks,
+          (unsigned int) (solver.stats.nodes * TETRIS_TICKS_PER_SECOND
+                          / (ticks ? ticks : 1)),
+          solver.result.depth, (unsigned int) solver.stats.hits,
+          (unsigned int) solver.stats.probes);
+}
+
+// Plans the demo's next piece: the AI picks a placement at once, the solver
+// starts searching the queue for something better
+static void PlanDemo(void)
+{
+   AI_Search(&game, &aiDefaultWeights, 0, &target);
+   SOLVER_Start(&solver, &game, SOLVER_MAX_DEPTH);
+}
+
+// Runs the solver until the next tick is due and follows its first move if
+// it found a combo or a perfect clear for the piece still falling
+static void RunSolver(void)
+{
+   unsigned int rot;
+   int x;
+
+   while (!tickFlag && SOLVER_Step(&solver, SOLVER_NODES) == SOLVER_RUNNING);
+
+   if (solver.result.valid && solver.result.value >= SOLVER_STEER
+       && solver.first == game.pieces) {
+      SOLVER_Placement(&solver, 0, &rot, &x);
+      target.rot = rot;
+      target.x = x;
+      target.valid = 1;
+   }
+}
+
+
+// Starts a new game with a seed taken from the timers, or the one of the
+// session being played back, and starts recording it
+static void NewGame(void)
+{
+   ULONG seed = tickCount ^ PIT_GetPIIR();
+   UBYTE bytes[SESSION_MAX_RECORD];
+
+   // The statistics of a played back session cover its game only, its event
+   // times count from here
+   if (playback == PLAYBACK_START) {
+      seed = playbackSeed;
+      playback = PLAYBACK_ON;
+      playbackTick = tickCount;
+      LATENCY_Reset(&latency);
+      LATENCY_Reset(&frameTimes);
+   }
+
+   TETRIS_Init(&game, seed);
+   REPLAY_Start(&replay, seed);
+   PlanDemo();
+   resumed = 0;
+
+   if (streaming != STREAM_OFF) {
+      streaming = STREAM_ON;
+      streamTick = tickCount;
+      WriteSerial(bytes, SESSION_EncodeSeed(bytes, seed));
+   }
+}
+
+// Restores the game saved in the flash, if there is one still running, and
+// draws it; returns 1 if the game was resumed
+static UBYTE ResumeGame(void)
+{
+   if (SAVESTATE_Read(saveBuffer, sizeof(saveBuffer)) != TETRIS_SAVE_SIZE
+       || !TETRIS_Restore(&game, saveBuffer) || game.gameOver) {
+      return 0;
+   }
+   FlushScreen(&game);
+   DrawGame(&game);
+   resumed = 1;
+   return 1;
+}
+
+// Saves the game to the flash, or forgets the saved one once it is over
+static void SaveGame(void)
+{
+   if (game.gameOver) {
+      SAVESTATE_Clear();
+   }
+   else {
+      TETRIS_Save(&game, saveBuffer);
+      SAVESTATE_Write(saveBuffer, TETRIS_SAVE_SIZE);
+   }
+}
+
+
+//  ****************************************************************************
+//     Versus
+//  ****************************************************************************
+
+// Draws the local game of the match and what is known of the opponent
+static void DrawVersus(void)
+{
+   const Versus *pState = &link.state;
+   static char s[16];
+
+   DrawGame(&pState->games[link.player]);
+
+   snprintf(s, sizeof(s), "IN%3u", (unsigned int) pState->pending[link.player]);
+   LCDPutStr(s, 80, INFO_LEFT, SMALL, RED, BLACK);
+   snprintf(s, sizeof(s), "VS%3u", (unsigned int) pState->pending[link.peer]);
+   LCDPutStr(s, 90, INFO_LEFT, SMALL, WHITE, BLACK);
+   snprintf(s, sizeof(s), "L%5u", (unsigned int) pState->games[link.peer].lines);
+   LCDPutStr(s, 100, INFO_LEFT, SMALL, WHITE, BLACK);
+
+   if (link.desync) {
+      LCDPutStr("DESYNC", 115, INFO_LEFT, SMALL, RED, BLACK);
+   }
+   else if (link.lost) {
+      LCDPutStr("LOST", 115, INFO_LEFT, SMALL, RED, BLACK);
+   }
+   else if (pState->winner == link.player) {
+      LCDPutStr("WIN ", 115, INFO_LEFT, SMALL, GREEN, BLACK);
+   }
+   else if (pState->winner == VERSUS_DRAW) {
+      LCDPutStr("DRAW", 115, INFO_LEFT, SMALL, WHITE, BLACK);
+   }
+}
+
+// Plays a versus match over the link, returns when SWITCH2 is pressed while
+// waiting for the other board, after the match or once the link is lost
+static void RunVersus(void)
+{
+   ULONG logicTicks, behind, simulated;
+   unsigned int buttons, actions;
+   UBYTE dirty, over, lost;
+
+   ClearScreen();
+   LCDPutStr("Waiting for", 50, 30, SMALL, WHITE, BLACK);
+   LCDPutStr("the other board", 60, 20, SMALL, WHITE, BLACK);
+   while (ReadButtons()) {
+      WaitTick();
+   }
+
+   LINK_Init(&link, tickCount ^ PIT_GetPIIR());
+   logicTicks = tickCount;
+   while (!LINK_Connect(&link)) {
+      WaitTick();
+      logicTicks = tickCount;
+      if (ReadButtons() & CONTROL_BUTTON_SWITCH2) {
+         return;
+      }
+   }
+
+   CONTROL_Init(&control);
+   ClearScreen();
+   dirty = 1;
+   logicTicks = tickCount;
+
+   while (1) {
+
+      WaitTick();
+
+      behind = tickCount - logicTicks;
+      if (behind > MAX_CATCH_UP) {
+         logicTicks = tickCount - MAX_CATCH_UP;
+      }
+      while (logicTicks != tickCount) {
+         logicTicks++;
+
+         // A rollback changes the state of the ticks already drawn
+         simulated = link.stats.resimulated;
+         LINK_Poll(&link);
+         if (link.stats.resimulated != simulated) {
+            dirty = 1;
+         }
+
+         // While the link stalls the presses wait in the input driver, the
+         // tick that reads them is the one that sends them
+         actions = 0;
+         over = link.state.winner != VERSUS_PLAYING || link.desync
+                || link.lost;
+         if (over || LINK_Ready(&link)) {
+            buttons = ReadButtons();
+            if (over && ((buttons & ~control.held) & CONTROL_BUTTON_SWITCH2)) {
+               return;
+            }
+            actions = CONTROL_Update(&control, buttons);
+         }
+
+         // Keep ticking after the match so the peer gets the last inputs
+         lost = link.lost;
+         if (LINK_Advance(&link, over ? 0 : actions) || link.lost != lost) {
+            dirty = 1;
+         }
+      }
+
+      if (dirty && !tickFlag) {
+         DrawVersus();
+         dirty = 0;
+      }
+   }
+}
+
+
+//  ****************************************************************************
+//     Main
+//  ****************************************************************************
+
+int main(void)
+{
+   ULONG logicTicks, behind, lastSave;
+   unsigned int buttons, actions, events;
+   UBYTE dirty, demo, mode;
+
+   // Init input pins
+   PIO_Configure(button_pins, PIO_LISTSIZE(button_pins));
+   PIO_Configure(debug_pins, PIO_LISTSIZE(debug_pins));
+
+   TRACE_CONFIGURE(DBGU_STANDARD, 115200, BOARD_MCK);
+   LINKPORT_Configure();
+   printf("-- Tetris %s --\n\r", SOFTPACK_VERSION);
+   printf("-- %s\n\r", BOARD_NAME);
+   printf("-- Compiled: %s %s --\n\r", __DATE__, __TIME__);
+
+   // Init PIT and AIC
+   // Configure PIT for one logic tick (us, MHz); started first so it also
+   // times the boot
+   PIT_Init(1, BOARD_MCK/TETRIS_TICKS_PER_SECOND);
+
+   // Start the time stamp (MCK/2), the LCD waits on it and the latencies
+   // are measured with it
+   TIMESTAMP_Initialize();
+
+   // Initialize SPI interface to LCD
+   InitSpi();
+
+   // Init LCD
+   InitLcd();
+
+   SOLVER_Init(&solver, solverArena, sizeof(solverArena));
+
+   // Enable PIT interrupt
+   AIC_ConfigureIT(AT91C_ID_SYS, 0, ISR_System_Interrupt);
+   AIC_EnableIT(AT91C_ID_SYS);
+   PIT_EnableIT();
+
+   // The PDC receives the commands and sessions of the DBGU from now on
+   DBGU_ReadRing(&rxRing);
+
+   // The SPI interrupt is enabled after the last write of each frame, and
+   // stamps the end of its transfer
+   AIC_ConfigureIT(AT91C_ID_SPI0, 0, ISR_Spi);
+   AIC_EnableIT(AT91C_ID_SPI0);
+
+   // Button edges interrupt and restart their debounce period, the PIT
+   // interrupt samples the buttons once they settle
+   INPUT_Initialize(button_pins, PIO_LISTSIZE(button_pins), 0, DEBOUNCE_TICKS);
+   INPUT_SetClock(TIMESTAMP_Now);
+   LATENCY_Reset(&latency);
+   LATENCY_Reset(&frameTimes);
+
+   ENABLE_INTERRUPTS;
+
+   if (ResumeGame()) {
+      // PIT counts MCK/16, tickCount the periods elapsed since it started
+      printf("-- Resumed in %u ms --\n\r",
+             (unsigned int) (tickCount * 1000 / TETRIS_TICKS_PER_SECOND
+                             + (PIT_GetPIIR() & AT91C_PITC_CPIV)
+                               / (BOARD_MCK / 16000)));
+      demo = 0;
+      dirty = 0;
+   }
+   else {
+      ClearScreen();
+      if (ReadButtons() & CONTROL_BUTTON_SWITCH1) {
+         RunBenchmark();
+      }
+
+      while ((mode = TitleScreen()) == MODE_VERSUS) {
+         RunVersus();
+      }
+      demo = (mode == MODE_DEMO);
+      probeState = PROBE_IDLE;
+      NewGame();
+      ClearScreen();
+      dirty = 1;
+   }
+   CONTROL_Init(&control);
+   logicTicks = tickCount;
+   lastSave = tickCount;
+
+   // loop forever
+   while (1) {
+
+      // Nothing to do until the next tick
+      WaitTick();
+
+      // Run the logic at the fixed tick rate. If rendering fell far behind,
+      // drop the excess time instead of trying to catch up with all of it.
+      behind = tickCount - logicTicks;
+      if (behind > MAX_CATCH_UP) {
+         logicTicks = tickCount - MAX_CATCH_UP;
+      }
+      while (logicTicks != tickCount) {
+         logicTicks++;
+
+         buttons = ReadButtons();
+         // A session played back starts its own game, even from the demo
+         if (playback == PLAYBACK_START) {
+            demo = 0;
+            probeState = PROBE_IDLE;
+            CONTROL_Init(&control);
+            buttons = CONTROL_BUTTON_SWITCH2;
+         }
+         if (demo && (buttons || game.gameOver)) {
+            // Back to the title, the game starts on the next tick
+            while ((mode = TitleScreen()) == MODE_VERSUS) {
+               RunVersus();
+            }
+            demo = (mode == MODE_DEMO);
+            probeState = PROBE_IDLE;
+            CONTROL_Init(&control);
+            buttons = CONTROL_BUTTON_SWITCH2;
+         }
+         if ((buttons & ~control.held) & CONTROL_BUTTON_SWITCH2) {
+            NewGame();
+            ClearScreen();
+            logicTicks = tickCount;
+            // The first lock replaces the save of the previous game
+            lastSave = tickCount - SAVE_INTERVAL;
+            dirty = 1;
+         }
+
+         if (demo) {
+            control.held = buttons;
+            actions = AI_Actions(&game, &target);
+         }
+         else {
+            actions = CONTROL_Update(&control, buttons);
+         }
+
+         REPLAY_Record(&replay, actions);
+         events = TETRIS_Tick(&game, actions);
+         if (events & TETRIS_EVENT_LOCKED) {
+            REPLAY_Checkpoint(&replay, &game);
+         }
+         // A press that changed nothing on the screen is not measured
+         if (probeState == PROBE_INPUT) {
+            probeState = (events && !demo) ? PROBE_DRAW : PROBE_IDLE;
+         }
+         if (demo && (events & TETRIS_EVENT_SPAWNED)) {
+            PlanDemo();
+         }
+         if (!demo && ((events & TETRIS_EVENT_GAME_OVER)
+                       || ((events & TETRIS_EVENT_LOCKED)
+                           && tickCount - lastSave >= SAVE_INTERVAL))) {
+            SaveGame();
+            lastSave = tickCount;
+         }
+         if (events) {
+            dirty = 1;
+         }
+      }
+
+      PollSerial();
+
+      // The last frame has been shifted out
+      if (framePending && frameDone) {
+         LATENCY_Add(&frameTimes, Elapsed(frameStart));
+         if (frameProbe) {
+            LATENCY_Add(&latency, Elapsed(frameProbeStart));
+         }
+         framePending = 0;
+      }
+
+      // Render with the remaining budget, unless another tick is already due.
+      // A frame drawn while the previous one still waits for its stamp is
+      // not measured, the press goes to the next one
+      if (dirty && !tickFlag) {
+         if (framePending) {
+            DrawGame(&game);
+         }
+         else {
+            frameStart = TIMESTAMP_Now();
+            DrawGame(&game);
+            frameProbe = (probeState == PROBE_DRAW);
+            if (frameProbe) {
+               frameProbeStart = probeStart;
+               probeState = PROBE_IDLE;
+            }
+            frameDone = 0;
+            framePending = 1;
+            AT91C_BASE_SPI0->SPI_IER = AT91C_SPI_TXEMPTY;
+         }
+         dirty = 0;
+      }
+
+      // Search with whatever is left of the frame
+      if (demo && !solver.done) {
+         RunSolver();
+      }
+   }
+}
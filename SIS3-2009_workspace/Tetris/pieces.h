@@ -0,0 +1,78 @@
+//------------------------------------------------------------------------------
+//         Tetromino shapes
+//------------------------------------------------------------------------------
+//
+// Every piece/rotation pair is described by four 16-bit row masks inside a
+// 4x4 box. Row 0 is the bottom row of the box, bit 0 is the leftmost box
+// column. A piece at playfield column x is placed by shifting its masks left
+// by (x + TETRIS_COL_OFFSET), which lines it up with the playfield row masks.
+//
+// The tables are generated at build time by gentables.c and live in flash.
+//
+//------------------------------------------------------------------------------
+
+#ifndef __PIECES_H__
+#define __PIECES_H__
+
+#include "typedef.h"
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Piece types, in the usual I, O, T, S, Z, J, L order.
+#define PIECE_I           0
+#define PIECE_O           1
+#define PIECE_T           2
+#define PIECE_S           3
+#define PIECE_Z           4
+#define PIECE_J           5
+#define PIECE_L           6
+#define PIECE_COUNT       7
+
+/// Number of rotation states per piece (0 = spawn, 1 = R, 2 = 2, 3 = L).
+#define PIECE_ROTATIONS   4
+
+/// Maximum number of positions tested by one rotation (SRS wall kicks).
+#define PIECE_KICKS       5
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// One rotation state of one piece.
+typedef struct {
+
+    /// Row masks, bottom row of the 4x4 box first.
+    UWORD rows[4];
+
+    /// Lowest occupied box row for each box column, -1 if the column is empty.
+    SBYTE colBottom[4];
+
+    /// Bounding box of the occupied cells inside the 4x4 box (inclusive).
+    UBYTE left, right, bottom, top;
+
+} PieceShape;
+
+/// Offsets tried in order when rotating from one state in one direction.
+typedef struct {
+
+    /// Number of offsets to try.
+    UBYTE count;
+
+    /// Column and row offsets (x right, y up).
+    SBYTE dx[PIECE_KICKS];
+    SBYTE dy[PIECE_KICKS];
+
+} PieceKicks;
+
+//------------------------------------------------------------------------------
+//         Global variables
+//------------------------------------------------------------------------------
+
+extern const PieceShape pieceShapes[PIECE_COUNT][PIECE_ROTATIONS];
+
+/// Kick offsets indexed by piece, starting rotation and direction (0 = CW).
+extern const PieceKicks pieceKicks[PIECE_COUNT][PIECE_ROTATIONS][2];
+
+#endif //#ifndef __PIECES_H__
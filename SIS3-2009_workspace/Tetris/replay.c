@@ -0,0 +1,244 @@
+//------------------------------------------------------------------------------
+//         Replay recording
+//------------------------------------------------------------------------------
+
+#include "replay.h"
+
+#include <stdio.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+#define FNV_OFFSET      2166136261u
+#define FNV_PRIME       16777619u
+
+/// Log bytes printed per line by REPLAY_Dump().
+#define DUMP_LINE       32
+
+/// Actions value that no tick has, so that the tick after a state writes its
+/// own actions record.
+#define NO_ACTIONS      0xFF
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Appends one byte to the ring buffer, overwriting the oldest one when full.
+//------------------------------------------------------------------------------
+static void Put(Replay *pReplay, unsigned int value)
+{
+    pReplay->buffer[pReplay->head++ & (REPLAY_BUFFER_SIZE - 1)] = value;
+}
+
+//------------------------------------------------------------------------------
+/// Writes the pending repeat record, if any.
+//------------------------------------------------------------------------------
+static void Flush(Replay *pReplay)
+{
+    if (pReplay->repeat) {
+
+        Put(pReplay, REPLAY_REPEAT | pReplay->repeat);
+        pReplay->repeat = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Folds a 32-bit value into a FNV-1a hash, one byte at a time.
+//------------------------------------------------------------------------------
+static ULONG HashLong(ULONG hash, ULONG value)
+{
+    unsigned int i;
+
+    for (i = 0; i < 4; i++) {
+
+        hash = (hash ^ (value & 0xFF)) * FNV_PRIME;
+        value >>= 8;
+    }
+    return hash;
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Starts a new recording. Must be called with the seed given to
+/// TETRIS_Init().
+/// \param pReplay  Replay log.
+/// \param seed  Game seed.
+//------------------------------------------------------------------------------
+void REPLAY_Start(Replay *pReplay, ULONG seed)
+{
+    pReplay->seed = seed;
+    pReplay->ticks = 0;
+    pReplay->head = 0;
+    pReplay->actions = 0;
+    pReplay->repeat = 0;
+    pReplay->stateCount = 0;
+}
+
+//------------------------------------------------------------------------------
+/// Records the actions of one tick.
+/// \param pReplay  Replay log.
+/// \param actions  TETRIS_ACTION_xxx flags passed to TETRIS_Tick().
+//------------------------------------------------------------------------------
+void REPLAY_Record(Replay *pReplay, unsigned int actions)
+{
+    pReplay->ticks++;
+    if (actions == pReplay->actions) {
+
+        if (++pReplay->repeat == REPLAY_MAX_REPEAT) {
+
+            Flush(pReplay);
+        }
+        return;
+    }
+
+    Flush(pReplay);
+    Put(pReplay, actions);
+    pReplay->actions = actions;
+}
+
+//------------------------------------------------------------------------------
+/// Records a hash of the state after the last recorded tick, and the whole
+/// state if REPLAY_STATE_INTERVAL bytes were written since the previous one.
+/// \param pReplay  Replay log.
+/// \param pGame  Game state.
+//------------------------------------------------------------------------------
+void REPLAY_Checkpoint(Replay *pReplay, const Tetris *pGame)
+{
+    ULONG hash = REPLAY_Hash(pGame);
+    ULONG last;
+    UBYTE image[TETRIS_SAVE_SIZE];
+    unsigned int i;
+
+    Flush(pReplay);
+    Put(pReplay, REPLAY_CHECKPOINT);
+    Put(pReplay, hash & 0xFF);
+    Put(pReplay, (hash >> 8) & 0xFF);
+    Put(pReplay, (hash >> 16) & 0xFF);
+    Put(pReplay, hash >> 24);
+
+    // The start of the log counts as a state
+    last = pReplay->stateCount ?
+           pReplay->states[(pReplay->stateCount - 1) % REPLAY_STATES] : 0;
+    if (pReplay->head - last < REPLAY_STATE_INTERVAL) {
+
+        return;
+    }
+
+    pReplay->states[pReplay->stateCount++ % REPLAY_STATES] = pReplay->head;
+    Put(pReplay, REPLAY_STATE);
+    Put(pReplay, pReplay->ticks & 0xFF);
+    Put(pReplay, (pReplay->ticks >> 8) & 0xFF);
+    Put(pReplay, (pReplay->ticks >> 16) & 0xFF);
+    Put(pReplay, pReplay->ticks >> 24);
+    TETRIS_Save(pGame, image);
+    for (i = 0; i < TETRIS_SAVE_SIZE; i++) {
+
+        Put(pReplay, image[i]);
+    }
+    pReplay->actions = NO_ACTIONS;
+}
+
+//------------------------------------------------------------------------------
+/// Returns a hash of everything that influences the rest of a game.
+/// \param pGame  Game state.
+//------------------------------------------------------------------------------
+ULONG REPLAY_Hash(const Tetris *pGame)
+{
+    ULONG hash = FNV_OFFSET;
+    unsigned int r;
+
+    for (r = 0; r < TETRIS_ROWS; r += 2) {
+
+        hash = HashLong(hash, pGame->rows[r] | ((ULONG) pGame->rows[r + 1] << 16));
+    }
+    hash = HashLong(hash, pGame->piece.type
+                          | (pGame->piece.rot << 8)
+                          | ((ULONG) (UBYTE) pGame->piece.x << 16)
+                          | ((ULONG) (UBYTE) pGame->piece.y << 24));
+    hash = HashLong(hash, pGame->next
+                          | (pGame->gravityCounter << 8)
+                          | ((ULONG) pGame->lockCounter << 16)
+                          | ((ULONG) pGame->lockResets << 24));
+    hash = HashLong(hash, pGame->score);
+    hash = HashLong(hash, pGame->lines);
+    for (r = 0; r < 4; r++) {
+
+        hash = HashLong(hash, pGame->random.s[r]);
+    }
+    hash = HashLong(hash, pGame->bag.values[0]
+                          | (pGame->bag.values[1] << 8)
+                          | ((ULONG) pGame->bag.values[2] << 16)
+                          | ((ULONG) pGame->bag.values[3] << 24));
+    hash = HashLong(hash, pGame->bag.values[4]
+                          | (pGame->bag.values[5] << 8)
+                          | ((ULONG) pGame->bag.values[6] << 16)
+                          | ((ULONG) pGame->bag.count << 24));
+
+    return hash;
+}
+
+//------------------------------------------------------------------------------
+/// Prints the log in the format read by replay-verify:
+///
+///    -- replay seed=<hex> ticks=<dec> bytes=<dec> lost=<dec>
+///    <log bytes, DUMP_LINE per line, two hex digits each>
+///    -- end
+///
+/// Once the ring has wrapped, the log starts at the oldest state left in it
+/// and lost counts the bytes before it.
+/// \param pReplay  Replay log.
+//------------------------------------------------------------------------------
+void REPLAY_Dump(const Replay *pReplay)
+{
+    ULONG tail = 0, start, i;
+    unsigned int column = 0;
+
+    if (pReplay->head > REPLAY_BUFFER_SIZE) {
+
+        // Without a state the log is printed as it is, and cannot be replayed
+        start = pReplay->head - REPLAY_BUFFER_SIZE;
+        tail = start;
+        for (i = (pReplay->stateCount > REPLAY_STATES) ?
+                 pReplay->stateCount - REPLAY_STATES : 0;
+             i < pReplay->stateCount; i++) {
+
+            if (pReplay->states[i % REPLAY_STATES] >= start) {
+
+                tail = pReplay->states[i % REPLAY_STATES];
+                break;
+            }
+        }
+    }
+
+    printf("-- replay seed=%08x ticks=%u bytes=%u lost=%u\n\r",
+           (unsigned int) pReplay->seed,
+           (unsigned int) pReplay->ticks,
+           (unsigned int) (pReplay->head - tail + (pReplay->repeat ? 1 : 0)),
+           (unsigned int) tail);
+
+    for (i = tail; i < pReplay->head; i++) {
+
+        printf("%02x", pReplay->buffer[i & (REPLAY_BUFFER_SIZE - 1)]);
+        if (++column == DUMP_LINE) {
+
+            printf("\n\r");
+            column = 0;
+        }
+    }
+    // The current run has not been written yet
+    if (pReplay->repeat) {
+
+        printf("%02x", REPLAY_REPEAT | pReplay->repeat);
+        column++;
+    }
+    if (column) {
+
+        printf("\n\r");
+    }
+    printf("-- end\n\r");
+}
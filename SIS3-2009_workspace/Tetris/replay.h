@@ -0,0 +1,106 @@
+//------------------------------------------------------------------------------
+//         Replay recording
+//------------------------------------------------------------------------------
+//
+// The game is fully determined by its seed and by the actions passed to
+// TETRIS_Tick() on every tick, so a session is recorded as the seed plus a
+// run-length encoded action log in a RAM ring buffer:
+//
+//    0x00..0x3F   actions of one tick (TETRIS_ACTION_xxx flags)
+//    0x40 h0..h3  checkpoint, REPLAY_Hash() of the state after the last tick,
+//                 least significant byte first
+//    0x41 t0..t3 s0..s174
+//                 state, the ticks recorded so far, least significant byte
+//                 first, and the TETRIS_Save() image of the state after them
+//    0x81..0xFF   the previous actions repeated for 1..127 more ticks
+//
+// Ticks with the same actions as the previous one only increment a counter,
+// which keeps REPLAY_Record() to a compare and an increment on most ticks.
+// A checkpoint is written every time a piece locks, and a state along with it
+// once REPLAY_STATE_INTERVAL bytes were written since the previous one; the
+// tick after a state always has its own actions record, so the log can be
+// replayed from there.
+//
+// REPLAY_Dump() prints the log as text on stdout (the DBGU on the target);
+// the host tool 'replay-verify' runs it through the host build of the engine
+// and compares every checkpoint and state. Once the ring has wrapped, the
+// dump starts at the oldest state left in it, so a game of any length can be
+// replayed over the last 3 to 4 KB of its log.
+//
+//------------------------------------------------------------------------------
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include "typedef.h"
+#include "tetris.h"
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Size of the log ring buffer, must be a power of two.
+#define REPLAY_BUFFER_SIZE    4096
+
+/// Log record codes.
+#define REPLAY_CHECKPOINT     0x40
+#define REPLAY_STATE          0x41
+#define REPLAY_REPEAT         0x80
+
+/// Size of a state record.
+#define REPLAY_STATE_SIZE     (5 + TETRIS_SAVE_SIZE)
+
+/// Least log bytes between two states, and the states whose offsets are
+/// kept: enough to reach back to the oldest one in the ring.
+#define REPLAY_STATE_INTERVAL 1024
+#define REPLAY_STATES         (REPLAY_BUFFER_SIZE / REPLAY_STATE_INTERVAL)
+
+/// Longest run stored in one repeat record.
+#define REPLAY_MAX_REPEAT     127
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+
+    /// Seed given to TETRIS_Init().
+    ULONG seed;
+
+    /// Ticks recorded since REPLAY_Start().
+    ULONG ticks;
+
+    /// Bytes written since REPLAY_Start(), the ring index is head modulo
+    /// REPLAY_BUFFER_SIZE.
+    ULONG head;
+
+    /// Actions of the current run.
+    UBYTE actions;
+
+    /// Ticks repeating the current actions, not written yet.
+    UBYTE repeat;
+
+    /// Offsets (in head units) of the last REPLAY_STATES states, and the
+    /// number of states written.
+    ULONG states[REPLAY_STATES];
+    ULONG stateCount;
+
+    UBYTE buffer[REPLAY_BUFFER_SIZE];
+
+} Replay;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void REPLAY_Start(Replay *pReplay, ULONG seed);
+
+extern void REPLAY_Record(Replay *pReplay, unsigned int actions);
+
+extern void REPLAY_Checkpoint(Replay *pReplay, const Tetris *pGame);
+
+extern ULONG REPLAY_Hash(const Tetris *pGame);
+
+extern void REPLAY_Dump(const Replay *pReplay);
+
+#endif //#ifndef __REPLAY_H__
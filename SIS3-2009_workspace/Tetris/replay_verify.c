@@ -0,0 +1,220 @@
+//------------------------------------------------------------------------------
+//         Host replay verifier
+//------------------------------------------------------------------------------
+//
+// Usage: replay-verify [-v] [file]
+//
+// Reads a log printed by REPLAY_Dump() (from a DBGU capture, other text
+// around it is skipped), replays it through the host build of the engine and
+// compares the state hash at every checkpoint and the whole state at every
+// state record. A log whose start was lost to the ring buffer is replayed
+// from the state it starts with. With -v the hash of every frame is printed,
+// so two runs can be diffed tick by tick.
+//
+// Exit status is 0 when every checkpoint matched.
+//
+//------------------------------------------------------------------------------
+
+#include "tetris.h"
+#include "replay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+static Tetris game;
+
+static UBYTE image[TETRIS_SAVE_SIZE];
+
+static unsigned char data[1 << 20];
+
+static unsigned int verbose;
+
+/// Ticks replayed, which keeps counting after the game is over.
+static unsigned long frames;
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Runs one tick and prints its hash in verbose mode.
+//------------------------------------------------------------------------------
+static void Tick(unsigned int actions)
+{
+    TETRIS_Tick(&game, actions);
+    frames++;
+    if (verbose) {
+
+        printf("%8lu %02x %08lx\n", frames, actions,
+               (unsigned long) REPLAY_Hash(&game));
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Reads the first log of a capture.
+/// \return Number of log bytes, or -1 if there is no complete log.
+//------------------------------------------------------------------------------
+static long Load(FILE *pFile, unsigned long *pSeed, unsigned long *pTicks,
+                 unsigned long *pLost)
+{
+    char line[256];
+    char *p;
+    unsigned int value;
+    long size = 0;
+    int started = 0;
+
+    while (fgets(line, sizeof(line), pFile)) {
+
+        // The target ends its lines with "\n\r"
+        for (p = line; *p == '\r'; p++);
+
+        if (!started) {
+
+            p = strstr(p, "-- replay ");
+            if (p && sscanf(p, "-- replay seed=%lx ticks=%lu bytes=%*u lost=%lu",
+                            pSeed, pTicks, pLost) == 3) {
+
+                started = 1;
+            }
+            continue;
+        }
+        if (strncmp(p, "-- end", 6) == 0) {
+
+            return size;
+        }
+        for (; sscanf(p, "%2x", &value) == 1; p += 2) {
+
+            if (size == sizeof(data)) {
+
+                return -1;
+            }
+            data[size++] = value;
+        }
+    }
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    FILE *pFile = stdin;
+    unsigned long seed, ticks, lost, hash, expected, tick;
+    unsigned int actions = 0, checkpoints = 0, n;
+    long size, i;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++) {
+
+        if (strcmp(argv[arg], "-v") == 0) {
+
+            verbose = 1;
+        }
+        else if (!(pFile = fopen(argv[arg], "r"))) {
+
+            perror(argv[arg]);
+            return 2;
+        }
+    }
+
+    size = Load(pFile, &seed, &ticks, &lost);
+    if (size < 0) {
+
+        fprintf(stderr, "no complete replay log found\n");
+        return 2;
+    }
+    if (lost && (size == 0 || data[0] != REPLAY_STATE)) {
+
+        fprintf(stderr, "the ring buffer wrapped, %lu bytes of the log are "
+                "lost and no state is left to replay from\n", lost);
+        return 2;
+    }
+
+    TETRIS_Init(&game, seed);
+    for (i = 0; i < size; i++) {
+
+        if (data[i] & REPLAY_REPEAT) {
+
+            for (n = data[i] & ~REPLAY_REPEAT; n > 0; n--) {
+
+                Tick(actions);
+            }
+        }
+        else if (data[i] == REPLAY_CHECKPOINT) {
+
+            if (i + 4 >= size) {
+
+                fprintf(stderr, "truncated checkpoint at byte %ld\n", i);
+                return 2;
+            }
+            expected = data[i + 1] | (data[i + 2] << 8)
+                       | (data[i + 3] << 16) | ((unsigned long) data[i + 4] << 24);
+            hash = REPLAY_Hash(&game);
+            i += 4;
+            checkpoints++;
+            if (hash != expected) {
+
+                printf("MISMATCH at tick %lu (checkpoint %u): "
+                       "recorded %08lx, replayed %08lx\n",
+                       frames, checkpoints, expected, hash);
+                return 1;
+            }
+        }
+        else if (data[i] == REPLAY_STATE) {
+
+            if (i + REPLAY_STATE_SIZE > size) {
+
+                fprintf(stderr, "truncated state at byte %ld\n", i);
+                return 2;
+            }
+            tick = data[i + 1] | (data[i + 2] << 8)
+                   | (data[i + 3] << 16) | ((unsigned long) data[i + 4] << 24);
+
+            // The state the log starts with replaces the seed
+            if (i == 0 && lost) {
+
+                if (!TETRIS_Restore(&game, &data[i + 5])) {
+
+                    fprintf(stderr, "invalid state at byte 0\n");
+                    return 2;
+                }
+                frames = tick;
+                printf("replaying from tick %lu, %lu bytes lost\n", tick, lost);
+            }
+            else {
+
+                TETRIS_Save(&game, image);
+                if (tick != frames
+                    || memcmp(image, &data[i + 5], TETRIS_SAVE_SIZE) != 0) {
+
+                    printf("MISMATCH at tick %lu: state recorded at tick %lu "
+                           "differs\n", frames, tick);
+                    return 1;
+                }
+            }
+            i += REPLAY_STATE_SIZE - 1;
+        }
+        else {
+
+            actions = data[i];
+            Tick(actions);
+        }
+    }
+
+    if (frames != ticks) {
+
+        printf("MISMATCH: recorded %lu ticks, replayed %lu\n", ticks, frames);
+        return 1;
+    }
+    printf("OK: %lu ticks, %u checkpoints, score %lu, lines %lu\n",
+           ticks, checkpoints, (unsigned long) game.score,
+           (unsigned long) game.lines);
+    return 0;
+}
@@ -0,0 +1,246 @@
+//------------------------------------------------------------------------------
+//         Suspend/resume storage
+//------------------------------------------------------------------------------
+
+#include "savestate.h"
+#include "criticalSection.h"
+
+#include <board.h>
+#include <efc/efc.h>
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// "TSAV", marks a programmed record.
+#define RECORD_MAGIC          0x56415354
+
+/// Address of the first reserved page.
+#define FIRST_PAGE            (AT91C_IFLASH + AT91C_IFLASH_SIZE \
+                               - SAVESTATE_PAGES * AT91C_IFLASH_PAGE_SIZE)
+
+/// No valid record found.
+#define NO_RECORD             0xFF
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// One flash page.
+typedef struct {
+
+    ULONG magic;
+    ULONG sequence;
+    UWORD size;
+    UWORD reserved;
+    ULONG hash;
+    UBYTE data[SAVESTATE_MAX_SIZE];
+
+} Record;
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+/// Linker script symbols: end of the code, and the initialized data copied
+/// behind it in the flash.
+extern unsigned int _efixed, _srelocate, _erelocate;
+
+/// Record being written, assembled in RAM.
+static Record record;
+
+/// Page of the newest record and its sequence number, once known.
+static UBYTE newest = NO_RECORD;
+static ULONG sequence;
+static UBYTE scanned;
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Returns the record stored in a reserved page.
+//------------------------------------------------------------------------------
+static const Record * Page(unsigned int index)
+{
+    return (const Record *) (FIRST_PAGE + index * AT91C_IFLASH_PAGE_SIZE);
+}
+
+//------------------------------------------------------------------------------
+/// Returns the FNV-1a hash of the record data.
+//------------------------------------------------------------------------------
+static ULONG Hash(const UBYTE *pData, unsigned int size)
+{
+    ULONG hash = 2166136261u;
+
+    while (size--) {
+
+        hash = (hash ^ *pData++) * 16777619u;
+    }
+    return hash;
+}
+
+//------------------------------------------------------------------------------
+/// Tells whether a page holds a complete record, an erased or half written
+/// page fails the hash.
+//------------------------------------------------------------------------------
+static unsigned char IsValid(const Record *pRecord)
+{
+    return pRecord->magic == RECORD_MAGIC
+           && pRecord->size <= SAVESTATE_MAX_SIZE
+           && pRecord->hash == Hash(pRecord->data, pRecord->size);
+}
+
+//------------------------------------------------------------------------------
+/// Finds the newest record, once per boot.
+//------------------------------------------------------------------------------
+static void Scan(void)
+{
+    const Record *pRecord;
+    unsigned int i;
+
+    if (scanned) {
+
+        return;
+    }
+    scanned = 1;
+    for (i = 0; i < SAVESTATE_PAGES; i++) {
+
+        pRecord = Page(i);
+        if (IsValid(pRecord)
+            && (newest == NO_RECORD
+                || (SLONG) (pRecord->sequence - sequence) > 0)) {
+
+            newest = i;
+            sequence = pRecord->sequence;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Programs one reserved page with the record. The page buffer of the EFC is
+/// filled by writing to the page address, then the erase and write command
+/// runs from SRAM while nothing may execute from the flash.
+/// \return 0 if successful, otherwise the EFC error flags.
+//------------------------------------------------------------------------------
+static unsigned int Program(unsigned int index)
+{
+    volatile ULONG *pPage = (volatile ULONG *) Page(index);
+    const ULONG *pWords = (const ULONG *) &record;
+    AT91S_EFC *pEfc;
+    unsigned short page;
+    unsigned int i, status, attempt;
+
+    EFC_TranslateAddress((unsigned int) pPage, &pEfc, &page, 0);
+    EFC_SetEraseBeforeProgramming(pEfc, 1);
+
+    for (attempt = 0; attempt < 2; attempt++) {
+
+        EnterCritical();
+        for (i = 0; i < AT91C_IFLASH_PAGE_SIZE / 4; i++) {
+
+            pPage[i] = pWords[i];
+        }
+        status = EFC_PerformCommand(pEfc, AT91C_MC_FCMD_START_PROG, page);
+        if (status & AT91C_MC_LOCKE) {
+
+            // The lock region was locked by a programming tool
+            EFC_PerformCommand(pEfc, AT91C_MC_FCMD_UNLOCK, page);
+        }
+        ExitCritical();
+
+        if (!(status & AT91C_MC_LOCKE)) {
+
+            break;
+        }
+    }
+    return status;
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Copies the newest record.
+/// \param pData  Destination buffer.
+/// \param size  Size of the destination buffer.
+/// \return Size of the record, 0 if there is none, it was cleared or it does
+/// not fit in the buffer.
+//------------------------------------------------------------------------------
+unsigned int SAVESTATE_Read(UBYTE *pData, unsigned int size)
+{
+    const Record *pRecord;
+
+    Scan();
+    if (newest == NO_RECORD) {
+
+        return 0;
+    }
+    pRecord = Page(newest);
+    if (pRecord->size > size) {
+
+        return 0;
+    }
+    memcpy(pData, pRecord->data, pRecord->size);
+    return pRecord->size;
+}
+
+//------------------------------------------------------------------------------
+/// Writes a new record to the page after the newest one.
+/// \param pData  Record data.
+/// \param size  Record size, at most SAVESTATE_MAX_SIZE.
+/// \return 1 if the record was written and reads back correctly.
+//------------------------------------------------------------------------------
+unsigned char SAVESTATE_Write(const UBYTE *pData, unsigned int size)
+{
+    unsigned int index;
+    unsigned int imageEnd = (unsigned int) &_efixed
+                            + ((unsigned int) &_erelocate
+                               - (unsigned int) &_srelocate);
+
+    // The program must have left the reserved pages alone
+    if (size > SAVESTATE_MAX_SIZE || imageEnd > FIRST_PAGE) {
+
+        return 0;
+    }
+
+    Scan();
+    index = (newest == NO_RECORD) ? 0 : (newest + 1) % SAVESTATE_PAGES;
+
+    memset(&record, 0xFF, sizeof(Record));
+    record.magic = RECORD_MAGIC;
+    record.sequence = sequence + 1;
+    record.size = size;
+    record.reserved = 0;
+    record.hash = Hash(pData, size);
+    if (size) {
+
+        memcpy(record.data, pData, size);
+    }
+
+    if (Program(index) != 0 || memcmp(Page(index), &record, sizeof(Record))) {
+
+        return 0;
+    }
+    newest = index;
+    sequence = record.sequence;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Replaces the newest record with an empty one, so the next boot does not
+/// resume. Does not write anything if the newest record is empty already.
+/// \return 1 if successful.
+//------------------------------------------------------------------------------
+unsigned char SAVESTATE_Clear(void)
+{
+    Scan();
+    if (newest == NO_RECORD || Page(newest)->size == 0) {
+
+        return 1;
+    }
+    return SAVESTATE_Write(0, 0);
+}
@@ -0,0 +1,46 @@
+//------------------------------------------------------------------------------
+//         Suspend/resume storage
+//------------------------------------------------------------------------------
+//
+// Keeps one record of up to SAVESTATE_MAX_SIZE bytes in the last
+// SAVESTATE_PAGES pages of the internal flash. Every write goes to the page
+// after the previous record, so the pages wear evenly (each one is good for
+// about 10000 erase/write cycles), and the record with the highest sequence
+// number wins on boot. The 64 pages take 640000 writes: at the one save per
+// minute of play of Tetris, about 10000 hours. A record holds:
+//
+//    magic, sequence number, size, FNV-1a hash of the data, data
+//
+// Writing a page takes a few milliseconds with the interrupts disabled,
+// since nothing may run from the flash meanwhile; the EFC command itself
+// runs from SRAM (.ramfunc in efc.c). The PIT keeps counting, so no logic
+// tick is lost.
+//
+//------------------------------------------------------------------------------
+
+#ifndef __SAVESTATE_H__
+#define __SAVESTATE_H__
+
+#include "typedef.h"
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Flash pages reserved at the end of the flash, 16 KB.
+#define SAVESTATE_PAGES       64
+
+/// Largest record.
+#define SAVESTATE_MAX_SIZE    240
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern unsigned int SAVESTATE_Read(UBYTE *pData, unsigned int size);
+
+extern unsigned char SAVESTATE_Write(const UBYTE *pData, unsigned int size);
+
+extern unsigned char SAVESTATE_Clear(void);
+
+#endif //#ifndef __SAVESTATE_H__
@@ -0,0 +1,147 @@
+//------------------------------------------------------------------------------
+//         Input session stream
+//------------------------------------------------------------------------------
+
+#include "session.h"
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Returns the length of the record starting with a code byte, 1 for a byte
+/// that does not start a record.
+//------------------------------------------------------------------------------
+static unsigned int Length(UBYTE code)
+{
+    if ((code & 0xF0) == SESSION_EVENT) {
+
+        return 3;
+    }
+    if (code == SESSION_SEED) {
+
+        return 5;
+    }
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Writes a record with a 16-bit delta.
+//------------------------------------------------------------------------------
+static unsigned int Encode(UBYTE *pBuffer, UBYTE code, unsigned int delta)
+{
+    pBuffer[0] = code;
+    pBuffer[1] = delta & 0xFF;
+    pBuffer[2] = delta >> 8;
+    return 3;
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Forgets a partly read record.
+//------------------------------------------------------------------------------
+void SESSION_Reset(SessionParser *pParser)
+{
+    pParser->length = 0;
+}
+
+//------------------------------------------------------------------------------
+/// Feeds one byte of a session to the decoder. Bytes below 0x80 outside a
+/// record (text, or the end of a truncated record) are skipped.
+/// \param pParser  Decoder state.
+/// \param byte  Next byte of the stream.
+/// \param pRecord  Record decoded.
+/// \return 1 if the byte completed a record.
+//------------------------------------------------------------------------------
+unsigned char SESSION_Parse(
+    SessionParser *pParser,
+    UBYTE byte,
+    SessionRecord *pRecord)
+{
+    const UBYTE *pBytes = pParser->bytes;
+
+    if (pParser->length == 0 && byte < 0x80) {
+
+        return 0;
+    }
+    pParser->bytes[pParser->length++] = byte;
+    if (pParser->length < Length(pBytes[0])) {
+
+        return 0;
+    }
+    pParser->length = 0;
+
+    pRecord->code = pBytes[0];
+    pRecord->button = pBytes[0] & 0x07;
+    pRecord->type = (pBytes[0] >> 3) & 1;
+    pRecord->delta = 0;
+    pRecord->seed = 0;
+    if ((pBytes[0] & 0xF0) == SESSION_EVENT) {
+
+        pRecord->code = (pRecord->button == SESSION_BUTTONS) ? SESSION_WAIT
+                                                             : SESSION_EVENT;
+        pRecord->delta = pBytes[1] | (pBytes[2] << 8);
+    }
+    else if (pBytes[0] == SESSION_SEED) {
+
+        pRecord->seed = pBytes[1] | (pBytes[2] << 8) | (pBytes[3] << 16)
+                        | ((ULONG) pBytes[4] << 24);
+    }
+    else if (pBytes[0] != SESSION_END) {
+
+        // Unknown code, skipped
+        return 0;
+    }
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Encodes the start of a game.
+/// \param pBuffer  Destination, at least SESSION_MAX_RECORD bytes.
+/// \param seed  Seed of the game.
+/// \return Bytes written.
+//------------------------------------------------------------------------------
+unsigned int SESSION_EncodeSeed(UBYTE *pBuffer, ULONG seed)
+{
+    pBuffer[0] = SESSION_SEED;
+    pBuffer[1] = seed & 0xFF;
+    pBuffer[2] = (seed >> 8) & 0xFF;
+    pBuffer[3] = (seed >> 16) & 0xFF;
+    pBuffer[4] = seed >> 24;
+    return 5;
+}
+
+//------------------------------------------------------------------------------
+/// Encodes a button event, preceded by a wait if the delta does not fit in
+/// the event record.
+/// \param pBuffer  Destination, at least SESSION_MAX_EVENT bytes.
+/// \param button  CONTROL_BUTTON_xxx bit number, below SESSION_BUTTONS.
+/// \param type  1 for a press, 0 for a release.
+/// \param delta  Ticks since the previous record, shortened to
+///               SESSION_MAX_DELTA.
+/// \return Bytes written.
+//------------------------------------------------------------------------------
+unsigned int SESSION_EncodeEvent(
+    UBYTE *pBuffer,
+    unsigned int button,
+    unsigned int type,
+    ULONG delta)
+{
+    unsigned int length = 0;
+
+    if (delta > SESSION_MAX_DELTA) {
+
+        delta = SESSION_MAX_DELTA;
+    }
+    if (delta > 0xFFFF) {
+
+        length = Encode(pBuffer, SESSION_WAIT, 0xFFFF);
+        delta -= 0xFFFF;
+    }
+    return length + Encode(pBuffer + length,
+                           SESSION_EVENT | (type << 3) | button,
+                           delta);
+}
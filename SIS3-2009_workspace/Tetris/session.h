@@ -0,0 +1,101 @@
+//------------------------------------------------------------------------------
+//         Input session stream
+//------------------------------------------------------------------------------
+//
+// Compact binary encoding of the button events of a game, used both ways on
+// the DBGU: the board streams the session being played, and plays back a
+// session sent to it, so a host script can run the same game on every
+// firmware build without anybody at the joystick.
+//
+// A session is a sequence of records. Every record starts with a byte of
+// 0x80 or more, which never appears in the text the board prints, so a
+// reader finds the records among the traces:
+//
+//   SESSION_SEED, seed (4 bytes, little endian)
+//       Starts a new game with that seed; the following times count from
+//       its first tick.
+//   SESSION_EVENT | type << 3 | button, delta (2 bytes, little endian)
+//       Press (type 1) or release (type 0) of a button, given by its
+//       CONTROL_BUTTON_xxx bit number, delta ticks after the previous
+//       record.
+//   SESSION_WAIT, delta (2 bytes, little endian)
+//       Only advances the time, for gaps longer than a delta holds.
+//   SESSION_END
+//       Ends a played back session.
+//
+//------------------------------------------------------------------------------
+
+#ifndef __SESSION_H__
+#define __SESSION_H__
+
+#include "typedef.h"
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Record codes.
+#define SESSION_EVENT         0x80
+#define SESSION_WAIT          0x87
+#define SESSION_SEED          0x90
+#define SESSION_END           0xFF
+
+/// Longest record, and longest encoding of one event: a wait and the event
+/// record, so gaps are shortened to SESSION_MAX_DELTA ticks (36 minutes).
+#define SESSION_MAX_RECORD    5
+#define SESSION_MAX_EVENT     6
+#define SESSION_MAX_DELTA     (2 * 0xFFFFu)
+
+/// Buttons an event record can name (SESSION_WAIT takes the next number).
+#define SESSION_BUTTONS       7
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// One decoded record.
+typedef struct {
+
+    /// SESSION_EVENT, SESSION_WAIT, SESSION_SEED or SESSION_END.
+    UBYTE code;
+
+    /// Event button and type (INPUT_PRESS or INPUT_RELEASE).
+    UBYTE button;
+    UBYTE type;
+
+    /// Ticks since the previous record (events and waits).
+    UWORD delta;
+
+    /// Seed of the game (SESSION_SEED).
+    ULONG seed;
+
+} SessionRecord;
+
+/// Decoder state: the bytes of the record read so far.
+typedef struct {
+
+    UBYTE bytes[SESSION_MAX_RECORD];
+    UBYTE length;
+
+} SessionParser;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void SESSION_Reset(SessionParser *pParser);
+
+extern unsigned char SESSION_Parse(
+    SessionParser *pParser,
+    UBYTE byte,
+    SessionRecord *pRecord);
+
+extern unsigned int SESSION_EncodeSeed(UBYTE *pBuffer, ULONG seed);
+
+extern unsigned int SESSION_EncodeEvent(
+    UBYTE *pBuffer,
+    unsigned int button,
+    unsigned int type,
+    ULONG delta);
+
+#endif //#ifndef __SESSION_H__
@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+#
+# Records and plays back input sessions over the DBGU of the board, and
+# compares the frame time statistics of the runs (see session.h for the
+# stream format and main.c for the commands).
+#
+#   session.py record PORT FILE         saves the next game played on the board
+#   session.py play PORT FILE [-o OUT]  plays a saved game, prints (and saves)
+#                                       the latency and frame time statistics
+#   session.py compare OLD NEW          compares two saved statistics
+#
+# A run needs pyserial; the DBGU runs at 115200 bauds, 8N1.
+
+import argparse
+import json
+import re
+import sys
+import time
+
+BAUDRATE = 115200
+TICKS_PER_SECOND = 60
+
+# Record codes, as in session.h
+SESSION_EVENT = 0x80
+SESSION_WAIT = 0x87
+SESSION_SEED = 0x90
+SESSION_END = 0xFF
+
+# Seconds a record is sent ahead of its time; the board buffers 256 bytes
+LEAD = 0.5
+
+STATS = re.compile(r'-- (\w+) samples=(\d+) min=(\d+) avg=(\d+) '
+                   r'p99<=(\d+) max=(\d+) us')
+FIELDS = ('samples', 'min', 'avg', 'p99', 'max')
+
+
+def open_port(name):
+    import serial
+    return serial.Serial(name, BAUDRATE, timeout=0.05)
+
+
+def record_length(code):
+    if code & 0xF0 == SESSION_EVENT:
+        return 3
+    if code == SESSION_SEED:
+        return 5
+    return 1
+
+
+def split(data):
+    """Splits a stream into its records and the text around them."""
+    records, text, i = [], bytearray(), 0
+    while i < len(data):
+        if data[i] < 0x80:
+            text.append(data[i])
+            i += 1
+            continue
+        n = record_length(data[i])
+        if i + n > len(data):
+            break
+        records.append(bytes(data[i:i + n]))
+        i += n
+    return records, text.decode('ascii', 'replace'), data[i:]
+
+
+def due_ticks(records):
+    """Yields every record with the tick it is due at, from the game start."""
+    tick = 0
+    for r in records:
+        if r[0] & 0xF0 == SESSION_EVENT:
+            tick += r[1] | r[2] << 8
+        yield tick, r
+
+
+def record(args):
+    port = open_port(args.port)
+    port.write(b'o')
+    print('play a game on the board, ctrl-c to stop', file=sys.stderr)
+    session, pending = [], b''
+    try:
+        while True:
+            records, text, pending = split(pending + port.read(256))
+            sys.stderr.write(text)
+            for r in records:
+                # Only the last game started counts
+                if r[0] == SESSION_SEED:
+                    session = []
+                session.append(r)
+    except KeyboardInterrupt:
+        pass
+    port.write(b'o')
+    if not session or session[0][0] != SESSION_SEED:
+        sys.exit('no game recorded')
+    with open(args.file, 'wb') as f:
+        f.write(b''.join(session))
+    print('%d events, %.1f s' % (len(session) - 1,
+                                 max(t for t, _ in due_ticks(session))
+                                 / TICKS_PER_SECOND), file=sys.stderr)
+
+
+def read_text(port, seconds):
+    text, end = '', time.time() + seconds
+    while time.time() < end:
+        text += split(port.read(256))[1]
+    return text
+
+
+def play(args):
+    with open(args.file, 'rb') as f:
+        session, _, _ = split(f.read())
+    port = open_port(args.port)
+    port.reset_input_buffer()
+    port.write(b'i')
+
+    start = time.time()
+    last = 0
+    for tick, r in due_ticks(session):
+        delay = start + tick / TICKS_PER_SECOND - LEAD - time.time()
+        if delay > 0:
+            time.sleep(delay)
+        port.write(r)
+        last = tick
+    time.sleep(max(0, start + last / TICKS_PER_SECOND + 1 - time.time()))
+    port.write(bytes([SESSION_END]))
+    read_text(port, 0.2)
+
+    port.write(b'lf')
+    text = read_text(port, 1)
+    sys.stdout.write(text)
+    stats = {m.group(1): dict(zip(FIELDS, map(int, m.groups()[1:])))
+             for m in STATS.finditer(text)}
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(stats, f, indent=1)
+
+
+def compare(args):
+    with open(args.old) as f:
+        old = json.load(f)
+    with open(args.new) as f:
+        new = json.load(f)
+    for name in sorted(set(old) & set(new)):
+        print('%s:' % name)
+        for field in FIELDS:
+            a, b = old[name][field], new[name][field]
+            change = (b - a) * 100.0 / a if a else 0.0
+            print('  %-8s %8d %8d  %+6.1f%%' % (field, a, b, change))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    commands = parser.add_subparsers(dest='command', required=True)
+    p = commands.add_parser('record')
+    p.add_argument('port')
+    p.add_argument('file')
+    p.set_defaults(run=record)
+    p = commands.add_parser('play')
+    p.add_argument('port')
+    p.add_argument('file')
+    p.add_argument('-o', '--output', help='statistics file (JSON)')
+    p.set_defaults(run=play)
+    p = commands.add_parser('compare')
+    p.add_argument('old')
+    p.add_argument('new')
+    p.set_defaults(run=compare)
+    args = parser.parse_args()
+    args.run(args)
+
+
+if __name__ == '__main__':
+    main()
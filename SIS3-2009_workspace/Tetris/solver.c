@@ -0,0 +1,522 @@
+//------------------------------------------------------------------------------
+//         Perfect clear and combo solver
+//------------------------------------------------------------------------------
+//
+// Value of a position, for the combo 'run' that led to it:
+//
+//    V(position, run) = max over the moves m of
+//                       SOLVER_PERFECT - 1,   if m empties the playfield
+//                       V(next) - 1,          if V(next) is a perfect clear
+//                       max(run(m), V(next))  otherwise
+//
+// where run(m) is run + 1 if m clears lines, 0 otherwise, and V(next) is
+// V(next position, run(m)), 0 at the depth limit. The table stores V() per
+// exact key, so the values found along one path are reused on every other
+// path reaching the same position with the same pieces left. A table hit
+// only brings back the first move of its sequence, so the sequence found
+// may be shorter than its value tells; the first move is always right.
+//
+//------------------------------------------------------------------------------
+
+#include "solver.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// Bitboard row with all ten cells filled.
+#define FULL_ROW              ((1 << TETRIS_WIDTH) - 1)
+
+/// Row mask bits of the ten playfield columns, in the engine.
+#define FIELD_BITS            (TETRIS_ROW_FULL & ~TETRIS_ROW_WALLS)
+
+/// First column tried: the 4x4 box may start two columns left of the field.
+#define FIRST_X               -2
+
+/// Value of a position without any legal move yet.
+#define NO_VALUE              -1
+
+/// Tells whether a value is a perfect clear.
+#define IS_PERFECT(value)     ((value) > SOLVER_PERFECT - SOLVER_MAX_DEPTH - 1)
+
+/// Queue positions told apart by the table key.
+#define QUEUE_KEYS            16
+
+#if SOLVER_HEIGHT != 8 || SOLVER_MAX_DEPTH > 15
+    #error The table key holds eight rows and 4-bit depths
+#endif
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+/// Rotations of each piece with a shape of their own (bit per rotation), the
+/// others only repeat the same placements.
+static UBYTE distinctRotations[PIECE_COUNT];
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Finds the rotations that do not repeat an earlier one with the same
+/// cells; the spawn position and kicks do not matter for a hard drop.
+//------------------------------------------------------------------------------
+static void FindDistinctRotations(void)
+{
+    const PieceShape *pShape, *pOther;
+    unsigned int type, rot, other, r;
+
+    for (type = 0; type < PIECE_COUNT; type++) {
+
+        distinctRotations[type] = 0;
+        for (rot = 0; rot < PIECE_ROTATIONS; rot++) {
+
+            pShape = &pieceShapes[type][rot];
+            for (other = 0; other < rot; other++) {
+
+                // Same cells, relative to the bottom-left of the bounding box
+                pOther = &pieceShapes[type][other];
+                if (pOther->right - pOther->left != pShape->right - pShape->left
+                    || pOther->top - pOther->bottom != pShape->top - pShape->bottom) {
+
+                    continue;
+                }
+                for (r = 0; r <= (unsigned int) (pShape->top - pShape->bottom); r++) {
+
+                    if ((pShape->rows[pShape->bottom + r] >> pShape->left)
+                        != (pOther->rows[pOther->bottom + r] >> pOther->left)) {
+
+                        break;
+                    }
+                }
+                if (r > (unsigned int) (pShape->top - pShape->bottom)) {
+
+                    break;
+                }
+            }
+            if (other == rot) {
+
+                distinctRotations[type] |= 1 << rot;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Hard drops a piece on a bitboard and removes the full rows.
+/// \param pRows  Bitboard before the placement.
+/// \param pShape  Piece shape.
+/// \param x  Column of the left edge of the rotation box.
+/// \param pResult  Bitboard after the placement.
+/// \return Rows cleared plus one, 0 if the piece ends above the search rows.
+//------------------------------------------------------------------------------
+static unsigned int Drop(
+    const UWORD *pRows,
+    const PieceShape *pShape,
+    int x,
+    UWORD *pResult)
+{
+    UWORD masks[4];
+    int y, r, top, dst;
+    unsigned int cleared = 0;
+
+    for (r = pShape->bottom; r <= pShape->top; r++) {
+
+        masks[r] = (x >= 0) ? pShape->rows[r] << x : pShape->rows[r] >> -x;
+    }
+
+    // Start on top of the stack and fall until something is in the way
+    for (top = SOLVER_HEIGHT; top > 0 && pRows[top - 1] == 0; top--);
+    y = top - pShape->bottom;
+    while (y + pShape->bottom > 0) {
+
+        for (r = pShape->bottom; r <= pShape->top; r++) {
+
+            if (y - 1 + r < SOLVER_HEIGHT && (pRows[y - 1 + r] & masks[r])) {
+
+                break;
+            }
+        }
+        if (r <= pShape->top) {
+
+            break;
+        }
+        y--;
+    }
+    if (y + pShape->top >= SOLVER_HEIGHT) {
+
+        return 0;
+    }
+
+    memcpy(pResult, pRows, SOLVER_HEIGHT * sizeof(UWORD));
+    for (r = pShape->bottom; r <= pShape->top; r++) {
+
+        pResult[y + r] |= masks[r];
+    }
+    for (r = dst = 0; r < SOLVER_HEIGHT; r++) {
+
+        if (pResult[r] == FULL_ROW) {
+
+            cleared++;
+        }
+        else {
+
+            pResult[dst++] = pResult[r];
+        }
+    }
+    while (dst < SOLVER_HEIGHT) {
+
+        pResult[dst++] = 0;
+    }
+    return cleared + 1;
+}
+
+//------------------------------------------------------------------------------
+/// Computes the table key of a position.
+//------------------------------------------------------------------------------
+static void Key(
+    const Solver *pSolver,
+    const UWORD *pRows,
+    unsigned int depth,
+    unsigned int run,
+    ULONG *pKey)
+{
+    pKey[0] = pRows[0] | (pRows[1] << 10) | ((ULONG) pRows[2] << 20);
+    pKey[1] = pRows[3] | (pRows[4] << 10) | ((ULONG) pRows[5] << 20);
+    pKey[2] = pRows[6] | (pRows[7] << 10)
+              | (((pSolver->first + depth) & (QUEUE_KEYS - 1)) << 20)
+              | ((ULONG) run << 24)
+              | ((ULONG) (pSolver->maxDepth - depth) << 28);
+}
+
+//------------------------------------------------------------------------------
+/// Returns the table entry a key maps to.
+//------------------------------------------------------------------------------
+static SolverEntry * Slot(const Solver *pSolver, const ULONG *pKey)
+{
+    ULONG hash = pKey[0] * 0x9E3779B1 ^ pKey[1] * 0x85EBCA77 ^ pKey[2] * 0xC2B2AE3D;
+
+    return &pSolver->pTable[(hash ^ (hash >> 15)) & pSolver->tableMask];
+}
+
+//------------------------------------------------------------------------------
+/// Records the value of a move if it beats the best one of a position.
+/// \param pFrame  Position.
+/// \param value  Value of the sequence starting with the move.
+/// \param move  Encoded move.
+/// \param pMoves  Rest of the sequence.
+/// \param length  Length of the rest of the sequence.
+//------------------------------------------------------------------------------
+static void Update(
+    SolverFrame *pFrame,
+    int value,
+    unsigned int move,
+    const UBYTE *pMoves,
+    unsigned int length)
+{
+    if (value <= pFrame->best) {
+
+        return;
+    }
+    pFrame->best = value;
+    pFrame->moves[0] = move;
+    memcpy(&pFrame->moves[1], pMoves, length);
+    pFrame->length = length + 1;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the value of a move from the value of the position it leads to.
+/// Perfect clear values count the pieces from the position they are stored
+/// for, so the table entries hold whatever the depth they are found at.
+/// \param value  Value of the position after the move.
+/// \param run  Combo after the move.
+//------------------------------------------------------------------------------
+static int Through(int value, unsigned int run)
+{
+    if (IS_PERFECT(value)) {
+
+        return value - 1;
+    }
+    return (value > (int) run) ? value : (int) run;
+}
+
+//------------------------------------------------------------------------------
+/// Prepares the position at a depth for its first move.
+//------------------------------------------------------------------------------
+static void Enter(SolverFrame *pFrame, const UWORD *pRows, unsigned int run)
+{
+    memcpy(pFrame->rows, pRows, SOLVER_HEIGHT * sizeof(UWORD));
+    pFrame->run = run;
+    pFrame->rot = 0;
+    pFrame->x = FIRST_X;
+    pFrame->best = NO_VALUE;
+    pFrame->length = 0;
+}
+
+//------------------------------------------------------------------------------
+/// Generates the next legal move of a position.
+/// \param pFrame  Position, its move iterator advances.
+/// \param type  Piece to place.
+/// \param pResult  Bitboard after the move.
+/// \param pCleared  Rows cleared by the move.
+/// \return Encoded move, or 0xFF when all moves were generated.
+//------------------------------------------------------------------------------
+static unsigned int NextMove(
+    SolverFrame *pFrame,
+    unsigned int type,
+    UWORD *pResult,
+    unsigned int *pCleared)
+{
+    const PieceShape *pShape;
+    unsigned int drop;
+    int x;
+
+    while (pFrame->rot < PIECE_ROTATIONS) {
+
+        pShape = &pieceShapes[type][pFrame->rot];
+        x = pFrame->x++;
+        if (!(distinctRotations[type] & (1 << pFrame->rot))
+            || x + pShape->right >= TETRIS_WIDTH) {
+
+            pFrame->rot++;
+            pFrame->x = FIRST_X;
+            continue;
+        }
+        if (x + (int) pShape->left < 0) {
+
+            continue;
+        }
+        drop = Drop(pFrame->rows, pShape, x, pResult);
+        if (drop) {
+
+            *pCleared = drop - 1;
+            return (pFrame->rot << 4) | (x - FIRST_X);
+        }
+    }
+    return 0xFF;
+}
+
+//------------------------------------------------------------------------------
+/// Finishes one iterative deepening pass and prepares the next one.
+/// \return SOLVER_DONE when the search is over.
+//------------------------------------------------------------------------------
+static unsigned char FinishDepth(Solver *pSolver)
+{
+    SolverFrame *pRoot = &pSolver->stack[0];
+    SolverResult *pResult = &pSolver->result;
+
+    if (pRoot->best == NO_VALUE) {
+
+        // No legal move at all, deeper searches will not find one either
+        pSolver->done = 1;
+        return SOLVER_DONE;
+    }
+    pResult->valid = 1;
+    pResult->value = pRoot->best;
+    pResult->depth = pSolver->maxDepth;
+    pResult->length = pRoot->length;
+    memcpy(pResult->moves, pRoot->moves, pRoot->length);
+
+    // A perfect clear cannot get any shorter
+    if (IS_PERFECT(pRoot->best) || pSolver->maxDepth == pSolver->limit) {
+
+        pSolver->done = 1;
+        return SOLVER_DONE;
+    }
+    pSolver->maxDepth++;
+    Enter(pRoot, pRoot->rows, pRoot->run);
+    return SOLVER_RUNNING;
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Prepares a solver and its transposition table.
+/// \param pSolver  Solver state.
+/// \param pArena  Memory for the table, word aligned.
+/// \param size  Size of the arena, the table uses the largest power of two
+///              number of entries that fits.
+//------------------------------------------------------------------------------
+void SOLVER_Init(Solver *pSolver, void *pArena, unsigned int size)
+{
+    ULONG entries = 1;
+
+    memset(pSolver, 0, sizeof(Solver));
+    while (entries * 2 * sizeof(SolverEntry) <= size) {
+
+        entries *= 2;
+    }
+    pSolver->pTable = (SolverEntry *) pArena;
+    pSolver->tableMask = entries - 1;
+    memset(pArena, 0, entries * sizeof(SolverEntry));
+    pSolver->done = 1;
+
+    FindDistinctRotations();
+}
+
+//------------------------------------------------------------------------------
+/// Starts a search from the current state of a game. The table entries of
+/// the previous search stay valid when the game only advanced by one piece.
+/// \param pSolver  Solver state.
+/// \param pGame  Game, with its active piece at the spawn position.
+/// \param depth  Deepest search, in pieces, at most SOLVER_MAX_DEPTH.
+/// \return 1 if the search started, 0 if the stack reaches above the
+/// SOLVER_HEIGHT rows.
+//------------------------------------------------------------------------------
+unsigned char SOLVER_Start(Solver *pSolver, const Tetris *pGame, unsigned int depth)
+{
+    UWORD rows[SOLVER_HEIGHT];
+    Prng random;
+    PrngBag bag;
+    unsigned int r;
+
+    for (r = SOLVER_HEIGHT; r < TETRIS_ROWS; r++) {
+
+        if (pGame->rows[r] != TETRIS_ROW_EMPTY) {
+
+            pSolver->done = 1;
+            return 0;
+        }
+    }
+    for (r = 0; r < SOLVER_HEIGHT; r++) {
+
+        rows[r] = (pGame->rows[r] & FIELD_BITS) >> TETRIS_COL_OFFSET;
+    }
+
+    // Another game or a skipped piece: the stored values no longer apply
+    if (pGame->pieces != pSolver->first + 1
+        || pGame->piece.type != pSolver->pieces[1]
+        || pGame->pieces + SOLVER_MAX_DEPTH - pSolver->generationFirst > QUEUE_KEYS) {
+
+        if (++pSolver->generation == 0) {
+
+            memset(pSolver->pTable, 0, (pSolver->tableMask + 1) * sizeof(SolverEntry));
+            pSolver->generation = 1;
+        }
+        pSolver->generationFirst = pGame->pieces;
+    }
+    pSolver->first = pGame->pieces;
+
+    // The queue goes on from the game's own piece generator
+    pSolver->pieces[0] = pGame->piece.type;
+    pSolver->pieces[1] = pGame->next;
+    memcpy(&random, &pGame->random, sizeof(Prng));
+    memcpy(&bag, &pGame->bag, sizeof(PrngBag));
+    for (r = 2; r < SOLVER_MAX_DEPTH; r++) {
+
+        pSolver->pieces[r] = PRNG_BagNext(&random, &bag);
+    }
+
+    pSolver->limit = (depth < SOLVER_MAX_DEPTH) ? depth : SOLVER_MAX_DEPTH;
+    pSolver->maxDepth = 1;
+    pSolver->depth = 0;
+    pSolver->done = 0;
+    pSolver->result.valid = 0;
+    Enter(&pSolver->stack[0], rows, 0);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Runs the search for a number of nodes.
+/// \param pSolver  Solver state.
+/// \param nodes  Placements to try before returning.
+/// \return SOLVER_DONE once the search is over, SOLVER_RUNNING otherwise.
+//------------------------------------------------------------------------------
+unsigned char SOLVER_Step(Solver *pSolver, unsigned int nodes)
+{
+    SolverFrame *pFrame, *pParent;
+    SolverEntry *pEntry;
+    UWORD rows[SOLVER_HEIGHT];
+    ULONG key[3];
+    unsigned int move, cleared, run, depth;
+    int value;
+
+    while (!pSolver->done && nodes) {
+
+        depth = pSolver->depth;
+        pFrame = &pSolver->stack[depth];
+        move = NextMove(pFrame, pSolver->pieces[depth], rows, &cleared);
+
+        if (move == 0xFF) {
+
+            // All moves searched: store the value and return it to the parent
+            value = (pFrame->best == NO_VALUE) ? 0 : pFrame->best;
+            if (depth == 0) {
+
+                FinishDepth(pSolver);
+                continue;
+            }
+            Key(pSolver, pFrame->rows, depth, pFrame->run, key);
+            pEntry = Slot(pSolver, key);
+            memcpy(pEntry->key, key, sizeof(key));
+            pEntry->value = value;
+            pEntry->move = pFrame->length ? pFrame->moves[0] : 0xFF;
+            pEntry->generation = pSolver->generation;
+            pSolver->stats.stores++;
+
+            pParent = &pSolver->stack[depth - 1];
+            Update(pParent, Through(value, pParent->childRun), pParent->move,
+                   pFrame->moves, pFrame->length);
+            pSolver->depth--;
+            continue;
+        }
+
+        nodes--;
+        pSolver->stats.nodes++;
+        run = cleared ? pFrame->run + 1 : 0;
+
+        if (cleared && rows[0] == 0) {
+
+            // Rows only fall, so an empty bottom row means an empty board
+            Update(pFrame, SOLVER_PERFECT - 1, move, 0, 0);
+            continue;
+        }
+        if (depth + 1 == pSolver->maxDepth) {
+
+            Update(pFrame, run, move, 0, 0);
+            continue;
+        }
+
+        Key(pSolver, rows, depth + 1, run, key);
+        pEntry = Slot(pSolver, key);
+        pSolver->stats.probes++;
+        if (pEntry->generation == pSolver->generation
+            && memcmp(pEntry->key, key, sizeof(key)) == 0) {
+
+            pSolver->stats.hits++;
+            Update(pFrame, Through(pEntry->value, run), move,
+                   &pEntry->move, (pEntry->move != 0xFF) ? 1 : 0);
+            continue;
+        }
+
+        pFrame->move = move;
+        pFrame->childRun = run;
+        Enter(&pSolver->stack[depth + 1], rows, run);
+        pSolver->depth++;
+    }
+    return pSolver->done ? SOLVER_DONE : SOLVER_RUNNING;
+}
+
+//------------------------------------------------------------------------------
+/// Decodes a placement of the best sequence found.
+/// \param pSolver  Solver state, with a valid result.
+/// \param index  Placement index, below result.length.
+/// \param pRot  Rotation state.
+/// \param pX  Column of the left edge of the rotation box.
+//------------------------------------------------------------------------------
+void SOLVER_Placement(
+    const Solver *pSolver,
+    unsigned int index,
+    unsigned int *pRot,
+    int *pX)
+{
+    unsigned int move = pSolver->result.moves[index];
+
+    *pRot = move >> 4;
+    *pX = (int) (move & 0xF) + FIRST_X;
+}
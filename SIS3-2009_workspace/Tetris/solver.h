@@ -0,0 +1,169 @@
+//------------------------------------------------------------------------------
+//         Perfect clear and combo solver
+//------------------------------------------------------------------------------
+//
+// Depth-limited search over the known piece queue (the active piece, the
+// next one and the rest of the sequence, which the game's own PRNG state
+// determines) for the placements that empty the playfield, or failing that,
+// that clear lines with the most consecutive pieces.
+//
+// The search only looks at the bottom SOLVER_HEIGHT rows, where perfect
+// clears and combos happen, as a bitboard of 10-bit rows. Subtrees already
+// searched are found again in a transposition table keyed by the exact
+// bitboard, the queue position, the combo so far and the depth left. The
+// table lives in an arena given by the caller: megabytes on the host, a few
+// kilobytes on the board, no heap either way.
+//
+// The depth-first search keeps its own stack, so SOLVER_Step() can stop
+// after any number of nodes and continue on the next call; the board runs it
+// in the time left in each frame. Iterative deepening keeps the best
+// sequence of the previous depth available while the next one is searched.
+//
+// Placements are the ones the AI can reach: rotate and shift at the spawn
+// height, then hard drop.
+//
+//------------------------------------------------------------------------------
+
+#ifndef __SOLVER_H__
+#define __SOLVER_H__
+
+#include "typedef.h"
+#include "tetris.h"
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Playfield rows searched, fixed by the table key layout.
+#define SOLVER_HEIGHT         8
+
+/// Most pieces looked ahead (a perfect clear from an empty playfield takes
+/// 10).
+#define SOLVER_MAX_DEPTH      10
+
+/// Values of a sequence: the longest combo (consecutive pieces clearing
+/// lines) up to SOLVER_MAX_DEPTH, or SOLVER_PERFECT minus the pieces placed
+/// for a perfect clear.
+#define SOLVER_PERFECT        100
+
+/// Arena sizes of the two configurations.
+#define SOLVER_ARENA_HOST     (16 << 20)
+#define SOLVER_ARENA_TARGET   (8 << 10)
+
+/// SOLVER_Step() results.
+#define SOLVER_RUNNING        0
+#define SOLVER_DONE           1
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// Transposition table entry: the key, the value of the subtree and the
+/// best move in it.
+typedef struct {
+
+    ULONG key[3];
+    SBYTE value;
+    UBYTE move;
+
+    /// Search generation that stored the entry, 0 = empty.
+    UBYTE generation;
+    UBYTE reserved;
+
+} SolverEntry;
+
+/// Position being searched at one depth.
+typedef struct {
+
+    UWORD rows[SOLVER_HEIGHT];
+
+    /// Consecutive clearing pieces leading to this position.
+    UBYTE run;
+
+    /// Next move to try.
+    UBYTE rot;
+    SBYTE x;
+
+    /// Best value found so far from here and the moves leading to it.
+    SBYTE best;
+    UBYTE length;
+    UBYTE moves[SOLVER_MAX_DEPTH];
+
+    /// Move being searched below this position, and the combo it ends.
+    UBYTE move;
+    UBYTE childRun;
+
+} SolverFrame;
+
+/// Best sequence found.
+typedef struct {
+
+    /// 0 until a depth has been searched completely.
+    UBYTE valid;
+
+    /// Sequence value (see SOLVER_PERFECT) and depth it was found at.
+    SBYTE value;
+    UBYTE depth;
+
+    /// Placements, rotation in the high nibble and column + 2 in the low
+    /// nibble; see SOLVER_Placement().
+    UBYTE length;
+    UBYTE moves[SOLVER_MAX_DEPTH];
+
+} SolverResult;
+
+/// Search statistics.
+typedef struct {
+
+    ULONG nodes;
+    ULONG probes;
+    ULONG hits;
+    ULONG stores;
+
+} SolverStats;
+
+typedef struct {
+
+    /// Piece queue, and the game's piece count at its start.
+    UBYTE pieces[SOLVER_MAX_DEPTH];
+    ULONG first;
+
+    SolverFrame stack[SOLVER_MAX_DEPTH + 1];
+    UBYTE depth;
+    UBYTE maxDepth;
+    UBYTE limit;
+    UBYTE done;
+
+    SolverEntry *pTable;
+    ULONG tableMask;
+    UBYTE generation;
+
+    /// Piece count when the generation started; the keys only hold the queue
+    /// position modulo 16, so a generation covers fewer pieces than that.
+    ULONG generationFirst;
+
+    SolverResult result;
+    SolverStats stats;
+
+} Solver;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void SOLVER_Init(Solver *pSolver, void *pArena, unsigned int size);
+
+extern unsigned char SOLVER_Start(
+    Solver *pSolver,
+    const Tetris *pGame,
+    unsigned int depth);
+
+extern unsigned char SOLVER_Step(Solver *pSolver, unsigned int nodes);
+
+extern void SOLVER_Placement(
+    const Solver *pSolver,
+    unsigned int index,
+    unsigned int *pRot,
+    int *pX);
+
+#endif //#ifndef __SOLVER_H__
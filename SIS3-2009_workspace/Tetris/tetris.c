@@ -0,0 +1,700 @@
+//------------------------------------------------------------------------------
+//         Tetris game engine
+//------------------------------------------------------------------------------
+//
+// Everything here runs once per logic tick, so the hot paths avoid divisions
+// and loops over the whole playfield: collisions test at most four row masks,
+// line clears only look at the rows touched by the locked piece and column
+// heights are updated incrementally.
+//
+//------------------------------------------------------------------------------
+
+#include "tetris.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// Highest level with its own gravity entry.
+#define MAX_LEVEL             29
+
+/// Lines needed to advance one level.
+#define LINES_PER_LEVEL       10
+
+/// PRNG stream of the piece generator.
+#define PIECE_STREAM          0
+
+#if PRNG_BAG_SIZE != PIECE_COUNT
+    #error The piece bag must hold one piece of each type
+#endif
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+/// Ticks the active piece waits before falling one row, per level.
+static const UBYTE ticksPerRow[MAX_LEVEL + 1] = {
+    48, 43, 38, 33, 28, 23, 18, 13, 8, 6,
+     5,  5,  5,  4,  4,  4,  3,  3, 3, 2,
+     2,  2,  2,  2,  2,  2,  2,  2, 2, 1
+};
+
+/// Points for clearing 0..4 lines at once, multiplied by (level + 1).
+static const UWORD linePoints[5] = {0, 100, 300, 500, 800};
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Returns the next piece type of the 7-bag.
+//------------------------------------------------------------------------------
+static UBYTE NextPieceType(Tetris *pGame)
+{
+    return PRNG_BagNext(&pGame->random, &pGame->bag);
+}
+
+//------------------------------------------------------------------------------
+/// Returns the number of bits set in a word with few bits set.
+//------------------------------------------------------------------------------
+static unsigned int CountBits(ULONG value)
+{
+    unsigned int count = 0;
+
+    while (value) {
+
+        value &= value - 1;
+        count++;
+    }
+    return count;
+}
+
+//------------------------------------------------------------------------------
+/// Puts the next piece at the spawn position.
+/// \return TETRIS_EVENT_SPAWNED, plus TETRIS_EVENT_GAME_OVER if it does not fit.
+//------------------------------------------------------------------------------
+static unsigned int Spawn(Tetris *pGame)
+{
+    pGame->piece.type = pGame->next;
+    pGame->piece.rot = 0;
+    pGame->piece.x = TETRIS_SPAWN_X;
+    pGame->piece.y = TETRIS_SPAWN_Y;
+    pGame->next = NextPieceType(pGame);
+
+    pGame->gravityCounter = 0;
+    pGame->lockCounter = 0;
+    pGame->lockResets = 0;
+    pGame->pieces++;
+
+    if (TETRIS_Collides(pGame, pGame->piece.type, 0,
+                        pGame->piece.x, pGame->piece.y)) {
+
+        pGame->gameOver = 1;
+        return TETRIS_EVENT_SPAWNED | TETRIS_EVENT_GAME_OVER;
+    }
+    return TETRIS_EVENT_SPAWNED;
+}
+
+//------------------------------------------------------------------------------
+/// Moves or rotates the active piece if the new position is free. A successful
+/// move of a grounded piece restarts its lock delay a limited number of times;
+/// falling one row restarts it for free.
+/// \return 1 if the piece was moved, 0 otherwise.
+//------------------------------------------------------------------------------
+static unsigned char TryMove(Tetris *pGame, int dx, int dy, unsigned int rot)
+{
+    Piece *pPiece = &pGame->piece;
+
+    if (TETRIS_Collides(pGame, pPiece->type, rot,
+                        pPiece->x + dx, pPiece->y + dy)) {
+
+        return 0;
+    }
+
+    if (dy < 0 && rot == pPiece->rot) {
+
+        pGame->lockCounter = 0;
+    }
+    else if (pGame->lockCounter && pGame->lockResets < TETRIS_LOCK_RESETS) {
+
+        pGame->lockCounter = 0;
+        pGame->lockResets++;
+    }
+
+    pPiece->x += dx;
+    pPiece->y += dy;
+    pPiece->rot = rot;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Removes the full rows among the given candidates by compacting the row
+/// arrays, then repairs the column heights.
+/// \param pGame  Game state.
+/// \param from  Lowest candidate row.
+/// \param to  Highest candidate row.
+/// \return Number of rows cleared.
+//------------------------------------------------------------------------------
+static unsigned int ClearLines(Tetris *pGame, int from, int to)
+{
+    ULONG full = 0;
+    int src, dst, top, r;
+    unsigned int c, h;
+
+    for (r = from; r <= to; r++) {
+
+        if (pGame->rows[r] == TETRIS_ROW_FULL) {
+
+            full |= 1 << r;
+        }
+    }
+    pGame->clearedRows = full;
+    if (full == 0) {
+
+        return 0;
+    }
+
+    // Rows above the highest column are empty and do not need to move
+    top = 0;
+    for (c = 0; c < TETRIS_WIDTH; c++) {
+
+        if (pGame->heights[c] > top) {
+
+            top = pGame->heights[c];
+        }
+    }
+
+    // Compact from the lowest cleared row upwards
+    for (dst = from; !(full & (1 << dst)); dst++);
+    for (src = dst; src < top; src++) {
+
+        if (full & (1 << src)) {
+
+            continue;
+        }
+        pGame->rows[dst] = pGame->rows[src];
+        memcpy(pGame->colors[dst], pGame->colors[src], TETRIS_WIDTH);
+        dst++;
+    }
+    for (; dst < top; dst++) {
+
+        pGame->rows[dst] = TETRIS_ROW_EMPTY;
+        memset(pGame->colors[dst], 0, TETRIS_WIDTH);
+    }
+
+    // Every column drops by the number of cleared rows below its top; if its
+    // top cell was cleared, walk down to the next filled cell
+    for (c = 0; c < TETRIS_WIDTH; c++) {
+
+        h = pGame->heights[c];
+        h -= CountBits(full & ((1 << h) - 1));
+        while (h > 0 && !(pGame->rows[h - 1] & TETRIS_COL_BIT(c))) {
+
+            h--;
+        }
+        pGame->heights[c] = h;
+    }
+
+    return CountBits(full);
+}
+
+//------------------------------------------------------------------------------
+/// Stores a word least significant byte first, returns the next position.
+//------------------------------------------------------------------------------
+static UBYTE *Put32(UBYTE *pBuffer, ULONG value)
+{
+    pBuffer[0] = value & 0xFF;
+    pBuffer[1] = (value >> 8) & 0xFF;
+    pBuffer[2] = (value >> 16) & 0xFF;
+    pBuffer[3] = value >> 24;
+    return pBuffer + 4;
+}
+
+//------------------------------------------------------------------------------
+/// Loads a word stored by Put32(), returns the next position.
+//------------------------------------------------------------------------------
+static const UBYTE *Get32(const UBYTE *pBuffer, ULONG *pValue)
+{
+    *pValue = pBuffer[0] | (pBuffer[1] << 8) | ((ULONG) pBuffer[2] << 16)
+              | ((ULONG) pBuffer[3] << 24);
+    return pBuffer + 4;
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Starts a new game on an empty playfield.
+/// \param pGame  Game state to initialize.
+/// \param seed  Seed of the piece generator.
+//------------------------------------------------------------------------------
+void TETRIS_Init(Tetris *pGame, ULONG seed)
+{
+    unsigned int r;
+
+    memset(pGame, 0, sizeof(Tetris));
+    for (r = 0; r < TETRIS_ROWS + 4; r++) {
+
+        pGame->rows[r] = TETRIS_ROW_EMPTY;
+    }
+    pGame->linesToLevel = LINES_PER_LEVEL;
+    PRNG_Seed(&pGame->random, seed, PIECE_STREAM);
+    PRNG_BagInit(&pGame->bag);
+    pGame->next = NextPieceType(pGame);
+    Spawn(pGame);
+}
+
+//------------------------------------------------------------------------------
+/// Tests whether a piece overlaps the walls, the floor or locked cells.
+/// \param pGame  Game state.
+/// \param type  Piece type.
+/// \param rot  Rotation state.
+/// \param x  Playfield column of the left edge of the rotation box.
+/// \param y  Playfield row of the bottom edge of the rotation box.
+/// \return 1 if the piece collides, 0 if the position is free.
+//------------------------------------------------------------------------------
+unsigned char TETRIS_Collides(
+    const Tetris *pGame,
+    unsigned int type,
+    unsigned int rot,
+    int x,
+    int y)
+{
+    const PieceShape *pShape = &pieceShapes[type][rot];
+    int shift = x + TETRIS_COL_OFFSET;
+    unsigned int r;
+
+    // Pieces may not climb (by wall kicks) above the hidden rows
+    if (shift < 0 || y + pShape->bottom < 0 || y + pShape->top >= TETRIS_ROWS) {
+
+        return 1;
+    }
+
+    // Bits shifted past bit 15 fall outside the right wall
+    for (r = pShape->bottom; r <= pShape->top; r++) {
+
+        if (((ULONG) pShape->rows[r] << shift)
+            & (0xFFFF0000 | pGame->rows[y + r])) {
+
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// Returns how many rows a piece can fall before it lands. When the piece is
+/// above the stack in all of its columns the answer comes straight from the
+/// column heights; otherwise (e.g. tucked under an overhang) it is searched.
+/// \param pGame  Game state.
+/// \param pPiece  Piece to drop, must not collide at its current position.
+//------------------------------------------------------------------------------
+int TETRIS_DropDistance(const Tetris *pGame, const Piece *pPiece)
+{
+    const PieceShape *pShape = &pieceShapes[pPiece->type][pPiece->rot];
+    int distance = TETRIS_ROWS;
+    int gap;
+    unsigned int c;
+
+    for (c = pShape->left; c <= pShape->right; c++) {
+
+        gap = pPiece->y + pShape->colBottom[c]
+              - pGame->heights[pPiece->x + c];
+        if (gap < 0) {
+
+            break;
+        }
+        if (gap < distance) {
+
+            distance = gap;
+        }
+    }
+    if (c > pShape->right) {
+
+        return distance;
+    }
+
+    distance = 0;
+    while (!TETRIS_Collides(pGame, pPiece->type, pPiece->rot,
+                            pPiece->x, pPiece->y - distance - 1)) {
+
+        distance++;
+    }
+    return distance;
+}
+
+//------------------------------------------------------------------------------
+/// Rotates the active piece, trying the SRS kick offsets in order.
+/// \param pGame  Game state.
+/// \param dir  0 for clockwise, 1 for counter-clockwise.
+/// \return 1 if the piece was rotated, 0 otherwise.
+//------------------------------------------------------------------------------
+unsigned char TETRIS_Rotate(Tetris *pGame, unsigned int dir)
+{
+    const Piece *pPiece = &pGame->piece;
+    const PieceKicks *pKicks = &pieceKicks[pPiece->type][pPiece->rot][dir];
+    unsigned int rot = (pPiece->rot + (dir ? 3 : 1)) & 3;
+    unsigned int i;
+
+    for (i = 0; i < pKicks->count; i++) {
+
+        if (TryMove(pGame, pKicks->dx[i], pKicks->dy[i], rot)) {
+
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// Locks the active piece at its current position, clears full rows, updates
+/// score and level and spawns the next piece.
+/// \param pGame  Game state.
+/// \return TETRIS_EVENT_xxx flags describing what happened.
+//------------------------------------------------------------------------------
+unsigned int TETRIS_Lock(Tetris *pGame)
+{
+    const Piece *pPiece = &pGame->piece;
+    const PieceShape *pShape = &pieceShapes[pPiece->type][pPiece->rot];
+    unsigned int events = TETRIS_EVENT_LOCKED;
+    unsigned int r, c, cleared;
+    UWORD mask;
+    int y;
+
+    // Stamp the piece into the row masks, colours and heights
+    for (r = pShape->bottom; r <= pShape->top; r++) {
+
+        y = pPiece->y + r;
+        mask = pShape->rows[r];
+        pGame->rows[y] |= mask << (pPiece->x + TETRIS_COL_OFFSET);
+        for (c = pShape->left; c <= pShape->right; c++) {
+
+            if (mask & (1 << c)) {
+
+                pGame->colors[y][pPiece->x + c] = pPiece->type + 1;
+                if (pGame->heights[pPiece->x + c] <= y) {
+
+                    pGame->heights[pPiece->x + c] = y + 1;
+                }
+            }
+        }
+    }
+
+    // Only the rows covered by the piece can have been completed
+    cleared = ClearLines(pGame,
+                         pPiece->y + pShape->bottom,
+                         pPiece->y + pShape->top);
+    if (cleared) {
+
+        events |= TETRIS_EVENT_LINES;
+        pGame->lines += cleared;
+        pGame->score += linePoints[cleared] * (pGame->level + 1);
+        if (pGame->linesToLevel <= cleared) {
+
+            pGame->linesToLevel += LINES_PER_LEVEL - cleared;
+            if (pGame->level < MAX_LEVEL) {
+
+                pGame->level++;
+            }
+        }
+        else {
+
+            pGame->linesToLevel -= cleared;
+        }
+    }
+
+    return events | Spawn(pGame);
+}
+
+//------------------------------------------------------------------------------
+/// Pushes the stack up and fills the bottom rows with garbage, leaving one
+/// empty cell per row. The active piece is moved up if the stack reaches it.
+/// \param pGame  Game state.
+/// \param count  Rows to insert, at most TETRIS_MAX_GARBAGE.
+/// \param hole  Column of the empty cell.
+/// \return TETRIS_EVENT_MOVED, plus TETRIS_EVENT_GAME_OVER if the stack is
+/// pushed out of the playfield or into a piece that cannot move up.
+//------------------------------------------------------------------------------
+unsigned int TETRIS_AddGarbage(
+    Tetris *pGame,
+    unsigned int count,
+    unsigned int hole)
+{
+    unsigned int r, c, top = 0;
+
+    if (pGame->gameOver || count == 0) {
+
+        return 0;
+    }
+    for (c = 0; c < TETRIS_WIDTH; c++) {
+
+        if (pGame->heights[c] > top) {
+
+            top = pGame->heights[c];
+        }
+    }
+    if (top + count > TETRIS_ROWS) {
+
+        pGame->gameOver = 1;
+        return TETRIS_EVENT_MOVED | TETRIS_EVENT_GAME_OVER;
+    }
+
+    memmove(&pGame->rows[count], &pGame->rows[0], top * sizeof(UWORD));
+    memmove(pGame->colors[count], pGame->colors[0], top * TETRIS_WIDTH);
+    for (r = 0; r < count; r++) {
+
+        pGame->rows[r] = TETRIS_ROW_FULL & ~TETRIS_COL_BIT(hole);
+        memset(pGame->colors[r], TETRIS_GARBAGE, TETRIS_WIDTH);
+        pGame->colors[r][hole] = 0;
+    }
+    for (c = 0; c < TETRIS_WIDTH; c++) {
+
+        if (c != hole || pGame->heights[c]) {
+
+            pGame->heights[c] += count;
+        }
+    }
+
+    // The four empty rows above the playfield leave room for this
+    for (r = 0; r < count; r++) {
+
+        if (!TETRIS_Collides(pGame, pGame->piece.type, pGame->piece.rot,
+                             pGame->piece.x, pGame->piece.y)) {
+
+            break;
+        }
+        pGame->piece.y++;
+    }
+    if (TETRIS_Collides(pGame, pGame->piece.type, pGame->piece.rot,
+                        pGame->piece.x, pGame->piece.y)) {
+
+        pGame->gameOver = 1;
+        return TETRIS_EVENT_MOVED | TETRIS_EVENT_GAME_OVER;
+    }
+    return TETRIS_EVENT_MOVED;
+}
+
+//------------------------------------------------------------------------------
+/// Advances the game by one logic tick.
+/// \param pGame  Game state.
+/// \param actions  TETRIS_ACTION_xxx flags requested for this tick.
+/// \return TETRIS_EVENT_xxx flags describing what happened.
+//------------------------------------------------------------------------------
+unsigned int TETRIS_Tick(Tetris *pGame, unsigned int actions)
+{
+    Piece *pPiece = &pGame->piece;
+    unsigned int events = 0;
+    int distance;
+
+    if (pGame->gameOver) {
+
+        return TETRIS_EVENT_GAME_OVER;
+    }
+    pGame->ticks++;
+
+    // Horizontal moves and rotations
+    if ((actions & TETRIS_ACTION_LEFT) && TryMove(pGame, -1, 0, pPiece->rot)) {
+
+        events |= TETRIS_EVENT_MOVED;
+    }
+    if ((actions & TETRIS_ACTION_RIGHT) && TryMove(pGame, 1, 0, pPiece->rot)) {
+
+        events |= TETRIS_EVENT_MOVED;
+    }
+    if ((actions & TETRIS_ACTION_ROTATE_CW) && TETRIS_Rotate(pGame, 0)) {
+
+        events |= TETRIS_EVENT_MOVED;
+    }
+    if ((actions & TETRIS_ACTION_ROTATE_CCW) && TETRIS_Rotate(pGame, 1)) {
+
+        events |= TETRIS_EVENT_MOVED;
+    }
+
+    // Hard drop locks immediately
+    if (actions & TETRIS_ACTION_HARD_DROP) {
+
+        distance = TETRIS_DropDistance(pGame, pPiece);
+        pPiece->y -= distance;
+        pGame->score += 2 * distance;
+        return events | TETRIS_EVENT_MOVED | TETRIS_Lock(pGame);
+    }
+
+    // Gravity, soft drop falls one row every tick
+    if ((actions & TETRIS_ACTION_SOFT_DROP)
+        || ++pGame->gravityCounter >= ticksPerRow[pGame->level]) {
+
+        pGame->gravityCounter = 0;
+        if (TryMove(pGame, 0, -1, pPiece->rot)) {
+
+            events |= TETRIS_EVENT_MOVED;
+            if (actions & TETRIS_ACTION_SOFT_DROP) {
+
+                pGame->score++;
+            }
+        }
+    }
+
+    // Lock delay runs while the piece rests on something
+    if (TETRIS_Collides(pGame, pPiece->type, pPiece->rot,
+                        pPiece->x, pPiece->y - 1)) {
+
+        if (++pGame->lockCounter >= TETRIS_LOCK_DELAY) {
+
+            events |= TETRIS_Lock(pGame);
+        }
+    }
+
+    return events;
+}
+
+//------------------------------------------------------------------------------
+/// Serializes a game into TETRIS_SAVE_SIZE bytes. The colour grid is stored
+/// two cells per byte; the row masks and column heights are left out since
+/// TETRIS_Restore() rebuilds them from it.
+/// \param pGame  Game state.
+/// \param pBuffer  Destination, TETRIS_SAVE_SIZE bytes.
+/// \return Number of bytes written.
+//------------------------------------------------------------------------------
+unsigned int TETRIS_Save(const Tetris *pGame, UBYTE *pBuffer)
+{
+    UBYTE *pNext = pBuffer;
+    unsigned int r, c, i;
+
+    for (r = 0; r < TETRIS_ROWS; r++) {
+
+        for (c = 0; c < TETRIS_WIDTH; c += 2) {
+
+            *pNext++ = pGame->colors[r][c] | (pGame->colors[r][c + 1] << 4);
+        }
+    }
+    *pNext++ = pGame->piece.type;
+    *pNext++ = pGame->piece.rot;
+    *pNext++ = pGame->piece.x;
+    *pNext++ = pGame->piece.y;
+    *pNext++ = pGame->next;
+    *pNext++ = pGame->gravityCounter;
+    *pNext++ = pGame->lockCounter;
+    *pNext++ = pGame->lockResets;
+    *pNext++ = pGame->level;
+    *pNext++ = pGame->linesToLevel;
+    *pNext++ = pGame->gameOver;
+    *pNext++ = pGame->bag.count;
+    for (i = 0; i < PRNG_BAG_SIZE; i++) {
+
+        *pNext++ = pGame->bag.values[i];
+    }
+    pNext = Put32(pNext, pGame->clearedRows);
+    pNext = Put32(pNext, pGame->score);
+    pNext = Put32(pNext, pGame->lines);
+    pNext = Put32(pNext, pGame->pieces);
+    pNext = Put32(pNext, pGame->ticks);
+    for (i = 0; i < 4; i++) {
+
+        pNext = Put32(pNext, pGame->random.s[i]);
+    }
+    return pNext - pBuffer;
+}
+
+//------------------------------------------------------------------------------
+/// Loads a game serialized by TETRIS_Save(). The values are checked so a
+/// damaged buffer cannot make the engine index out of its tables.
+/// \param pGame  Game state, unchanged if the buffer is invalid.
+/// \param pBuffer  TETRIS_SAVE_SIZE bytes.
+/// \return 1 if the game was restored, 0 if the buffer is invalid.
+//------------------------------------------------------------------------------
+unsigned char TETRIS_Restore(Tetris *pGame, const UBYTE *pBuffer)
+{
+    static Tetris game;
+    const UBYTE *pNext = pBuffer;
+    unsigned int r, c, i, color;
+    ULONG value;
+
+    memset(&game, 0, sizeof(Tetris));
+    for (r = 0; r < TETRIS_ROWS + 4; r++) {
+
+        game.rows[r] = TETRIS_ROW_EMPTY;
+    }
+    for (r = 0; r < TETRIS_ROWS; r++) {
+
+        for (c = 0; c < TETRIS_WIDTH; c++) {
+
+            color = (c & 1) ? (*pNext++ >> 4) : (*pNext & 0xF);
+            if (color > TETRIS_GARBAGE) {
+
+                return 0;
+            }
+            if (color) {
+
+                game.colors[r][c] = color;
+                game.rows[r] |= TETRIS_COL_BIT(c);
+                game.heights[c] = r + 1;
+            }
+        }
+        if (game.rows[r] == TETRIS_ROW_FULL) {
+
+            return 0;
+        }
+    }
+    game.piece.type = *pNext++;
+    game.piece.rot = *pNext++;
+    game.piece.x = (SBYTE) *pNext++;
+    game.piece.y = (SBYTE) *pNext++;
+    game.next = *pNext++;
+    game.gravityCounter = *pNext++;
+    game.lockCounter = *pNext++;
+    game.lockResets = *pNext++;
+    game.level = *pNext++;
+    game.linesToLevel = *pNext++;
+    game.gameOver = *pNext++;
+    game.bag.count = *pNext++;
+    for (i = 0; i < PRNG_BAG_SIZE; i++) {
+
+        game.bag.values[i] = *pNext++;
+        if (game.bag.values[i] >= PIECE_COUNT) {
+
+            return 0;
+        }
+    }
+    pNext = Get32(pNext, &game.clearedRows);
+    pNext = Get32(pNext, &game.score);
+    pNext = Get32(pNext, &game.lines);
+    pNext = Get32(pNext, &game.pieces);
+    pNext = Get32(pNext, &game.ticks);
+    for (i = 0; i < 4; i++) {
+
+        pNext = Get32(pNext, &value);
+        game.random.s[i] = value;
+    }
+
+    if (game.piece.type >= PIECE_COUNT || game.piece.rot > 3
+        || game.next >= PIECE_COUNT || game.level > MAX_LEVEL
+        || game.bag.count > PRNG_BAG_SIZE
+        || (game.random.s[0] | game.random.s[1] | game.random.s[2]
+            | game.random.s[3]) == 0) {
+
+        return 0;
+    }
+
+    // TETRIS_Collides() shifts the shape by the column, so the box must lie
+    // within the shifts and rows it handles, even after a game over; the
+    // counters never reach their limits, which end the piece or the tick
+    if (game.piece.x < -TETRIS_COL_OFFSET || game.piece.x >= TETRIS_WIDTH
+        || game.piece.y <= -4 || game.piece.y >= TETRIS_ROWS
+        || game.gravityCounter >= ticksPerRow[game.level]
+        || game.lockCounter >= TETRIS_LOCK_DELAY
+        || game.lockResets > TETRIS_LOCK_RESETS) {
+
+        return 0;
+    }
+    if (!game.gameOver && TETRIS_Collides(&game, game.piece.type, game.piece.rot,
+                                          game.piece.x, game.piece.y)) {
+
+        return 0;
+    }
+
+    memcpy(pGame, &game, sizeof(Tetris));
+    return 1;
+}
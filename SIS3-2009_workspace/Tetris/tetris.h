@@ -0,0 +1,162 @@
+//------------------------------------------------------------------------------
+//         Tetris game engine
+//------------------------------------------------------------------------------
+//
+// Bitboard playfield: every row is a 16-bit occupancy mask with the ten
+// playfield columns in bits 3..12 and permanently set wall bits around them,
+// so a collision test is a shifted AND and a full row is simply 0xFFFF.
+// Row 0 is the bottom of the playfield.
+//
+// The engine does not touch any peripheral and builds unchanged on the host.
+//
+//------------------------------------------------------------------------------
+
+#ifndef __TETRIS_H__
+#define __TETRIS_H__
+
+#include "typedef.h"
+#include "pieces.h"
+
+#include <utility/prng.h>
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Playfield width in cells.
+#define TETRIS_WIDTH          10
+/// Visible playfield height in cells.
+#define TETRIS_HEIGHT         20
+/// Playfield rows, including the hidden spawn rows above the visible area.
+#define TETRIS_ROWS           24
+
+/// Bit position of playfield column 0 inside a row mask.
+#define TETRIS_COL_OFFSET     3
+/// Wall bits, always set in every row mask.
+#define TETRIS_ROW_WALLS      0xE007
+/// Row mask of an empty row.
+#define TETRIS_ROW_EMPTY      TETRIS_ROW_WALLS
+/// Row mask of a completely filled row.
+#define TETRIS_ROW_FULL       0xFFFF
+/// Row mask bit of playfield column c.
+#define TETRIS_COL_BIT(c)     (1 << ((c) + TETRIS_COL_OFFSET))
+
+/// Logic ticks per second the gravity and lock timings are expressed in.
+#define TETRIS_TICKS_PER_SECOND   60
+/// Ticks a grounded piece waits before locking.
+#define TETRIS_LOCK_DELAY     30
+/// Number of moves/rotations that may reset the lock delay of one piece.
+#define TETRIS_LOCK_RESETS    15
+
+/// Colour index of garbage cells.
+#define TETRIS_GARBAGE        (PIECE_COUNT + 1)
+/// Most garbage rows TETRIS_AddGarbage() inserts at once.
+#define TETRIS_MAX_GARBAGE    4
+
+/// Bytes written by TETRIS_Save().
+#define TETRIS_SAVE_SIZE      175
+
+/// Spawn position of the rotation box.
+#define TETRIS_SPAWN_X        3
+#define TETRIS_SPAWN_Y        (TETRIS_HEIGHT - 3)
+
+/// Actions accepted by TETRIS_Tick(), may be OR'ed together.
+#define TETRIS_ACTION_LEFT        (1 << 0)
+#define TETRIS_ACTION_RIGHT       (1 << 1)
+#define TETRIS_ACTION_ROTATE_CW   (1 << 2)
+#define TETRIS_ACTION_ROTATE_CCW  (1 << 3)
+#define TETRIS_ACTION_SOFT_DROP   (1 << 4)
+#define TETRIS_ACTION_HARD_DROP   (1 << 5)
+
+/// Events reported by TETRIS_Tick().
+#define TETRIS_EVENT_MOVED        (1 << 0)
+#define TETRIS_EVENT_LOCKED       (1 << 1)
+#define TETRIS_EVENT_LINES        (1 << 2)
+#define TETRIS_EVENT_SPAWNED      (1 << 3)
+#define TETRIS_EVENT_GAME_OVER    (1 << 4)
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// Active piece: type, rotation and position of the bottom-left box corner.
+typedef struct {
+
+    UBYTE type;
+    UBYTE rot;
+    SBYTE x;
+    SBYTE y;
+
+} Piece;
+
+/// Complete game state.
+typedef struct {
+
+    /// Row masks, plus four always-empty rows above the top so the collision
+    /// test of a freshly spawned piece needs no bound check.
+    UWORD rows[TETRIS_ROWS + 4];
+
+    /// Colour index of every cell (piece type + 1, TETRIS_GARBAGE, 0 = empty).
+    UBYTE colors[TETRIS_ROWS][TETRIS_WIDTH];
+
+    /// Height of every column: index of the highest filled cell + 1.
+    UBYTE heights[TETRIS_WIDTH];
+
+    /// Active piece and the piece that follows it.
+    Piece piece;
+    UBYTE next;
+
+    /// Rows cleared by the last lock, as a bit mask of row indexes.
+    ULONG clearedRows;
+
+    /// Gravity and lock delay counters, in ticks.
+    UBYTE gravityCounter;
+    UBYTE lockCounter;
+    UBYTE lockResets;
+
+    UBYTE level;
+    UBYTE linesToLevel;
+    UBYTE gameOver;
+
+    ULONG score;
+    ULONG lines;
+    ULONG pieces;
+    ULONG ticks;
+
+    /// Piece generator: 7-bag drawn from the game's own PRNG stream.
+    Prng random;
+    PrngBag bag;
+
+} Tetris;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void TETRIS_Init(Tetris *pGame, ULONG seed);
+
+extern unsigned int TETRIS_Tick(Tetris *pGame, unsigned int actions);
+
+extern unsigned char TETRIS_Collides(
+    const Tetris *pGame,
+    unsigned int type,
+    unsigned int rot,
+    int x,
+    int y);
+
+extern int TETRIS_DropDistance(const Tetris *pGame, const Piece *pPiece);
+
+extern unsigned char TETRIS_Rotate(Tetris *pGame, unsigned int dir);
+
+extern unsigned int TETRIS_Lock(Tetris *pGame);
+
+extern unsigned int TETRIS_AddGarbage(
+    Tetris *pGame,
+    unsigned int count,
+    unsigned int hole);
+
+extern unsigned int TETRIS_Save(const Tetris *pGame, UBYTE *pBuffer);
+
+extern unsigned char TETRIS_Restore(Tetris *pGame, const UBYTE *pBuffer);
+
+#endif //#ifndef __TETRIS_H__
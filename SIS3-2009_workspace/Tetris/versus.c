@@ -0,0 +1,139 @@
+//------------------------------------------------------------------------------
+//         Versus mode rules
+//------------------------------------------------------------------------------
+
+#include "versus.h"
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// PRNG stream of the garbage hole columns.
+#define GARBAGE_STREAM        2
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+/// Garbage rows sent for clearing 0..4 lines at once.
+static const UBYTE attack[5] = {0, 0, 1, 2, 4};
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Returns the number of bits set in a word with few bits set.
+//------------------------------------------------------------------------------
+static unsigned int CountBits(ULONG value)
+{
+    unsigned int count = 0;
+
+    for (; value; value &= value - 1) {
+
+        count++;
+    }
+    return count;
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Starts a versus match. Both games get the same piece sequence.
+/// \param pVersus  Versus state.
+/// \param seed  Seed shared by both units of a link.
+//------------------------------------------------------------------------------
+void VERSUS_Init(Versus *pVersus, ULONG seed)
+{
+    unsigned int i;
+
+    for (i = 0; i < VERSUS_PLAYERS; i++) {
+
+        TETRIS_Init(&pVersus->games[i], seed);
+        pVersus->pending[i] = 0;
+        pVersus->sent[i] = 0;
+        pVersus->received[i] = 0;
+    }
+    PRNG_Seed(&pVersus->garbage, seed, GARBAGE_STREAM);
+    pVersus->winner = VERSUS_PLAYING;
+}
+
+//------------------------------------------------------------------------------
+/// Advances both games by one logic tick and exchanges garbage.
+/// \param pVersus  Versus state.
+/// \param pActions  TETRIS_ACTION_xxx flags of each player for this tick.
+/// \return TETRIS_EVENT_xxx flags of player 0 in bits 0-7 and of player 1 in
+/// bits 8-15.
+//------------------------------------------------------------------------------
+unsigned int VERSUS_Tick(Versus *pVersus, const UBYTE *pActions)
+{
+    unsigned int events[VERSUS_PLAYERS], rows[VERSUS_PLAYERS];
+    unsigned int i, cancel, count;
+    Tetris *pGame;
+
+    for (i = 0; i < VERSUS_PLAYERS; i++) {
+
+        events[i] = TETRIS_Tick(&pVersus->games[i], pActions[i]);
+        rows[i] = (events[i] & TETRIS_EVENT_LOCKED) ?
+                  attack[CountBits(pVersus->games[i].clearedRows)] : 0;
+
+        // Each attack cancels the garbage pending against its player first
+        cancel = (rows[i] < pVersus->pending[i]) ? rows[i] : pVersus->pending[i];
+        pVersus->pending[i] -= cancel;
+        rows[i] -= cancel;
+    }
+
+    // Attacks of the same tick cancel each other, whatever the player order
+    cancel = (rows[0] < rows[1]) ? rows[0] : rows[1];
+    for (i = 0; i < VERSUS_PLAYERS; i++) {
+
+        rows[i] -= cancel;
+        pVersus->sent[i] += rows[i];
+
+        // More than a playfield of garbage tops out anyway
+        rows[i] += pVersus->pending[1 - i];
+        pVersus->pending[1 - i] = (rows[i] < TETRIS_ROWS) ? rows[i] : TETRIS_ROWS;
+    }
+
+    // Then the pieces locked without clearing a line take their garbage
+    for (i = 0; i < VERSUS_PLAYERS; i++) {
+
+        pGame = &pVersus->games[i];
+        if ((events[i] & TETRIS_EVENT_LOCKED)
+            && pGame->clearedRows == 0 && pVersus->pending[i]) {
+
+            count = pVersus->pending[i];
+            if (count > TETRIS_MAX_GARBAGE) {
+
+                count = TETRIS_MAX_GARBAGE;
+            }
+            pVersus->pending[i] -= count;
+            events[i] |= TETRIS_AddGarbage(pGame, count,
+                             PRNG_Range(&pVersus->garbage, TETRIS_WIDTH));
+            if (!pGame->gameOver) {
+
+                pVersus->received[i] += count;
+            }
+        }
+    }
+
+    if (pVersus->winner == VERSUS_PLAYING) {
+
+        if (pVersus->games[0].gameOver && pVersus->games[1].gameOver) {
+
+            pVersus->winner = VERSUS_DRAW;
+        }
+        else if (pVersus->games[0].gameOver) {
+
+            pVersus->winner = 1;
+        }
+        else if (pVersus->games[1].gameOver) {
+
+            pVersus->winner = 0;
+        }
+    }
+
+    return events[0] | (events[1] << 8);
+}
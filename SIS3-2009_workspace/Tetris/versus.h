@@ -0,0 +1,67 @@
+//------------------------------------------------------------------------------
+//         Versus mode rules
+//------------------------------------------------------------------------------
+//
+// Two games played side by side from the same piece sequence. Clearing 2, 3
+// or 4 lines at once sends 1, 2 or 4 garbage rows to the opponent; rows
+// cleared first cancel garbage still pending against the player, then the
+// attacks of both players in the same tick cancel each other. Pending
+// garbage is inserted when the player locks a piece without clearing a line,
+// with the hole column drawn from a PRNG stream of the versus state.
+//
+// The whole state is a plain structure advanced only by VERSUS_Tick(), so
+// both units of a link can simulate both games, and save and restore it for
+// rollback with memcpy().
+//
+//------------------------------------------------------------------------------
+
+#ifndef __VERSUS_H__
+#define __VERSUS_H__
+
+#include "typedef.h"
+#include "tetris.h"
+
+#include <utility/prng.h>
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+#define VERSUS_PLAYERS        2
+
+/// Values of Versus.winner.
+#define VERSUS_PLAYING        0xFF
+#define VERSUS_DRAW           VERSUS_PLAYERS
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+
+    Tetris games[VERSUS_PLAYERS];
+
+    /// Hole columns of the garbage rows.
+    Prng garbage;
+
+    /// Garbage rows waiting to be inserted in each game.
+    UBYTE pending[VERSUS_PLAYERS];
+
+    /// Garbage rows sent by each player, and inserted in each game.
+    UWORD sent[VERSUS_PLAYERS];
+    UWORD received[VERSUS_PLAYERS];
+
+    /// Winning player, VERSUS_DRAW or VERSUS_PLAYING.
+    UBYTE winner;
+
+} Versus;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void VERSUS_Init(Versus *pVersus, ULONG seed);
+
+extern unsigned int VERSUS_Tick(Versus *pVersus, const UBYTE *pActions);
+
+#endif //#ifndef __VERSUS_H__
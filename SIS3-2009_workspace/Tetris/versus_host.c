@@ -0,0 +1,353 @@
+//------------------------------------------------------------------------------
+//         Linked versus test (host)
+//------------------------------------------------------------------------------
+//
+// Usage: tetris-versus [-t ticks] [-s seed] [-j jitter_us] [-d drop_per_mille]
+//
+// Forks two AI players that play a linked versus match through the same link
+// code as the boards. The players use different AI weights, so their line
+// clears differ and garbage goes both ways. The parent relays the bytes
+// between them and may drop some, to exercise the resynchronization of the
+// packet stream and the retransmission of missing inputs; the random delays
+// of each player make the predictions fail and exercise the rollbacks. Both
+// players exchange the state hashes up to the given tick. The exit code is 1
+// on a desync, when the link is lost, when the last exchange does not
+// complete within TIMEOUT_MS, when the hashes of the last exchange differ,
+// or when no garbage was inserted in either game.
+//
+//------------------------------------------------------------------------------
+
+#include "link.h"
+#include "linkport.h"
+#include "ai.h"
+
+#include <utility/prng.h>
+
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+#define DEFAULT_TICKS   20000
+
+/// Milliseconds a player waits for the last state hash exchange once it
+/// reached the last tick, and keeps answering the peer's hashes after it.
+#define TIMEOUT_MS      10000
+#define LINGER_MS       200
+
+/// PRNG streams of the players' delays and of the relay.
+#define DELAY_STREAM    3
+#define RELAY_STREAM    4
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+static Link session;
+
+/// AI weights of each player: the second one digs less and waits for the
+/// bigger clears, which send more garbage.
+static const AIWeights weights[2] = {
+    {-2250, 3418, -3218, -9349, -7899, -3386, 0},
+    {-4500, 1000, -3218, -9349, -7899, -1000, 0}
+};
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Returns a monotonic time in milliseconds.
+//------------------------------------------------------------------------------
+static unsigned long Milliseconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+//------------------------------------------------------------------------------
+/// Returns 1 once both sides have each other's state hash for the last sync
+/// tick before 'ticks'.
+//------------------------------------------------------------------------------
+static unsigned char Synced(unsigned long ticks)
+{
+    return session.localSyncTick >= ticks
+           && session.peerSyncTick == session.localSyncTick
+           && session.peerSyncAcked == session.localSyncTick;
+}
+
+//------------------------------------------------------------------------------
+/// Plays the match on one side of the link until the state hashes of the last
+/// sync tick before 'ticks' were exchanged.
+/// \return Process exit code.
+//------------------------------------------------------------------------------
+static int Player(unsigned int index, unsigned long ticks, unsigned long seed,
+                  unsigned int jitter)
+{
+    AIPlacement target;
+    Prng delays;
+    const Tetris *pGame;
+    unsigned int actions, pieces = ~0;
+    unsigned long deadline = 0, linger;
+    unsigned char timeout = 0;
+    const char *pFailure = "";
+
+    ticks -= ticks % LINK_SYNC_INTERVAL;
+    PRNG_Seed(&delays, seed + index, DELAY_STREAM);
+    LINK_Init(&session, PRNG_Next(&delays));
+
+    while (!LINK_Connect(&session)) {
+
+        usleep(1000);
+    }
+    pGame = &session.state.games[session.player];
+
+    while (!Synced(ticks)) {
+
+        LINK_Poll(&session);
+        if (session.desync || session.lost) {
+
+            break;
+        }
+        if (session.tick >= ticks) {
+
+            if (deadline == 0) {
+
+                deadline = Milliseconds() + TIMEOUT_MS;
+            }
+            else if ((long) (Milliseconds() - deadline) > 0) {
+
+                timeout = 1;
+                break;
+            }
+        }
+
+        // The AI plans on the predicted state, like a player looking at it,
+        // and waits for each action to show before the next one; after the
+        // match both sides keep ticking so the hashes keep flowing
+        actions = 0;
+        if (!pGame->gameOver && session.state.winner == VERSUS_PLAYING
+            && session.tick % (LINK_DELAY + 1) == 0) {
+
+            if (pGame->pieces != pieces) {
+
+                pieces = pGame->pieces;
+                AI_Search(pGame, &weights[index], 0, &target);
+            }
+            actions = AI_Actions(pGame, &target);
+        }
+        if (!LINK_Ready(&session)) {
+
+            // Waiting for the peer, a tick passes like on the board
+            usleep(1000);
+        }
+        LINK_Advance(&session, actions);
+
+        if (jitter) {
+
+            usleep(PRNG_Range(&delays, jitter));
+        }
+    }
+
+    // Answer the peer's hashes while its answer from this side may be lost
+    linger = Milliseconds() + LINGER_MS;
+    while ((long) (Milliseconds() - linger) < 0) {
+
+        LINK_Poll(&session);
+        usleep(1000);
+    }
+
+    // Besides the link's own verdict, the hashes of the last exchange must
+    // match and the garbage must have reached a playfield
+    if (session.desync) {
+
+        pFailure = ", DESYNC";
+    }
+    else if (session.lost) {
+
+        pFailure = ", LOST";
+    }
+    else if (timeout) {
+
+        pFailure = ", TIMEOUT";
+    }
+    else if (session.localSyncHash != session.peerSyncHash) {
+
+        pFailure = ", HASH MISMATCH";
+    }
+    else if (session.state.received[0] + session.state.received[1] == 0) {
+
+        pFailure = ", NO GARBAGE";
+    }
+
+    printf("player %u: tick %lu, hash %08lx/%08lx at %lu, winner %u, "
+           "lines %u/%u, sent %u/%u, received %u/%u, rollbacks %lu "
+           "(%lu ticks), stalls %lu, errors %lu, syncs %lu%s\n",
+           session.player, (unsigned long) session.tick,
+           (unsigned long) session.localSyncHash,
+           (unsigned long) session.peerSyncHash,
+           (unsigned long) session.localSyncTick,
+           session.state.winner, (unsigned int) session.state.games[0].lines,
+           (unsigned int) session.state.games[1].lines,
+           session.state.sent[0], session.state.sent[1],
+           session.state.received[0], session.state.received[1],
+           (unsigned long) session.stats.rollbacks,
+           (unsigned long) session.stats.resimulated,
+           (unsigned long) session.stats.stalls,
+           (unsigned long) session.stats.errors,
+           (unsigned long) session.stats.syncs, pFailure);
+    return (*pFailure != 0) ? 1 : 0;
+}
+
+//------------------------------------------------------------------------------
+/// Copies the bytes of the players to each other, dropping some of them,
+/// until both have exited.
+//------------------------------------------------------------------------------
+static void Relay(int fromPlayer[2], int toPlayer[2], unsigned long seed,
+                  unsigned int drop)
+{
+    struct pollfd fds[2];
+    unsigned char buffer[256];
+    unsigned int open = 2, i, j, kept;
+    ssize_t count;
+    Prng relay;
+
+    PRNG_Seed(&relay, seed, RELAY_STREAM);
+    for (i = 0; i < 2; i++) {
+
+        fds[i].fd = fromPlayer[i];
+        fds[i].events = POLLIN;
+    }
+
+    while (open) {
+
+        if (poll(fds, 2, -1) < 0) {
+
+            break;
+        }
+        for (i = 0; i < 2; i++) {
+
+            if (!fds[i].revents) {
+
+                continue;
+            }
+            count = read(fds[i].fd, buffer, sizeof(buffer));
+            if (count <= 0) {
+
+                // Player exited, stop polling its pipe
+                fds[i].fd = -1;
+                open--;
+                continue;
+            }
+            for (j = 0, kept = 0; j < (unsigned int) count; j++) {
+
+                if (PRNG_Range(&relay, 1000) >= drop) {
+
+                    buffer[kept++] = buffer[j];
+                }
+            }
+            if (kept && write(toPlayer[1 - i], buffer, kept) < 0) {
+
+                // The other player exited already
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    unsigned long ticks = DEFAULT_TICKS, seed = 1;
+    unsigned int jitter = 50, drop = 0, i;
+    int up[2][2], down[2][2], fromPlayer[2], toPlayer[2], status, result = 0;
+    pid_t pids[2];
+    int arg;
+
+    for (arg = 1; arg + 1 < argc; arg += 2) {
+
+        if (strcmp(argv[arg], "-t") == 0) {
+
+            ticks = strtoul(argv[arg + 1], 0, 0);
+        }
+        else if (strcmp(argv[arg], "-s") == 0) {
+
+            seed = strtoul(argv[arg + 1], 0, 0);
+        }
+        else if (strcmp(argv[arg], "-j") == 0) {
+
+            jitter = strtoul(argv[arg + 1], 0, 0);
+        }
+        else if (strcmp(argv[arg], "-d") == 0) {
+
+            drop = strtoul(argv[arg + 1], 0, 0);
+        }
+        else {
+
+            break;
+        }
+    }
+    if (arg < argc || ticks < LINK_SYNC_INTERVAL) {
+
+        fprintf(stderr, "usage: %s [-t ticks] [-s seed] [-j jitter_us] "
+                "[-d drop_per_mille]\n", argv[0]);
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, 0, _IOLBF, 0);
+
+    // up[i]: from player i to the relay, down[i]: from the relay to player i
+    for (i = 0; i < 2; i++) {
+
+        if (pipe(up[i]) < 0 || pipe(down[i]) < 0) {
+
+            return 2;
+        }
+    }
+    for (i = 0; i < 2; i++) {
+
+        pids[i] = fork();
+        if (pids[i] == 0) {
+
+            close(up[i][0]);
+            close(down[i][1]);
+            close(up[1 - i][1]);
+            close(down[1 - i][0]);
+            LINKPORT_Open(down[i][0], up[i][1]);
+            exit(Player(i, ticks, seed, jitter));
+        }
+    }
+    for (i = 0; i < 2; i++) {
+
+        close(up[i][1]);
+        close(down[i][0]);
+        fromPlayer[i] = up[i][0];
+        toPlayer[i] = down[i][1];
+    }
+
+    Relay(fromPlayer, toPlayer, seed, drop);
+
+    for (i = 0; i < 2; i++) {
+
+        if (waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status)
+            || WEXITSTATUS(status) != 0) {
+
+            result = 1;
+        }
+    }
+    printf("%s\n", result ? "FAILED" : "OK");
+    return result;
+}
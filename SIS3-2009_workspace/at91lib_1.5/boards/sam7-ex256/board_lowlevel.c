@@ -76,11 +76,12 @@
 //         Internal functions
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
-/// Default spurious interrupt handler. Infinite loop.
+/// Default spurious interrupt handler. A source disabled while it asserts the
+/// IRQ leaves it with nothing to serve, and the IRQ handler acknowledges the
+/// end of the interrupt, so it simply returns.
 //------------------------------------------------------------------------------
 void defaultSpuriousHandler( void )
 {
-    while (1);
 }
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,313 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include "input.h"
+#include <pio/pio_it.h>
+#include <utility/assert.h>
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+/// Button pins and their number.
+static const Pin *pInputPins;
+static unsigned int numPins;
+
+/// Ticks a pin must stay quiet before it is sampled.
+static unsigned int debouncePeriod;
+
+/// Ticks left before each pin is sampled, 0 when it is not bouncing. Written
+/// by the PIO interrupt (restart) and INPUT_Tick() (count down) only.
+static volatile unsigned char settle[INPUT_MAX_PINS];
+
+/// Tick count at the first edge of each pin's current bounce.
+static volatile unsigned int edgeTime[INPUT_MAX_PINS];
+
+/// Last tick count given to INPUT_Tick().
+static volatile unsigned int now;
+
+/// Time stamp source of the edges, 0 to use the tick count.
+static unsigned int (*pEdgeClock)(void);
+
+/// Debounced state, bit i set while button i is held.
+static volatile unsigned int state;
+
+/// Event queue: INPUT_Tick() writes the head, INPUT_GetEvent() the tail.
+static volatile InputEvent queue[INPUT_QUEUE_SIZE];
+static volatile unsigned int head;
+static volatile unsigned int tail;
+
+/// Events dropped because the queue was full.
+static volatile unsigned int overflows;
+
+/// Injected events, in tick order: INPUT_Inject() writes the head,
+/// INPUT_Tick() the tail. The tick field holds the tick they are due at.
+static volatile InputEvent injected[INPUT_INJECT_SIZE];
+static volatile unsigned int injectHead;
+static volatile unsigned int injectTail;
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Restarts the debounce period of a button on every edge of its pin.
+/// \param pPin  Pin that changed.
+//------------------------------------------------------------------------------
+static void EdgeHandler(const Pin *pPin)
+{
+    unsigned int i = pPin - pInputPins;
+
+    // The level is only sampled once the pin settles
+    if (settle[i] == 0) {
+
+        edgeTime[i] = pEdgeClock ? pEdgeClock() : now;
+    }
+    settle[i] = debouncePeriod;
+}
+
+//------------------------------------------------------------------------------
+/// Appends an event to the queue, or counts it as lost if the queue is full.
+//------------------------------------------------------------------------------
+static void Push(unsigned int button, unsigned int type, unsigned int time)
+{
+    volatile InputEvent *pEvent;
+
+    if (head - tail >= INPUT_QUEUE_SIZE) {
+
+        overflows++;
+        return;
+    }
+    pEvent = &queue[head % INPUT_QUEUE_SIZE];
+    pEvent->time = time;
+    pEvent->tick = now;
+    pEvent->button = button;
+    pEvent->type = type;
+
+    // Published last, the consumer never sees a half written event
+    head++;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the level of a button, 1 if it is pressed.
+//------------------------------------------------------------------------------
+static unsigned int IsPressed(const Pin *pPin)
+{
+    return !PIO_Get(pPin);
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Starts watching the buttons. Their state is read once here; afterwards it
+/// only changes through the interrupts.
+/// \param pPins  Button pins, configured as inputs, low while pressed. The
+///               list must stay valid, the PIO interrupts refer to it.
+/// \param count  Number of pins, at most INPUT_MAX_PINS.
+/// \param priority  Priority of the PIO interrupts (0 ... 7).
+/// \param debounce  Debounce period, in calls of INPUT_Tick(). A pin is
+///                  sampled between debounce - 1 and debounce ticks after its
+///                  last edge, so 2 ensures at least one whole tick.
+//------------------------------------------------------------------------------
+void INPUT_Initialize(
+    const Pin *pPins,
+    unsigned int count,
+    unsigned int priority,
+    unsigned int debounce)
+{
+    unsigned int i;
+
+    SANITY_CHECK(count <= INPUT_MAX_PINS);
+    SANITY_CHECK(debounce > 0 && debounce < 256);
+
+    pInputPins = pPins;
+    numPins = count;
+    debouncePeriod = debounce;
+    head = tail = overflows = 0;
+    injectHead = injectTail = 0;
+
+    state = 0;
+    for (i = 0; i < count; i++) {
+
+        settle[i] = 0;
+        if (IsPressed(&pPins[i])) {
+
+            state |= 1 << i;
+        }
+    }
+
+    PIO_InitializeInterrupts(priority);
+    for (i = 0; i < count; i++) {
+
+        PIO_ConfigureIt(&pPins[i], EdgeHandler);
+        PIO_EnableIt(&pPins[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Stamps the events with a clock finer than the tick count.
+/// \param pClock  Function returning the current time, called from the PIO
+///                interrupt; 0 to go back to the tick count.
+//------------------------------------------------------------------------------
+void INPUT_SetClock(unsigned int (*pClock)(void))
+{
+    pEdgeClock = pClock;
+}
+
+//------------------------------------------------------------------------------
+/// Counts down the debounce periods and reports the buttons that settled in
+/// a new state, then applies the injected events that are due. Must be
+/// called periodically from one interrupt handler.
+/// \param time  Current tick count, the time stamp of the next edges.
+//------------------------------------------------------------------------------
+void INPUT_Tick(unsigned int time)
+{
+    volatile InputEvent *pInjected;
+    unsigned int i, bit, pressed;
+
+    now = time;
+    for (i = 0; i < numPins; i++) {
+
+        if (settle[i] == 0 || --settle[i] != 0) {
+
+            continue;
+        }
+
+        // Quiet for a whole period: a bounce that ends where it started
+        // (a glitch) is not reported
+        bit = 1 << i;
+        pressed = IsPressed(&pInputPins[i]);
+        if (pressed != ((state & bit) != 0)) {
+
+            state ^= bit;
+            Push(i, pressed ? INPUT_PRESS : INPUT_RELEASE, edgeTime[i]);
+        }
+    }
+
+    // Injected events go through the same state and queue; one that does
+    // not change the state is dropped like a glitch
+    while (injectTail != injectHead) {
+
+        pInjected = &injected[injectTail % INPUT_INJECT_SIZE];
+        if ((int) (time - pInjected->tick) < 0) {
+
+            break;
+        }
+        bit = 1 << pInjected->button;
+        pressed = (pInjected->type == INPUT_PRESS);
+        if (pressed != ((state & bit) != 0)) {
+
+            state ^= bit;
+            Push(pInjected->button,
+                 pInjected->type,
+                 pEdgeClock ? pEdgeClock() : time);
+        }
+        injectTail++;
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Takes the oldest event from the queue.
+/// \param pEvent  Event read.
+/// \return 1 if there was an event, 0 if the queue is empty.
+//------------------------------------------------------------------------------
+unsigned char INPUT_GetEvent(InputEvent *pEvent)
+{
+    volatile InputEvent *pQueued;
+
+    if (tail == head) {
+
+        return 0;
+    }
+    pQueued = &queue[tail % INPUT_QUEUE_SIZE];
+    pEvent->time = pQueued->time;
+    pEvent->tick = pQueued->tick;
+    pEvent->button = pQueued->button;
+    pEvent->type = pQueued->type;
+
+    // Released last, the producer never overwrites an event being read
+    tail++;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Queues an event to be applied by INPUT_Tick() as if the button had
+/// settled in that state. Must be called from one context only, in tick
+/// order.
+/// \param button  Index of the button in the pin list.
+/// \param type  INPUT_PRESS or INPUT_RELEASE.
+/// \param tick  Tick count the event is due at; a past one applies on the
+///              next tick.
+/// \return 1 if the event was queued, 0 if the injection queue is full.
+//------------------------------------------------------------------------------
+unsigned char INPUT_Inject(
+    unsigned int button,
+    unsigned int type,
+    unsigned int tick)
+{
+    volatile InputEvent *pInjected;
+
+    SANITY_CHECK(button < numPins);
+
+    if (injectHead - injectTail >= INPUT_INJECT_SIZE) {
+
+        return 0;
+    }
+    pInjected = &injected[injectHead % INPUT_INJECT_SIZE];
+    pInjected->tick = tick;
+    pInjected->button = button;
+    pInjected->type = type;
+
+    // Published last, INPUT_Tick() never sees a half written event
+    injectHead++;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the debounced state of the buttons, bit i set while button i is
+/// held.
+//------------------------------------------------------------------------------
+unsigned int INPUT_GetState(void)
+{
+    return state;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the number of events lost because the queue was full.
+//------------------------------------------------------------------------------
+unsigned int INPUT_GetOverflows(void)
+{
+    return overflows;
+}
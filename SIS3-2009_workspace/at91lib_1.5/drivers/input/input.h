@@ -0,0 +1,152 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+/// \unit
+///
+/// !!!Purpose
+///
+/// Interrupt driven, debounced input from push buttons (the joystick and the
+/// two switches of the SAM7-EX256), instead of polling the pins with
+/// PIO_Get() in the main loop.
+///
+/// Every button pin raises a PIO interrupt on any edge (see pio_it.h). The
+/// edge only restarts the debounce count of its button; INPUT_Tick(), called
+/// from a periodic interrupt such as the PIT, samples the buttons whose pin
+/// has been quiet for a whole debounce period and reports the ones that
+/// changed as a press or a release. A press is reported one debounce period
+/// after the contacts settle, even if it is over before the main loop looks,
+/// and the main loop never reads the pins. A pulse shorter than the debounce
+/// period, that ends at the level it started from, is taken for noise.
+///
+/// Events carry the time of their first edge, the tick count or the value of
+/// a finer clock given to INPUT_SetClock(), and go through a
+/// single-producer, single-consumer queue: INPUT_Tick() only writes the head,
+/// INPUT_GetEvent() only writes the tail, so neither needs to disable
+/// interrupts. The debounced state of all the buttons is also kept as a
+/// bitmask, bit i for the i-th pin given to INPUT_Initialize().
+///
+/// Events can also be injected, for example from a recorded session played
+/// back over a serial port. INPUT_Inject() queues them with the tick they are
+/// due at, and INPUT_Tick() applies them to the state and the event queue
+/// like a button that settled on that tick, so the consumer cannot tell them
+/// from physical ones. Every event carries that tick, which is what a
+/// recording needs to reproduce it.
+///
+/// !!!Usage
+///
+/// -# Configure the pins as inputs with PIO_Configure().
+/// -# Call INPUT_Initialize() with the pins, active low, and the debounce
+///    period in ticks. It initializes the PIO interrupts with
+///    PIO_InitializeInterrupts(), so other PIO interrupts must be configured
+///    after it.
+/// -# Call INPUT_Tick() from the periodic interrupt, with the current tick
+///    count.
+/// -# Read the events with INPUT_GetEvent() and the held buttons with
+///    INPUT_GetState().
+/// -# To measure latencies, give INPUT_SetClock() a function that returns a
+///    high resolution time stamp; it is called from the PIO interrupt.
+/// -# To play back events, call INPUT_Inject() from the main loop with the
+///    tick count they are due at.
+//------------------------------------------------------------------------------
+
+#ifndef INPUT_H
+#define INPUT_H
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include <pio/pio.h>
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Most buttons handled.
+#define INPUT_MAX_PINS          7
+
+/// Events the queue holds, a power of two. Events arriving while it is full
+/// are dropped and counted.
+#define INPUT_QUEUE_SIZE        16
+
+/// Injected events waiting for their tick, a power of two.
+#define INPUT_INJECT_SIZE       16
+
+/// Event types.
+#define INPUT_RELEASE           0
+#define INPUT_PRESS             1
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// One press or release of a button.
+typedef struct {
+
+    /// Tick count, or clock value, when the pin first changed.
+    unsigned int time;
+
+    /// Tick count given to INPUT_Tick() when the event was reported.
+    unsigned int tick;
+
+    /// Index of the button in the pin list.
+    unsigned char button;
+
+    /// INPUT_PRESS or INPUT_RELEASE.
+    unsigned char type;
+
+} InputEvent;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void INPUT_Initialize(
+    const Pin *pPins,
+    unsigned int count,
+    unsigned int priority,
+    unsigned int debounce);
+
+extern void INPUT_SetClock(unsigned int (*pClock)(void));
+
+extern void INPUT_Tick(unsigned int time);
+
+extern unsigned char INPUT_GetEvent(InputEvent *pEvent);
+
+extern unsigned char INPUT_Inject(
+    unsigned int button,
+    unsigned int type,
+    unsigned int tick);
+
+extern unsigned int INPUT_GetState(void);
+
+extern unsigned int INPUT_GetOverflows(void);
+
+#endif //#ifndef INPUT_H
@@ -75,6 +75,7 @@
 //  Include Files 
 //  ****************************************************************************
 #include <board.h>
+#include <utility/timestamp.h>
 #include "lcd.h"
 
 
@@ -239,15 +240,18 @@ void Backlight(unsigned char state) {
 //     
 //     Inputs:  none
 //
+//     The waits run on the time stamp, TIMESTAMP_Initialize() must have
+//     been called.
+//
 //      Author:  James P Lynch     August 30, 2007
 //  ****************************************************************************
 void InitLcd(void) {
     
     // Hardware reset
     LCD_RESET_LOW;
-    Delay(10000);
+    TIMESTAMP_WaitMs(2);
     LCD_RESET_HIGH;
-    Delay(10000);
+    TIMESTAMP_WaitMs(2);
 
     // Display control
     WriteSpiCommand(DISCTL);
@@ -284,7 +288,7 @@ void InitLcd(void) {
     WriteSpiData(3);    // P2 = 3   resistance ratio (only value that works)
 
     // allow power supply to stabilize
-    Delay(100000);
+    TIMESTAMP_WaitMs(20);
 
     // turn on the display
     WriteSpiCommand(DISON); 
@@ -870,22 +874,6 @@ void LCDPutStr(char *pString, int  x, int  y, int Size, int fColor, int bColor)
 }
 
 
-//  ****************************************************************************
-//                          Delay.c
-// 
-//      Simple for loop delay
-//     
-//      Inputs: a  -  loop count
-//
-//      Author:  James P Lynch  August 30, 2007
-//  ****************************************************************************
-void Delay (unsigned long a) { 
-    while (--a!=0) {
-       asm volatile ("mov r0, r0"); // nop
-    }
-}
-
-
 //  ****************************************************************************
 // 
 //      Font tables for Nokia 6610 LCD Display Driver  (S1D15G00 Controller)
@@ -127,7 +127,6 @@ void LCDSetRect(int x0, int y0, int x1, int y1, unsigned char fill, int color);
 void LCDSetCircle(int x0, int y0, int radius, int color);
 void LCDPutChar(char c, int  x, int  y, int size, int fcolor, int bcolor);
 void LCDPutStr(char *pString, int  x, int  y, int Size, int fColor, int bColor);
-void Delay (unsigned long a);
 
 #endif		// Lcd_h
 
@@ -238,6 +238,22 @@ unsigned int ADC_GetConvertedData(AT91S_ADC *pAdc, unsigned int channel)
     return data;    
 }
 
+//-----------------------------------------------------------------------------
+/// Keeps the PDC storing the converted data into a ring, one per enabled
+/// channel and conversion, in the order of the channels, and publishes what
+/// it stored since the last call; the ADC is the producer of the ring. Call
+/// it from the loop or the ENDRX interrupt.
+/// \param pAdc Pointer to an AT91S_ADC instance.
+/// \param pRing Ring of unsigned short, or unsigned char in 8-bit resolution
+/// \return Number of data stored
+//-----------------------------------------------------------------------------
+unsigned int ADC_ReadRing(AT91S_ADC *pAdc, Ring *pRing)
+{
+    ASSERT(pRing->elementSize <= 2, "ADC Bad ring element size\n\r");
+
+    return RING_ReceivePdc(pRing, (AT91PS_PDC) &(pAdc->ADC_RPR));
+}
+
 //-----------------------------------------------------------------------------
 /// Enable ADC interrupt
 /// \param pAdc Pointer to an AT91S_ADC instance.
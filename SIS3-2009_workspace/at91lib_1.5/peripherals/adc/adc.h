@@ -42,6 +42,8 @@
 /// -# Start the conversion with ADC_StartConversion()
 //  -# Wait the end of the conversion by polling status with ADC_GetStatus()
 //  -# Finally, get the converted data using ADC_GetConvertedData()
+/// -# Or let the PDC store the data of the enabled channels into a ring (see
+///    ring.h), calling ADC_ReadRing()
 ///
 //------------------------------------------------------------------------------
 #ifndef ADC_H
@@ -51,6 +53,8 @@
 //         Headers
 //------------------------------------------------------------------------------
 
+#include <utility/ring.h>
+
 //------------------------------------------------------------------------------
 //         Definitions
 //------------------------------------------------------------------------------
@@ -84,6 +88,7 @@ extern void ADC_StartConversion(AT91S_ADC *pAdc);
 extern void ADC_SoftReset(AT91S_ADC *pAdc);
 extern unsigned int ADC_GetLastConvertedData(AT91S_ADC *pAdc);
 extern unsigned int ADC_GetConvertedData(AT91S_ADC *pAdc, unsigned int channel);
+extern unsigned int ADC_ReadRing(AT91S_ADC *pAdc, Ring *pRing);
 extern void ADC_EnableIt(AT91S_ADC *pAdc, unsigned int flag);
 extern void ADC_EnableDataReadyIt(AT91S_ADC *pAdc);
 extern void ADC_DisableIt(AT91S_ADC *pAdc, unsigned int flag);
@@ -34,6 +34,8 @@
 #include <board.h>
 #include <pio/pio.h>
 #include <utility/trace.h>
+#include <utility/dpc.h>
+#include <utility/critical.h>
 #include <aic/aic.h>
 #include "can.h"
 
@@ -74,6 +76,21 @@ static CanTransfer *pCAN0Transfer=NULL;
 static CanTransfer *pCAN1Transfer=NULL;
 #endif
 
+// Rings the frames received are queued to, if any
+static Ring *pCAN0Ring=NULL;
+#ifdef AT91C_BASE_CAN1
+static Ring *pCAN1Ring=NULL;
+#endif
+
+// Deferred part of the interrupt handlers, and the interrupts they have
+// raised and their DPC has not taken yet
+static Dpc can0Dpc;
+static volatile unsigned int can0Pending;
+#ifdef AT91C_BASE_CAN1
+static Dpc can1Dpc;
+static volatile unsigned int can1Pending;
+#endif
+
 //------------------------------------------------------------------------------
 //         Local functions
 //------------------------------------------------------------------------------
@@ -140,15 +157,47 @@ static void CAN_ErrorHandling( unsigned int status, unsigned char can_number)
 }
 
 //------------------------------------------------------------------------------
-// Generic CAN Interrupt handler
+/// Queue a frame received to a ring, as its only producer
+/// \param pRing       ring of CanFrame, or NULL
+/// \param CAN_Mailbox first mailbox of the controller
+/// \param numMailbox  mailbox number
+/// \param can_msr     status of the mailbox
+//------------------------------------------------------------------------------
+static void CAN_QueueFrame( Ring *pRing, AT91PS_CAN_MB CAN_Mailbox,
+                            unsigned char numMailbox, unsigned int can_msr )
+{
+    CanFrame frame;
+
+    if( pRing == NULL ) {
+        return;
+    }
+    //CAN_MB_MIDx
+    frame.identifier =
+       (*(unsigned int*)((unsigned int)CAN_Mailbox+(unsigned int)(0x08+(0x20*numMailbox))));
+    //CAN_MB_MDLx
+    frame.data_low_reg =
+       (*(unsigned int*)((unsigned int)CAN_Mailbox+(unsigned int)(0x14+(0x20*numMailbox))));
+    //CAN_MB_MDHx
+    frame.data_high_reg =
+       (*(unsigned int*)((unsigned int)CAN_Mailbox+(unsigned int)(0x18+(0x20*numMailbox))));
+    frame.mailbox_number = numMailbox;
+    frame.size = (can_msr>>16)&0xF;
+
+    if( RING_Push(pRing, &frame, 1) == 0 ) {
+        TRACE_ERROR("(CAN) receive ring full\n\r");
+    }
+}
+
+//------------------------------------------------------------------------------
+// Generic CAN interrupt processing, deferred from the interrupt handler: reads
+// the mailboxes and updates the transfers
+/// \param status     interrupts raised, already disabled by the handler
 /// \param can_number can nulber
 //------------------------------------------------------------------------------
-static void CAN_Handler( unsigned char can_number ) 
+static void CAN_Process( unsigned int status, unsigned char can_number ) 
 {
-    AT91PS_CAN base_can;
     AT91PS_CAN_MB CAN_Mailbox;
 
-    unsigned int status;
     unsigned int can_msr;
     unsigned int* pCan_mcr;
     unsigned int message_mode;
@@ -157,19 +206,15 @@ static void CAN_Handler( unsigned char can_number )
     unsigned char state1=CAN_DISABLED;
 
     if( can_number == 0 ) {
-        base_can = AT91C_BASE_CAN0;
         CAN_Mailbox = AT91C_BASE_CAN0_MB0;
         state0 = pCAN0Transfer->state;
     }
 #ifdef AT91C_BASE_CAN1
     else {
-        base_can = AT91C_BASE_CAN1;
         CAN_Mailbox = AT91C_BASE_CAN1_MB0;
         state1 = pCAN1Transfer->state;
     }
 #endif
-    status = (base_can->CAN_SR) & (base_can->CAN_IMR);
-    base_can->CAN_IDR = status;
 
     TRACE_DEBUG("CAN0 status=0x%X\n\r", status);
     if(status & AT91C_CAN_WAKEUP) {
@@ -232,6 +277,16 @@ static void CAN_Handler( unsigned char can_number )
                         pCAN1Transfer->mailbox_number = numMailbox;
                         state1 = CAN_IDLE;
                     }
+#endif
+                    // Queue the frame as well, so that none is overwritten
+                    // before the application reads it
+                    if( can_number == 0 ) {
+                        CAN_QueueFrame( pCAN0Ring, CAN_Mailbox, numMailbox, can_msr );
+                    }
+#ifdef AT91C_BASE_CAN1
+                    else {
+                        CAN_QueueFrame( pCAN1Ring, CAN_Mailbox, numMailbox, can_msr );
+                    }
 #endif
                     // Message Data has been received
                     pCan_mcr = (unsigned int*)((unsigned int)CAN_Mailbox+0x1C+(0x20*numMailbox));
@@ -265,12 +320,83 @@ static void CAN_Handler( unsigned char can_number )
     }
 }
 
+//------------------------------------------------------------------------------
+/// Takes the interrupts raised on a controller and not processed yet
+/// \param pPending   pending interrupts of the controller
+/// \return interrupts raised
+//------------------------------------------------------------------------------
+static unsigned int CAN_TakePending( volatile unsigned int *pPending )
+{
+    unsigned int cpsr;
+    unsigned int status;
+
+    cpsr = CRITICAL_Lock();
+    status = *pPending;
+    *pPending = 0;
+    CRITICAL_Unlock(cpsr);
+
+    return status;
+}
+
+//------------------------------------------------------------------------------
+/// CAN 0 deferred interrupt processing
+/// \param pArgument unused
+//------------------------------------------------------------------------------
+static void CAN0_Process( void *pArgument )
+{
+    CAN_Process( CAN_TakePending(&can0Pending), 0 );
+}
+
+//------------------------------------------------------------------------------
+/// CAN 1 deferred interrupt processing
+/// \param pArgument unused
+//------------------------------------------------------------------------------
+#if defined AT91C_BASE_CAN1
+static void CAN1_Process( void *pArgument )
+{
+    CAN_Process( CAN_TakePending(&can1Pending), 1 );
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Generic CAN Interrupt handler: disables the interrupts raised and leaves
+// their processing to a DPC, with the interrupts enabled. The interrupts wait
+// in the pending word of the controller, for one DPC queued for them all;
+// with the DPC queue full they are processed here, since the sources stay
+// disabled until they are.
+/// \param base_can   CAN controller
+/// \param pDpc       DPC of the controller
+/// \param pPending   pending interrupts of the controller
+/// \param can_number can nulber
+//------------------------------------------------------------------------------
+static void CAN_Handler( AT91PS_CAN base_can, Dpc *pDpc,
+                         volatile unsigned int *pPending,
+                         unsigned char can_number )
+{
+    unsigned int status;
+    unsigned int cpsr;
+    unsigned char queue;
+
+    status = (base_can->CAN_SR) & (base_can->CAN_IMR);
+    base_can->CAN_IDR = status;
+
+    cpsr = CRITICAL_Lock();
+    queue = (status != 0) && (*pPending == 0);
+    *pPending |= status;
+    CRITICAL_Unlock(cpsr);
+
+    if( queue && !DPC_Queue(pDpc, 0) ) {
+        TRACE_WARNING("(CAN) DPC queue full, processed in the handler\n\r");
+        CAN_Process( CAN_TakePending(pPending), can_number );
+    }
+}
+
 //------------------------------------------------------------------------------
 /// CAN 0 Interrupt handler
 //------------------------------------------------------------------------------
 static void CAN0_Handler(void)
 {
-    CAN_Handler( 0 );
+    CAN_Handler( AT91C_BASE_CAN0, &can0Dpc, &can0Pending, 0 );
 }
 
 //------------------------------------------------------------------------------
@@ -279,7 +405,7 @@ static void CAN0_Handler(void)
 #if defined AT91C_BASE_CAN1
 static void CAN1_Handler(void)
 {
-    CAN_Handler( 1 );
+    CAN_Handler( AT91C_BASE_CAN1, &can1Dpc, &can1Pending, 1 );
 }
 #endif
 
@@ -561,6 +687,24 @@ unsigned char CAN_IsInIdle( CanTransfer *pTransfer )
   return( pTransfer->state != CAN_IDLE );
 }
 
+//------------------------------------------------------------------------------
+/// Set the ring the frames received by a controller are queued to, besides
+/// its transfer structure; the CAN driver is the producer of the ring
+/// \param can_number can number
+/// \param pRing      ring of CanFrame, NULL to stop queuing
+//------------------------------------------------------------------------------
+void CAN_SetReceiveRing( unsigned char can_number, Ring *pRing )
+{
+    if( can_number == 0 ) {
+        pCAN0Ring = pRing;
+    }
+#ifdef AT91C_BASE_CAN1
+    else {
+        pCAN1Ring = pRing;
+    }
+#endif
+}
+
 //------------------------------------------------------------------------------
 /// Basic CAN test without Interrupt
 //------------------------------------------------------------------------------
@@ -952,6 +1096,9 @@ unsigned char CAN_BaudRateCalculate( AT91PS_CAN   base_CAN,
 /// \param canTransfer1 CAN1 structure transfer
 /// \return return 1 if CAN has good baudrate and CAN is synchronized, 
 ///         otherwise return 0
+/// The interrupt handlers leave the mailboxes to DPCs, DPC_Initialize() must
+/// have been called; with DPC_POLLED, the transfers only complete while the
+/// program runs DPC_Run().
 //------------------------------------------------------------------------------
 unsigned char CAN_Init( unsigned int baudrate, 
                         CanTransfer *canTransfer0, 
@@ -998,6 +1145,8 @@ unsigned char CAN_Init( unsigned int baudrate,
     PIO_Clear(&pin_can_transceiver_rs);
 
     // Configure the AIC for CAN interrupts
+    DPC_Create(&can0Dpc, CAN0_Process);
+    can0Pending = 0;
     AIC_ConfigureIT(AT91C_ID_CAN0, AT91C_AIC_PRIOR_HIGHEST, CAN0_Handler);
 
     // Enable the interrupt on the interrupt controller
@@ -1021,6 +1170,8 @@ unsigned char CAN_Init( unsigned int baudrate,
         AT91C_BASE_CAN1->CAN_IDR = 0x1FFFFFFF;
 
         // Configure the AIC for CAN interrupts
+        DPC_Create(&can1Dpc, CAN1_Process);
+        can1Pending = 0;
         AIC_ConfigureIT(AT91C_ID_CAN1, AT91C_AIC_PRIOR_HIGHEST, CAN1_Handler);
 
         // Enable the interrupt on the interrupt controller
@@ -30,6 +30,11 @@
 #ifndef _CAN_H
 #define _CAN_H
 
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+#include <utility/ring.h>
+
 //------------------------------------------------------------------------------
 //      Definitions
 //------------------------------------------------------------------------------
@@ -91,6 +96,16 @@ typedef struct
     volatile int           size;
 } CanTransfer;
 
+// Frame received, as queued to a receive ring
+typedef struct
+{
+    unsigned int  identifier;
+    unsigned int  data_low_reg;
+    unsigned int  data_high_reg;
+    unsigned char mailbox_number;
+    unsigned char size;
+} CanFrame;
+
 //------------------------------------------------------------------------------
 //         Exported functions
 //------------------------------------------------------------------------------
@@ -103,6 +118,7 @@ extern void CAN_ResetAllMailbox( void );
 extern void CAN_ResetTransfer( CanTransfer *pTransfer );
 extern void CAN_InitMailboxRegisters( CanTransfer *pTransfer );
 extern unsigned char CAN_IsInIdle( CanTransfer *pTransfer );
+extern void CAN_SetReceiveRing( unsigned char can_number, Ring *pRing );
 
 extern unsigned char CAN_Write( CanTransfer *pTransfer );
 extern unsigned char CAN_Read( CanTransfer *pTransfer );
@@ -106,6 +106,29 @@ unsigned char DBGU_GetChar(void)
     return AT91C_BASE_DBGU->DBGU_RHR;
 }
 
+//------------------------------------------------------------------------------
+/// Keeps the PDC of the DBGU receiving into a ring of bytes, and publishes
+/// what it received since the last call; the DBGU is the producer of the
+/// ring.
+/// \param pRing  Ring of bytes.
+/// \return Number of bytes received.
+//------------------------------------------------------------------------------
+unsigned int DBGU_ReadRing(Ring *pRing)
+{
+    return RING_ReceivePdc(pRing, AT91C_BASE_PDC_DBGU);
+}
+
+//------------------------------------------------------------------------------
+/// Keeps the PDC of the DBGU sending the bytes of a ring, and releases what
+/// it sent since the last call; the DBGU is the consumer of the ring.
+/// \param pRing  Ring of bytes.
+/// \return Number of bytes sent.
+//------------------------------------------------------------------------------
+unsigned int DBGU_WriteRing(Ring *pRing)
+{
+    return RING_TransmitPdc(pRing, AT91C_BASE_PDC_DBGU);
+}
+
 #ifndef NOFPUT
 #include <stdio.h>
 
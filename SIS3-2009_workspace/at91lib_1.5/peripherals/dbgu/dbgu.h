@@ -45,6 +45,8 @@
 /// -# Configure the DBGU using DBGU_Configure with the desired operating mode.
 /// -# Send characters using DBGU_PutChar() or the printf() method.
 /// -# Receive characters using DBGU_GetChar().
+/// -# Or stream characters through rings (see ring.h) that the PDC fills and
+///    empties, calling DBGU_ReadRing() and DBGU_WriteRing() from the loop.
 ///
 /// \note Unless specified, all the functions defined here operate synchronously;
 /// i.e. they all wait the data is sent/received before returning.
@@ -53,6 +55,12 @@
 #ifndef DBGU_H
 #define DBGU_H
 
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include <utility/ring.h>
+
 //------------------------------------------------------------------------------
 //         Definitions
 //------------------------------------------------------------------------------
@@ -75,5 +83,9 @@ extern void DBGU_PutChar(unsigned char c);
 
 extern unsigned int DBGU_IsRxReady(void);
 
+extern unsigned int DBGU_ReadRing(Ring *pRing);
+
+extern unsigned int DBGU_WriteRing(Ring *pRing);
+
 #endif //#ifndef DBGU_H
 
@@ -34,6 +34,8 @@
 #include "emac.h"
 #include <utility/trace.h>
 #include <utility/assert.h>
+#include <utility/dpc.h>
+#include <utility/critical.h>
 #include <string.h>
 
 //------------------------------------------------------------------------------
@@ -159,6 +161,11 @@ static volatile unsigned char pTxBuffer[TX_BUFFERS * EMAC_TX_UNITSIZE] __attribu
 static volatile unsigned char pRxBuffer[RX_BUFFERS * EMAC_RX_UNITSIZE] __attribute__((aligned(8)));
 /// Statistics
 static volatile EmacStats EmacStatistics;
+/// Deferred processing of the interrupts
+static Dpc emacDpc;
+/// Status flags raised and not taken by the DPC yet, RX in the low half word
+/// and TX in the high half word
+static volatile unsigned int emacPending;
 
 //-----------------------------------------------------------------------------
 //         Internal functions
@@ -194,6 +201,71 @@ static unsigned char EMAC_WaitPhy( unsigned int retry )
     return 1;
 }
 
+//-----------------------------------------------------------------------------
+/// Processing of the EMAC interrupt, deferred by EMAC_Handler(): invokes the
+/// callbacks and releases the TX buffers sent, for every status flag raised
+/// since the last call.
+/// \param pArgument  Unused.
+//-----------------------------------------------------------------------------
+static void EMAC_Process(void *pArgument)
+{
+    volatile EmacTxTDescriptor *pTxTd;
+    volatile EMAC_TxCallback   *pTxCb;
+    unsigned int cpsr;
+    unsigned int status;
+    unsigned int rxStatusFlag;
+    unsigned int txStatusFlag;
+
+    cpsr = CRITICAL_Lock();
+    status = emacPending;
+    emacPending = 0;
+    CRITICAL_Unlock(cpsr);
+    rxStatusFlag = status & 0xFFFF;
+    txStatusFlag = status >> 16;
+
+    // RX packet
+    if (rxStatusFlag) {
+
+        // Invoke callbacks
+        if (rxTd.rxCb) {
+            rxTd.rxCb(rxStatusFlag);
+        }
+    }
+
+    // TX packet
+    if (txStatusFlag) {
+
+        // Sanity check: Tx buffers have to be scheduled
+        ASSERT(!CIRC_EMPTY(&txTd),
+            "-F- EMAC Tx interrupt received meanwhile no TX buffers has been scheduled\n\r");
+        
+        // Check the buffers
+        while (CIRC_CNT(txTd.head, txTd.tail, TX_BUFFERS)) {
+            pTxTd = txTd.td + txTd.tail;
+            pTxCb = txTd.txCb + txTd.tail;
+
+            // Exit if buffer has not been sent yet
+            if ((pTxTd->status & EMAC_TX_USED_BIT) == 0) {
+                break;
+            }
+            
+            // Notify upper layer that packet has been sent
+            if (*pTxCb) {
+                (*pTxCb)(txStatusFlag);
+            }
+            
+            CIRC_INC( txTd.tail, TX_BUFFERS );
+        }
+
+        // If a wakeup has been scheduled, notify upper layer that it can send 
+        // other packets, send will be successfull.
+        if( (CIRC_SPACE(txTd.head, txTd.tail, TX_BUFFERS) >= txTd.wakeupThreshold)
+         &&  txTd.wakeupCb) {
+            txTd.wakeupCb();
+        }
+    }
+}
+
 //-----------------------------------------------------------------------------
 //         Exported functions
 //-----------------------------------------------------------------------------
@@ -348,17 +420,21 @@ void EMAC_SetLinkSpeed(unsigned char speed, unsigned char fullduplex)
 //-----------------------------------------------------------------------------
 
 //-----------------------------------------------------------------------------
-/// EMAC Interrupt handler
+/// EMAC Interrupt handler: counts the frames and acknowledges them, and
+/// defers the callbacks and the release of the TX buffers to a DPC. The
+/// flags wait in a pending word, for one DPC queued for them all; with the
+/// DPC queue full they are processed here, the status registers are already
+/// cleared.
 //-----------------------------------------------------------------------------
 void EMAC_Handler(void)
 {
-    volatile EmacTxTDescriptor *pTxTd;
-    volatile EMAC_TxCallback   *pTxCb;
+    unsigned int cpsr;
+    unsigned char queue;
     unsigned int isr;
     unsigned int rsr;
     unsigned int tsr;
-    unsigned int rxStatusFlag;
-    unsigned int txStatusFlag;
+    unsigned int rxStatusFlag = 0;
+    unsigned int txStatusFlag = 0;
 
     //TRACE_DEBUG("EMAC_Handler\n\r");
     isr = AT91C_BASE_EMAC->EMAC_ISR & AT91C_BASE_EMAC->EMAC_IMR;
@@ -384,11 +460,6 @@ void EMAC_Handler(void)
         }
         // Clear status
         AT91C_BASE_EMAC->EMAC_RSR |= rxStatusFlag;
-
-        // Invoke callbacks
-        if (rxTd.rxCb) {
-            rxTd.rxCb(rxStatusFlag);
-        }
     }
 
     // TX packet
@@ -420,35 +491,17 @@ void EMAC_Handler(void)
         }
         // Clear status
         AT91C_BASE_EMAC->EMAC_TSR |= txStatusFlag;
+    }
 
-        // Sanity check: Tx buffers have to be scheduled
-        ASSERT(!CIRC_EMPTY(&txTd),
-            "-F- EMAC Tx interrupt received meanwhile no TX buffers has been scheduled\n\r");
-        
-        // Check the buffers
-        while (CIRC_CNT(txTd.head, txTd.tail, TX_BUFFERS)) {
-            pTxTd = txTd.td + txTd.tail;
-            pTxCb = txTd.txCb + txTd.tail;
-
-            // Exit if buffer has not been sent yet
-            if ((pTxTd->status & EMAC_TX_USED_BIT) == 0) {
-                break;
-            }
-            
-            // Notify upper layer that packet has been sent
-            if (*pTxCb) {
-                (*pTxCb)(txStatusFlag);
-            }
-            
-            CIRC_INC( txTd.tail, TX_BUFFERS );
-        }
+    // Both sets of flags fit in 16 bits
+    cpsr = CRITICAL_Lock();
+    queue = (rxStatusFlag | txStatusFlag) && (emacPending == 0);
+    emacPending |= rxStatusFlag | (txStatusFlag << 16);
+    CRITICAL_Unlock(cpsr);
 
-        // If a wakeup has been scheduled, notify upper layer that it can send 
-        // other packets, send will be successfull.
-        if( (CIRC_SPACE(txTd.head, txTd.tail, TX_BUFFERS) >= txTd.wakeupThreshold)
-         &&  txTd.wakeupCb) {
-            txTd.wakeupCb();
-        }
+    if (queue && !DPC_Queue(&emacDpc, 0)) {
+        TRACE_WARNING("EMAC DPC queue full, processed in the handler\n\r");
+        EMAC_Process(0);
     }
 }
 
@@ -473,6 +526,9 @@ void EMAC_Init( unsigned char id, const unsigned char *pMacAddress,
 
     TRACE_DEBUG("EMAC_Init\n\r");
 
+    DPC_Create(&emacDpc, EMAC_Process);
+    emacPending = 0;
+
     // Power ON
     AT91C_BASE_PMC->PMC_PCER = 1 << id;
 
@@ -40,7 +40,9 @@
 ///     
 /// !Usage
 ///
-/// -# Initialize EMAC with EMAC_Init with MAC address.
+/// -# Initialize EMAC with EMAC_Init with MAC address. EMAC_Handler defers the
+///      callbacks to a DPC, so DPC_Initialize must have been called; with
+///      DPC_POLLED, the callbacks only run while the program calls DPC_Run.
 /// -# Then the caller application need to initialize the PHY driver before further calling EMAC
 ///      driver.
 /// -# Get a packet from network
@@ -42,15 +42,21 @@
 #include <utility/assert.h>
 #include <utility/trace.h>
 
+#include <string.h>
+
 //------------------------------------------------------------------------------
 //         Local definitions
 //------------------------------------------------------------------------------
 
 /// \exclude
-/// Maximum number of interrupt sources that can be defined. This
-/// constant can be increased, but the current value is the smallest possible
-/// that will be compatible with all existing projects.
-#define MAX_INTERRUPT_SOURCES       7
+/// Number of pins of a PIO controller.
+#define PINS_PER_CONTROLLER         32
+
+/// \exclude
+/// De Bruijn sequence B(2, 5): multiplying it by a power of two leaves a
+/// distinct value in the five upper bits for each exponent. The ARM7TDMI has
+/// no count leading zeros instruction.
+#define DEBRUIJN                    0x077CB531
 
 //------------------------------------------------------------------------------
 //         Local types
@@ -72,141 +78,165 @@ typedef struct {
 } InterruptSource;
 
 //------------------------------------------------------------------------------
-//         Local variables
+/// \exclude
+/// A PIO controller and the peripheral ID its interrupts come from.
 //------------------------------------------------------------------------------
+typedef struct {
 
-/// List of interrupt sources.
-static InterruptSource pSources[MAX_INTERRUPT_SOURCES];
+    /// PIO controller base address.
+    AT91S_PIO *pPio;
 
-/// Number of currently defined interrupt sources.
-static unsigned int numSources;
+    /// PIO controller ID.
+    unsigned int id;
 
-//------------------------------------------------------------------------------
-//         Local functions
-//------------------------------------------------------------------------------
+} Controller;
 
 //------------------------------------------------------------------------------
-/// Handles all interrupts on the given PIO controller.
-/// \param id  PIO controller ID.
-/// \param pPio  PIO controller base address.
+//         Local variables
 //------------------------------------------------------------------------------
-static void PioInterruptHandler(unsigned int id, AT91S_PIO *pPio)
-{
-    unsigned int status;
-    unsigned int i;
-
-    // Read PIO controller status
-    status = pPio->PIO_ISR;
-    status &= pPio->PIO_IMR;
-
-    // Check pending events
-    if (status != 0) {
-
-        TRACE_DEBUG("PIO interrupt on PIO controller #%d\n\r", id);
-
-        // Find triggering source
-        i = 0;
-        while (status != 0) {
-
-            // There cannot be an unconfigured source enabled.
-            SANITY_CHECK(i < numSources);
-
-            // Source is configured on the same controller
-            if (pSources[i].pPin->id == id) {
-
-                // Source has PIOs whose statuses have changed
-                if ((status & pSources[i].pPin->mask) != 0) {
 
-                    TRACE_DEBUG("Interrupt source #%d triggered\n\r", i);
+/// PIO controllers handled.
+static const Controller controllers[] = {
 
-                    pSources[i].handler(pSources[i].pPin);
-                    status &= ~(pSources[i].pPin->mask);
-                }
-            }
-            i++;
-        }
-    }
-}
-
-//------------------------------------------------------------------------------
-/// Generic PIO interrupt handler. Single entry point for interrupts coming
-/// from any PIO controller (PIO A, B, C ...). Dispatches the interrupt to
-/// the user-configured handlers.
-//------------------------------------------------------------------------------
-static void InterruptHandler(void)
-{
 #if defined(AT91C_ID_PIOA)
-    // Treat PIOA interrupts
-    PioInterruptHandler(AT91C_ID_PIOA, AT91C_BASE_PIOA);
+    {AT91C_BASE_PIOA, AT91C_ID_PIOA},
 #endif
-
 #if defined(AT91C_ID_PIOB)
-    // Treat PIOB interrupts
-    PioInterruptHandler(AT91C_ID_PIOB, AT91C_BASE_PIOB);
+    {AT91C_BASE_PIOB, AT91C_ID_PIOB},
 #endif
-
 #if defined(AT91C_ID_PIOC)
-    // Treat PIOC interrupts
-    PioInterruptHandler(AT91C_ID_PIOC, AT91C_BASE_PIOC);
+    {AT91C_BASE_PIOC, AT91C_ID_PIOC},
 #endif
-
 #if defined(AT91C_ID_PIOD)
-    // Treat PIOD interrupts
-    PioInterruptHandler(AT91C_ID_PIOD, AT91C_BASE_PIOD);
+    {AT91C_BASE_PIOD, AT91C_ID_PIOD},
 #endif
-
 #if defined(AT91C_ID_PIOE)
-    // Treat PIOE interrupts
-    PioInterruptHandler(AT91C_ID_PIOE, AT91C_BASE_PIOE);
+    {AT91C_BASE_PIOE, AT91C_ID_PIOE},
 #endif
 
 #if defined(AT91C_ID_PIOABCD)
-    // Treat PIOABCD interrupts
     #if !defined(AT91C_ID_PIOA)
-        PioInterruptHandler(AT91C_ID_PIOABCD, AT91C_BASE_PIOA);
+    {AT91C_BASE_PIOA, AT91C_ID_PIOABCD},
     #endif
     #if !defined(AT91C_ID_PIOB)
-        PioInterruptHandler(AT91C_ID_PIOABCD, AT91C_BASE_PIOB);
+    {AT91C_BASE_PIOB, AT91C_ID_PIOABCD},
     #endif
     #if !defined(AT91C_ID_PIOC)
-        PioInterruptHandler(AT91C_ID_PIOABCD, AT91C_BASE_PIOC);
+    {AT91C_BASE_PIOC, AT91C_ID_PIOABCD},
     #endif
     #if !defined(AT91C_ID_PIOD)
-        PioInterruptHandler(AT91C_ID_PIOABCD, AT91C_BASE_PIOD);
+    {AT91C_BASE_PIOD, AT91C_ID_PIOABCD},
     #endif
 #endif
 
 #if defined(AT91C_ID_PIOABCDE)
-    // Treat PIOABCDE interrupts
     #if !defined(AT91C_ID_PIOA)
-        PioInterruptHandler(AT91C_ID_PIOABCDE, AT91C_BASE_PIOA);
+    {AT91C_BASE_PIOA, AT91C_ID_PIOABCDE},
     #endif
     #if !defined(AT91C_ID_PIOB)
-        PioInterruptHandler(AT91C_ID_PIOABCDE, AT91C_BASE_PIOB);
+    {AT91C_BASE_PIOB, AT91C_ID_PIOABCDE},
     #endif
     #if !defined(AT91C_ID_PIOC)
-        PioInterruptHandler(AT91C_ID_PIOABCDE, AT91C_BASE_PIOC);
+    {AT91C_BASE_PIOC, AT91C_ID_PIOABCDE},
     #endif
     #if !defined(AT91C_ID_PIOD)
-        PioInterruptHandler(AT91C_ID_PIOABCDE, AT91C_BASE_PIOD);
+    {AT91C_BASE_PIOD, AT91C_ID_PIOABCDE},
     #endif
     #if !defined(AT91C_ID_PIOE)
-        PioInterruptHandler(AT91C_ID_PIOABCDE, AT91C_BASE_PIOE);
+    {AT91C_BASE_PIOE, AT91C_ID_PIOABCDE},
     #endif
 #endif
 
 #if defined(AT91C_ID_PIOCDE)
-    // Treat PIOCDE interrupts
     #if !defined(AT91C_ID_PIOC)
-        PioInterruptHandler(AT91C_ID_PIOCDE, AT91C_BASE_PIOC);
+    {AT91C_BASE_PIOC, AT91C_ID_PIOCDE},
     #endif
     #if !defined(AT91C_ID_PIOD)
-        PioInterruptHandler(AT91C_ID_PIOCDE, AT91C_BASE_PIOD);
+    {AT91C_BASE_PIOD, AT91C_ID_PIOCDE},
     #endif
     #if !defined(AT91C_ID_PIOE)
-        PioInterruptHandler(AT91C_ID_PIOCDE, AT91C_BASE_PIOE);
+    {AT91C_BASE_PIOE, AT91C_ID_PIOCDE},
     #endif
 #endif
+};
+
+/// \exclude
+/// Number of PIO controllers handled.
+#define NUM_CONTROLLERS     (sizeof(controllers) / sizeof(Controller))
+
+/// Interrupt source of every pin of every controller, indexed by pin number.
+/// A source made of several pins fills the entries of all its pins.
+static InterruptSource pSources[NUM_CONTROLLERS][PINS_PER_CONTROLLER];
+
+/// Pin number of the lowest set bit, indexed by the five upper bits of that
+/// bit multiplied by DEBRUIJN.
+static const unsigned char pinNumbers[32] = {
+
+     0,  1, 28,  2, 29, 14, 24,  3, 30, 22, 20, 15, 25, 17,  4,  8,
+    31, 27, 13, 23, 21, 19, 16,  7, 26, 12, 18,  6, 11,  5, 10,  9
+};
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Returns the source table of the controller a pin belongs to.
+/// \param pPin  Pointer to a Pin instance.
+//------------------------------------------------------------------------------
+static InterruptSource * GetSources(const Pin *pPin)
+{
+    unsigned int i;
+
+    for (i = 0; i < NUM_CONTROLLERS; i++) {
+
+        if (controllers[i].pPio == pPin->pio) {
+
+            return pSources[i];
+        }
+    }
+    ASSERT(0, "-F- PIO_ConfigureIt: Unknown PIO controller\n\r");
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// Generic PIO interrupt handler. Single entry point for interrupts coming
+/// from any PIO controller (PIO A, B, C ...). Finds each pin that changed
+/// with a De Bruijn lookup on the lowest set bit of the status and jumps
+/// straight to its handler, so the time taken does not depend on how many
+/// sources are configured.
+//------------------------------------------------------------------------------
+static void InterruptHandler(void)
+{
+    const InterruptSource *pSource;
+    AT91S_PIO *pPio;
+    unsigned int i, status, pin;
+
+    for (i = 0; i < NUM_CONTROLLERS; i++) {
+
+        // Read PIO controller status
+        pPio = controllers[i].pPio;
+        status = pPio->PIO_ISR;
+        status &= pPio->PIO_IMR;
+
+        while (status != 0) {
+
+            pin = pinNumbers[((status & -status) * DEBRUIJN) >> 27];
+            pSource = &pSources[i][pin];
+
+            // There cannot be an unconfigured source enabled.
+            SANITY_CHECK(pSource->handler);
+
+            if (pSource->handler) {
+
+                pSource->handler(pSource->pPin);
+
+                // The handler serves all the pins of its source at once
+                status &= ~(pSource->pPin->mask);
+            }
+            status &= ~(1 << pin);
+        }
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -226,7 +256,7 @@ void PIO_InitializeInterrupts(unsigned int priority)
     SANITY_CHECK((priority & ~AT91C_AIC_PRIOR) == 0);
 
     // Reset sources
-    numSources = 0;
+    memset(pSources, 0, sizeof(pSources));
 
 #ifdef AT91C_ID_PIOA
     // Configure PIO interrupt sources
@@ -333,21 +363,25 @@ void PIO_InitializeInterrupts(unsigned int priority)
 //------------------------------------------------------------------------------
 void PIO_ConfigureIt(const Pin *pPin, void (*handler)(const Pin *))
 {
-    InterruptSource *pSource;
+    InterruptSource *pTable;
+    unsigned int pin;
 
     TRACE_DEBUG("PIO_ConfigureIt()\n\r");
 
     SANITY_CHECK(pPin);
-    ASSERT(numSources < MAX_INTERRUPT_SOURCES,
-           "-F- PIO_ConfigureIt: Increase MAX_INTERRUPT_SOURCES\n\r");
 
-    // Define new source
-    TRACE_DEBUG("PIO_ConfigureIt: Defining new source #%d.\n\r",  numSources);
+    // Define new source on all its pins
+    pTable = GetSources(pPin);
+    for (pin = 0; pin < PINS_PER_CONTROLLER; pin++) {
+
+        if ((pPin->mask & (1 << pin)) != 0) {
+
+            TRACE_DEBUG("PIO_ConfigureIt: Defining source on pin #%d.\n\r", pin);
 
-    pSource = &(pSources[numSources]);
-    pSource->pPin = pPin;
-    pSource->handler = handler;
-    numSources++;
+            pTable[pin].pPin = pPin;
+            pTable[pin].handler = handler;
+        }
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -363,15 +397,15 @@ void PIO_EnableIt(const Pin *pPin)
     SANITY_CHECK(pPin);
 
 #ifndef NOASSERT
-    unsigned int i = 0;
-    unsigned char found = 0;
-    while ((i < numSources) && !found) {
+    InterruptSource *pTable = GetSources(pPin);
+    unsigned int pin;
+    unsigned char found = 1;
+    for (pin = 0; pin < PINS_PER_CONTROLLER; pin++) {
 
-        if (pSources[i].pPin == pPin) {
+        if (((pPin->mask & (1 << pin)) != 0) && (pTable[pin].pPin != pPin)) {
 
-            found = 1;
+            found = 0;
         }
-        i++;
     }
     ASSERT(found, "-F- PIO_EnableIt: Interrupt source has not been configured\n\r");
 #endif
@@ -44,9 +44,11 @@
 /// in particular applications:
 ///    - It enables the clocks of all PIO controllers
 ///    - PIO controllers all share the same interrupt handler, which does the
-///      demultiplexing and can be slower than direct configuration
-///    - It reserves space for a fixed number of interrupts, which can be
-///      increased by modifying the appropriate constant in pio_it.c.
+///      demultiplexing and can be slower than direct configuration; it finds
+///      the handler of each changed pin with a table lookup, in a time that
+///      does not depend on the number of configured sources
+///    - It reserves a handler entry for every pin of every PIO controller
+///      (256 bytes per controller).
 ///
 /// !!!Usage
 /// 
@@ -241,6 +241,33 @@ unsigned char USART_ReadBuffer(AT91S_USART *usart,
     }
 }
 
+//------------------------------------------------------------------------------
+/// Keeps the PDC receiving into a ring of bytes, and publishes what it
+/// received since the last call; the USART is the producer of the ring. Call
+/// it from the loop or the ENDRX interrupt, often enough that the ring does
+/// not fill up.
+/// \param usart  Pointer to an USART peripheral.
+/// \param pRing  Ring of bytes.
+/// \return Number of bytes received.
+//------------------------------------------------------------------------------
+unsigned int USART_ReadRing(AT91S_USART *usart, Ring *pRing)
+{
+    return RING_ReceivePdc(pRing, (AT91PS_PDC) &(usart->US_RPR));
+}
+
+//------------------------------------------------------------------------------
+/// Keeps the PDC sending the bytes of a ring, and releases what it sent since
+/// the last call; the USART is the consumer of the ring. Call it after
+/// filling the ring, and from the loop or the ENDTX interrupt.
+/// \param usart  Pointer to an USART peripheral.
+/// \param pRing  Ring of bytes.
+/// \return Number of bytes sent.
+//------------------------------------------------------------------------------
+unsigned int USART_WriteRing(AT91S_USART *usart, Ring *pRing)
+{
+    return RING_TransmitPdc(pRing, (AT91PS_PDC) &(usart->US_TPR));
+}
+
 //------------------------------------------------------------------------------
 /// Returns 1 if some data has been received and can be read from an USART;
 /// otherwise returns 0.
@@ -45,6 +45,8 @@
 /// -# Receive data from the USART using the USART_Read and
 ///    USART_ReadBuffer functions; the availability of data can be polled
 ///    with USART_IsDataAvailable.
+/// -# Alternatively, stream data through rings (see ring.h) that the PDC
+///    fills and empties, with USART_ReadRing and USART_WriteRing.
 /// -# Disable the transmitter and/or the receiver of the USART with
 ///    USART_SetTransmitterEnabled and USART_SetReceiverEnabled.
 //------------------------------------------------------------------------------
@@ -57,6 +59,7 @@
 //------------------------------------------------------------------------------
 
 #include <board.h>
+#include <utility/ring.h>
 
 //------------------------------------------------------------------------------
 //         Definitions
@@ -110,6 +113,10 @@ extern unsigned char USART_ReadBuffer(
     void *buffer,
     unsigned int size);
 
+extern unsigned int USART_ReadRing(AT91S_USART *usart, Ring *pRing);
+
+extern unsigned int USART_WriteRing(AT91S_USART *usart, Ring *pRing);
+
 extern unsigned char USART_IsDataAvailable(AT91S_USART *usart);
 
 extern void USART_SetIrdaFilter(AT91S_USART *pUsart, unsigned char filter);
@@ -0,0 +1,451 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include "critical.h"
+#include <board.h>
+
+#if CRITICAL_PROFILE
+#include "timestamp.h"
+#include <stdio.h>
+#endif
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// Interrupt mask bits of the CPSR.
+#define CPSR_I                  0x80
+#define CPSR_IF                 0xC0
+
+#if CRITICAL_PROFILE
+
+//------------------------------------------------------------------------------
+//         Local types
+//------------------------------------------------------------------------------
+
+/// Sections entered from one call site.
+typedef struct {
+
+    /// Return address of the call that entered them, 0 if the entry is free.
+    void *pSite;
+
+    /// Sections, and those longer than CRITICAL_BUDGET_US.
+    unsigned int count;
+    unsigned int over;
+
+    /// Time they held the interrupts back in all, and the longest one, in
+    /// time stamp counts.
+    unsigned int total;
+    unsigned int max;
+
+} Site;
+
+/// Open section.
+typedef struct {
+
+    /// Site charged, 0 if the table was full.
+    Site *pSite;
+
+    /// Time stamp of the entry.
+    unsigned int start;
+
+} Section;
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+/// Sites seen, in the order they were first entered.
+static Site sites[CRITICAL_PROFILE_SITES];
+
+/// Sections not charged because the table was full.
+static unsigned int lost;
+
+/// Open sections, innermost last. Whatever interrupts a section leaves its
+/// own sections before returning, so they close in the reverse order.
+static Section sections[CRITICAL_PROFILE_DEPTH];
+static unsigned int depth;
+
+/// Time stamp of CRITICAL_Suspend().
+static unsigned int suspended;
+
+/// Copy of the sites that CRITICAL_PrintProfile() sorts and prints.
+static Site snapshot[CRITICAL_PROFILE_SITES];
+
+#endif //#if CRITICAL_PROFILE
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Masks the IRQ and returns the previous CPSR. An IRQ taken while the CPSR
+/// is being written may return with the I bit clear, so the write is checked.
+//------------------------------------------------------------------------------
+static unsigned int Lock(void)
+{
+    unsigned int cpsr, masked;
+
+    asm volatile (
+        "mrs    %0, cpsr        \n\t"
+        "1:                     \n\t"
+        "orr    %1, %0, %2      \n\t"
+        "msr    cpsr_c, %1      \n\t"
+        "mrs    %1, cpsr        \n\t"
+        "tst    %1, %2          \n\t"
+        "beq    1b              \n\t"
+        : "=&r" (cpsr), "=&r" (masked) : "I" (CPSR_I) : "memory", "cc");
+    return cpsr;
+}
+
+//------------------------------------------------------------------------------
+/// Restores the interrupt masks saved by Lock() or CRITICAL_Disable().
+//------------------------------------------------------------------------------
+static void Unlock(unsigned int cpsr)
+{
+    asm volatile ("msr    cpsr_c, %0" : : "r" (cpsr) : "memory", "cc");
+}
+
+#if CRITICAL_PROFILE
+
+//------------------------------------------------------------------------------
+/// Returns the entry of a site, taking a free one the first time, or 0 if
+/// the table is full. Called with the IRQ masked.
+//------------------------------------------------------------------------------
+static Site * Find(void *pSite)
+{
+    unsigned int i;
+
+    for (i = 0; i < CRITICAL_PROFILE_SITES; i++) {
+
+        if (sites[i].pSite == pSite) {
+
+            return &sites[i];
+        }
+        if (sites[i].pSite == 0) {
+
+            sites[i].pSite = pSite;
+            return &sites[i];
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// Opens a section entered from a site. Called with the IRQ masked, once the
+/// section has taken effect; the time stamp is read last, so the bookkeeping
+/// is not charged to the site.
+//------------------------------------------------------------------------------
+static void Enter(void *pSite)
+{
+    if (depth < CRITICAL_PROFILE_DEPTH) {
+
+        sections[depth].pSite = Find(pSite);
+        sections[depth].start = TIMESTAMP_Now();
+    }
+    depth++;
+}
+
+//------------------------------------------------------------------------------
+/// Closes the innermost section and charges its time to its site. Called
+/// with the IRQ masked, before the section ends.
+//------------------------------------------------------------------------------
+static void Leave(void)
+{
+    unsigned int time = TIMESTAMP_Now();
+    Site *pSite;
+
+    if (depth == 0) {
+
+        return;
+    }
+    depth--;
+    if (depth >= CRITICAL_PROFILE_DEPTH) {
+
+        return;
+    }
+
+    pSite = sections[depth].pSite;
+    if (pSite == 0) {
+
+        lost++;
+        return;
+    }
+    time -= sections[depth].start;
+    pSite->count++;
+    pSite->total += time;
+    if (time > pSite->max) {
+
+        pSite->max = time;
+    }
+    if (time > TIMESTAMP_US(CRITICAL_BUDGET_US)) {
+
+        pSite->over++;
+    }
+}
+
+#else
+
+#define Enter(pSite)
+#define Leave()
+
+#endif //#if CRITICAL_PROFILE
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Enters a priority ceiling section: disables the enabled interrupt sources
+/// of a priority at or below the ceiling, except the FIQ and the source
+/// routed to it.
+/// \param ceiling  AIC priority, from AT91C_AIC_PRIOR_LOWEST to
+///                 AT91C_AIC_PRIOR_HIGHEST.
+/// \return Sources disabled, for CRITICAL_Restore().
+//------------------------------------------------------------------------------
+unsigned int CRITICAL_Raise(unsigned int ceiling)
+{
+    unsigned int cpsr, enabled, bit, source;
+    unsigned int sources = 0;
+
+    // A handler must not change the enabled sources between the read of
+    // the mask and the write
+    cpsr = Lock();
+    enabled = AT91C_BASE_AIC->AIC_IMR & ~(1 << AT91C_ID_FIQ)
+              & ~AT91C_BASE_AIC->AIC_FFSR;
+    for (source = 0, bit = 1; enabled; source++, bit <<= 1) {
+
+        if ((enabled & bit)
+            && ((AT91C_BASE_AIC->AIC_SMR[source] & AT91C_AIC_PRIOR) <= ceiling)) {
+
+            sources |= bit;
+        }
+        enabled &= ~bit;
+    }
+    AT91C_BASE_AIC->AIC_IDCR = sources;
+    Enter(__builtin_return_address(0));
+    Unlock(cpsr);
+
+    return sources;
+}
+
+//------------------------------------------------------------------------------
+/// Leaves a priority ceiling section.
+/// \param sources  Sources disabled, returned by CRITICAL_Raise().
+//------------------------------------------------------------------------------
+void CRITICAL_Restore(unsigned int sources)
+{
+#if CRITICAL_PROFILE
+    unsigned int cpsr;
+
+    cpsr = Lock();
+    Leave();
+    AT91C_BASE_AIC->AIC_IECR = sources;
+    Unlock(cpsr);
+#else
+    AT91C_BASE_AIC->AIC_IECR = sources;
+#endif
+}
+
+//------------------------------------------------------------------------------
+/// Masks the IRQ like Lock() and returns the previous CPSR.
+//------------------------------------------------------------------------------
+unsigned int CRITICAL_Lock(void)
+{
+    unsigned int cpsr;
+
+    cpsr = Lock();
+    Enter(__builtin_return_address(0));
+    return cpsr;
+}
+
+//------------------------------------------------------------------------------
+/// Restores the IRQ mask saved by CRITICAL_Lock().
+/// \param cpsr  CPSR returned by CRITICAL_Lock().
+//------------------------------------------------------------------------------
+void CRITICAL_Unlock(unsigned int cpsr)
+{
+    Leave();
+    Unlock(cpsr);
+}
+
+//------------------------------------------------------------------------------
+/// Masks the IRQ and the FIQ and returns the previous CPSR, checking the
+/// write like CRITICAL_Lock().
+//------------------------------------------------------------------------------
+unsigned int CRITICAL_Disable(void)
+{
+    unsigned int cpsr, masked;
+
+    asm volatile (
+        "mrs    %0, cpsr        \n\t"
+        "1:                     \n\t"
+        "orr    %1, %0, %2      \n\t"
+        "msr    cpsr_c, %1      \n\t"
+        "mrs    %1, cpsr        \n\t"
+        "and    %1, %1, %2      \n\t"
+        "cmp    %1, %2          \n\t"
+        "bne    1b              \n\t"
+        : "=&r" (cpsr), "=&r" (masked) : "I" (CPSR_IF) : "memory", "cc");
+    Enter(__builtin_return_address(0));
+    return cpsr;
+}
+
+//------------------------------------------------------------------------------
+/// Restores the IRQ and FIQ masks saved by CRITICAL_Disable().
+/// \param cpsr  CPSR returned by CRITICAL_Disable().
+//------------------------------------------------------------------------------
+void CRITICAL_Enable(unsigned int cpsr)
+{
+    Leave();
+    Unlock(cpsr);
+}
+
+#if CRITICAL_PROFILE
+
+//------------------------------------------------------------------------------
+/// Charges the innermost open section to another site. A function that
+/// enters a section for its caller calls it right after, with its own
+/// return address, so the time goes to the caller.
+/// \param pSite  Site charged.
+//------------------------------------------------------------------------------
+void CRITICAL_SetSite(void *pSite)
+{
+    unsigned int cpsr;
+
+    cpsr = Lock();
+    if (depth > 0 && depth <= CRITICAL_PROFILE_DEPTH) {
+
+        sections[depth - 1].pSite = Find(pSite);
+    }
+    Unlock(cpsr);
+}
+
+//------------------------------------------------------------------------------
+/// Stops the clock of the open sections, while the core sleeps inside one
+/// waiting for an interrupt. Called with the IRQ masked, and followed by
+/// CRITICAL_Resume() before it is unmasked.
+//------------------------------------------------------------------------------
+void CRITICAL_Suspend(void)
+{
+    suspended = TIMESTAMP_Now();
+}
+
+//------------------------------------------------------------------------------
+/// Starts the clock of the open sections again, after CRITICAL_Suspend().
+//------------------------------------------------------------------------------
+void CRITICAL_Resume(void)
+{
+    unsigned int i;
+    unsigned int time = TIMESTAMP_Now() - suspended;
+
+    for (i = 0; i < depth && i < CRITICAL_PROFILE_DEPTH; i++) {
+
+        sections[i].start += time;
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Clears the statistics of every site. The sites stay in the table.
+//------------------------------------------------------------------------------
+void CRITICAL_ResetProfile(void)
+{
+    unsigned int cpsr, i;
+
+    cpsr = Lock();
+    for (i = 0; i < CRITICAL_PROFILE_SITES; i++) {
+
+        sites[i].count = 0;
+        sites[i].over = 0;
+        sites[i].total = 0;
+        sites[i].max = 0;
+    }
+    lost = 0;
+    Unlock(cpsr);
+}
+
+//------------------------------------------------------------------------------
+/// Prints the sites that held the interrupts back the longest, the worst
+/// first, with the number of their sections, the longest and the total time
+/// in microseconds, and the number of sections over the budget. The
+/// addresses are those of the instructions that follow the calls, to look up
+/// in the map file or with addr2line.
+/// \param count  Number of sites printed at most.
+//------------------------------------------------------------------------------
+void CRITICAL_PrintProfile(unsigned int count)
+{
+    unsigned int cpsr, i, j, sectionsLost;
+    Site site;
+
+    // Copied at once, the sites change as soon as the interrupts come back
+    cpsr = Lock();
+    for (i = 0; i < CRITICAL_PROFILE_SITES; i++) {
+
+        snapshot[i] = sites[i];
+    }
+    sectionsLost = lost;
+    Unlock(cpsr);
+
+    // Longest section first
+    for (i = 1; i < CRITICAL_PROFILE_SITES; i++) {
+
+        site = snapshot[i];
+        for (j = i; j > 0 && snapshot[j - 1].max < site.max; j--) {
+
+            snapshot[j] = snapshot[j - 1];
+        }
+        snapshot[j] = site;
+    }
+
+    printf("-- Critical sections, budget %u us --\n\r", CRITICAL_BUDGET_US);
+    printf("Site        Count    Max us  Total us  Over\n\r");
+    for (i = 0; i < CRITICAL_PROFILE_SITES && i < count; i++) {
+
+        if (snapshot[i].count == 0) {
+
+            break;
+        }
+        printf("0x%08X %7u %9u %9u %5u\n\r",
+               (unsigned int) snapshot[i].pSite,
+               snapshot[i].count,
+               TIMESTAMP_ToUs(snapshot[i].max),
+               TIMESTAMP_ToUs(snapshot[i].total),
+               snapshot[i].over);
+    }
+    if (sectionsLost) {
+
+        printf("-- %u sections lost, the table is full --\n\r", sectionsLost);
+    }
+}
+
+#endif //#if CRITICAL_PROFILE
@@ -0,0 +1,140 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+/// \unit
+///
+/// !!!Purpose
+///
+/// Critical sections of three strengths, which all nest.
+///
+/// A priority ceiling section only holds back the interrupt sources whose
+/// AIC priority is at or below the ceiling, that is the handlers and the
+/// tasks that share the data it protects: CRITICAL_Raise() disables the
+/// enabled ones through AIC_IDCR and CRITICAL_Restore() enables them again
+/// through AIC_IECR. The sources of a higher priority, and the FIQ with the
+/// source routed to it, keep running, so a long section at a low ceiling
+/// does not delay them. An inner section only disables the sources the
+/// outer ones left enabled, so each section gives back exactly what it
+/// took. The sources must not be
+/// enabled or disabled otherwise inside a section. A source disabled this
+/// way may have asserted the IRQ already, which then reads the spurious
+/// vector.
+///
+/// CRITICAL_Lock() masks the IRQ in the core, for the few instructions of a
+/// queue update that any handler may race; CRITICAL_Disable() masks the FIQ
+/// too, for what must be truly atomic, like programming the flash. Both
+/// return the previous CPSR, which the matching CRITICAL_Unlock() or
+/// CRITICAL_Enable() restores.
+///
+/// Built with CRITICAL_PROFILE set to 1, every section is timed on the time
+/// stamp from the moment it takes effect to the moment it ends, and charged
+/// to its call site, the return address of the call that entered it. Each
+/// site counts its sections, the longest one, the time they took in all and
+/// those longer than CRITICAL_BUDGET_US; CRITICAL_PrintProfile() prints the
+/// worst sites. The time the core sleeps inside a section, between
+/// CRITICAL_Suspend() and CRITICAL_Resume(), is not counted. Without the
+/// profile these three compile to nothing.
+///
+/// !!!Usage
+///
+/// -# Give CRITICAL_Raise() the highest AIC priority of the handlers that
+///    share the data, and the value it returns to CRITICAL_Restore(), from
+///    the program or an interrupt handler, never from the FIQ.
+/// -# Keep the sections of CRITICAL_Lock() and CRITICAL_Disable() short.
+/// -# A function that enters a section for its caller calls
+///    CRITICAL_SetSite() with its own return address right after, so the
+///    time goes to the caller.
+/// -# With the profile, sections must end in the reverse order they were
+///    entered, and none may be entered from the FIQ handler. Start the time
+///    stamp with TIMESTAMP_Initialize() before the first section.
+//------------------------------------------------------------------------------
+
+#ifndef CRITICAL_H
+#define CRITICAL_H
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Times the sections when 1.
+#if !defined(CRITICAL_PROFILE)
+#define CRITICAL_PROFILE 0
+#endif
+
+/// Call sites the profile tells apart, and sections open at once it times.
+#if !defined(CRITICAL_PROFILE_SITES)
+#define CRITICAL_PROFILE_SITES 32
+#endif
+#if !defined(CRITICAL_PROFILE_DEPTH)
+#define CRITICAL_PROFILE_DEPTH 8
+#endif
+
+/// Longest time, in microseconds, a section should hold the interrupts back.
+#if !defined(CRITICAL_BUDGET_US)
+#define CRITICAL_BUDGET_US 50
+#endif
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern unsigned int CRITICAL_Raise(unsigned int ceiling);
+
+extern void CRITICAL_Restore(unsigned int sources);
+
+extern unsigned int CRITICAL_Lock(void);
+
+extern void CRITICAL_Unlock(unsigned int cpsr);
+
+extern unsigned int CRITICAL_Disable(void);
+
+extern void CRITICAL_Enable(unsigned int cpsr);
+
+#if CRITICAL_PROFILE
+
+extern void CRITICAL_SetSite(void *pSite);
+
+extern void CRITICAL_Suspend(void);
+
+extern void CRITICAL_Resume(void);
+
+extern void CRITICAL_ResetProfile(void);
+
+extern void CRITICAL_PrintProfile(unsigned int count);
+
+#else
+
+#define CRITICAL_SetSite(pSite)
+#define CRITICAL_Suspend()
+#define CRITICAL_Resume()
+
+#endif //#if CRITICAL_PROFILE
+
+#endif //#ifndef CRITICAL_H
@@ -0,0 +1,177 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include "dpc.h"
+#include "critical.h"
+#include "timestamp.h"
+#include <board.h>
+#include <aic/aic.h>
+
+//------------------------------------------------------------------------------
+//         Local types
+//------------------------------------------------------------------------------
+
+/// Queued call.
+typedef struct {
+
+    Dpc *pDpc;
+    void *pArgument;
+
+} Call;
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+/// Queued calls. Handlers of every level queue, so the head only moves with
+/// the interrupts masked; only DPC_Run() moves the tail.
+static Call queue[DPC_QUEUE_SIZE];
+static volatile unsigned int head;
+static volatile unsigned int tail;
+
+/// Interrupt source that runs the calls, DPC_POLLED if none.
+static unsigned int dpcSource;
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Interrupt handler of the DPC source.
+//------------------------------------------------------------------------------
+static void ISR_Dpc(void)
+{
+    DPC_Run();
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Empties the queue and sets where the DPCs run.
+/// \param source  Interrupt source (AT91C_ID_xxx) of a peripheral that is not
+///                used, configured at the lowest priority to run the DPCs,
+///                or DPC_POLLED if the main program runs them.
+//------------------------------------------------------------------------------
+void DPC_Initialize(unsigned int source)
+{
+    head = tail = 0;
+    dpcSource = source;
+    if (source != DPC_POLLED) {
+
+        // Edge triggered, so setting the source pending latches it
+        AIC_ConfigureIT(source,
+                        AT91C_AIC_SRCTYPE_INT_POSITIVE_EDGE
+                        | AT91C_AIC_PRIOR_LOWEST,
+                        ISR_Dpc);
+        AIC_EnableIT(source);
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Sets the function of a DPC and clears its statistics. The DPC must not be
+/// queued.
+/// \param pDpc  DPC.
+/// \param handler  Function called.
+//------------------------------------------------------------------------------
+void DPC_Create(Dpc *pDpc, DpcHandler handler)
+{
+    pDpc->handler = handler;
+    pDpc->calls = 0;
+    pDpc->lost = 0;
+    pDpc->total = 0;
+    pDpc->max = 0;
+}
+
+//------------------------------------------------------------------------------
+/// Queues a call of a DPC, from an interrupt handler or the program. A DPC
+/// may be queued several times, with different arguments.
+/// \param pDpc  DPC.
+/// \param pArgument  Argument given to its function.
+/// \return 1 if the call was queued, 0 if the queue is full.
+//------------------------------------------------------------------------------
+unsigned char DPC_Queue(Dpc *pDpc, void *pArgument)
+{
+    unsigned int cpsr;
+
+    cpsr = CRITICAL_Lock();
+    if (head - tail >= DPC_QUEUE_SIZE) {
+
+        pDpc->lost++;
+        CRITICAL_Unlock(cpsr);
+        return 0;
+    }
+    queue[head % DPC_QUEUE_SIZE].pDpc = pDpc;
+    queue[head % DPC_QUEUE_SIZE].pArgument = pArgument;
+    head++;
+    CRITICAL_Unlock(cpsr);
+
+    if (dpcSource != DPC_POLLED) {
+
+        AT91C_BASE_AIC->AIC_ISCR = 1 << dpcSource;
+    }
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Runs the queued calls, including the ones queued meanwhile, and times
+/// them. Must only run at one level: from the DPC interrupt, or from the
+/// main program with DPC_POLLED.
+/// \return 1 if a call ran.
+//------------------------------------------------------------------------------
+unsigned char DPC_Run(void)
+{
+    Call call;
+    unsigned int start, time;
+    unsigned char ran = 0;
+
+    while (tail != head) {
+
+        call = queue[tail % DPC_QUEUE_SIZE];
+        tail++;
+
+        start = TIMESTAMP_Now();
+        call.pDpc->handler(call.pArgument);
+        time = TIMESTAMP_Now() - start;
+
+        call.pDpc->calls++;
+        call.pDpc->total += time;
+        if (time > call.pDpc->max) {
+
+            call.pDpc->max = time;
+        }
+        ran = 1;
+    }
+    return ran;
+}
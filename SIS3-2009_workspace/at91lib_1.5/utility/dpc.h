@@ -0,0 +1,108 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+/// \unit
+///
+/// !!!Purpose
+///
+/// Deferred procedure calls: the bottom half of interrupt handlers. A
+/// handler only acknowledges its peripheral, captures the little state the
+/// rest of the work needs, and queues a DPC with that state as argument;
+/// the DPC does the rest later, with every interrupt enabled, so the handler
+/// holds the interrupts of its level and below back for microseconds
+/// instead of the length of the work.
+///
+/// The queued DPCs run in the order they were queued, either from an
+/// interrupt at the lowest AIC priority, set pending by DPC_Queue() through
+/// AIC_ISCR on the source of a peripheral that is not used, or from the
+/// main program, which calls DPC_Run(). Each DPC counts its calls, the time
+/// they took on the time stamp, and the calls lost to a full queue.
+///
+/// !!!Usage
+///
+/// -# Start the time stamp with TIMESTAMP_Initialize(), then call
+///    DPC_Initialize() with the interrupt source that runs the DPCs, or
+///    DPC_POLLED.
+/// -# Create each DPC with DPC_Create(), once.
+/// -# Queue DPCs with DPC_Queue(), from interrupt handlers or the program.
+/// -# With DPC_POLLED, call DPC_Run() from the main loop, and from any loop
+///    that waits for the result of a DPC.
+//------------------------------------------------------------------------------
+
+#ifndef DPC_H
+#define DPC_H
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Calls the queue holds, a power of two.
+#define DPC_QUEUE_SIZE          16
+
+/// DPC_Initialize() source for DPCs that the main program runs.
+#define DPC_POLLED              0
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// Function of a DPC, called with the argument it was queued with.
+typedef void (*DpcHandler)(void *pArgument);
+
+/// DPC, owned by the caller, and its statistics.
+typedef struct {
+
+    /// Function called.
+    DpcHandler handler;
+
+    /// Calls run, and lost to a full queue.
+    unsigned int calls;
+    unsigned int lost;
+
+    /// Time the calls took in all, and the longest one, in time stamp
+    /// counts (TIMESTAMP_FREQUENCY).
+    unsigned int total;
+    unsigned int max;
+
+} Dpc;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void DPC_Initialize(unsigned int source);
+
+extern void DPC_Create(Dpc *pDpc, DpcHandler handler);
+
+extern unsigned char DPC_Queue(Dpc *pDpc, void *pArgument);
+
+extern unsigned char DPC_Run(void);
+
+#endif //#ifndef DPC_H
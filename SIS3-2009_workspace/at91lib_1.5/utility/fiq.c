@@ -0,0 +1,94 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include "fiq.h"
+#include <board.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// FIQ mode with the IRQ and the FIQ masked.
+#define CPSR_FIQ_MASKED         0xD1
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Routes an interrupt source to the FIQ and loads the banked registers the
+/// vector calls the handler with. The source is disabled and cleared; it
+/// must be enabled by a call to AIC_EnableIT().
+/// \param source  Interrupt source (AT91C_ID_xxx), or AT91C_ID_FIQ for the
+///                FIQ pin.
+/// \param mode  Triggering mode of the source (AT91C_AIC_SRCTYPE_xxx); the
+///              priority does not apply.
+/// \param handler  Fast interrupt handler.
+/// \param pArgument  Argument given to the handler.
+/// \param state  State given to the first call of the handler.
+//------------------------------------------------------------------------------
+void FIQ_Configure(
+    unsigned int source,
+    unsigned int mode,
+    FiqHandler handler,
+    void *pArgument,
+    unsigned int state)
+{
+    register unsigned int r0 asm("r0") = state;
+    register FiqHandler r1 asm("r1") = handler;
+    register void *r2 asm("r2") = pArgument;
+
+    // Disable the source first, then route it alone to the FIQ
+    AT91C_BASE_AIC->AIC_IDCR = 1 << source;
+    AT91C_BASE_AIC->AIC_FFDR = ~0;
+    if (source != AT91C_ID_FIQ) {
+
+        AT91C_BASE_AIC->AIC_FFER = 1 << source;
+    }
+    AT91C_BASE_AIC->AIC_SMR[source] = mode & AT91C_AIC_SRCTYPE;
+
+    // The banked registers are only reached from the FIQ mode, and only r0
+    // to r7 are shared with it, so the values go through them
+    asm volatile (
+        "mrs    r3, cpsr        \n\t"
+        "msr    cpsr_c, %3      \n\t"
+        "mov    r8, %0          \n\t"
+        "mov    r9, %1          \n\t"
+        "mov    r10, %2         \n\t"
+        "msr    cpsr_c, r3      \n\t"
+        : : "r" (r0), "r" (r1), "r" (r2), "I" (CPSR_FIQ_MASKED)
+        : "r3", "memory", "cc");
+
+    // Clear interrupt
+    AT91C_BASE_AIC->AIC_ICCR = 1 << source;
+}
@@ -0,0 +1,86 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+/// \unit
+///
+/// !!!Purpose
+///
+/// Fast interrupt of one source, for the highest rate handler of a program,
+/// like an audio sample or a control period.
+///
+/// The AIC routes the source to the FIQ by fast forcing, and the core runs
+/// the FIQ code right in the vector table of board_cstartup.S, in SRAM,
+/// without reading the AIC vector, switching to Supervisor mode or writing
+/// AIC_EOICR. The FIQ mode has its own r8 to r12, which keep their values
+/// between two fast interrupts: r8 holds the state of the handler, r9 the
+/// handler and r10 its argument. The vector only saves r0-r3 and the return
+/// address, calls the handler with the state and the argument, and keeps
+/// the state it returns in r8 for the next call, so a handler that keeps
+/// its state in that word costs tens of cycles instead of the full IRQ
+/// entry path.
+///
+/// The handler runs with the IRQ and the FIQ masked; it must not enter
+/// priority ceiling sections, and shares data with the rest of the program
+/// through single writes, the lock-free rings of ring.h, or sections of
+/// CRITICAL_Disable(), which is the only one that holds it back.
+///
+/// !!!Usage
+///
+/// -# Configure the source with FIQ_Configure(), once, with the previous
+///    fast source disabled.
+/// -# Enable it with AIC_EnableIT(), and clear the F bit of the CPSR like
+///    ENABLE_INTERRUPTS does.
+/// -# In the handler, acknowledge the peripheral, and clear an edge
+///    triggered source through AIC_ICCR.
+//------------------------------------------------------------------------------
+
+#ifndef FIQ_H
+#define FIQ_H
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// Fast interrupt handler, called with the state it returned the previous
+/// time, and the argument it was configured with; returns the new state.
+typedef unsigned int (*FiqHandler)(unsigned int state, void *pArgument);
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void FIQ_Configure(
+    unsigned int source,
+    unsigned int mode,
+    FiqHandler handler,
+    void *pArgument,
+    unsigned int state);
+
+#endif //#ifndef FIQ_H
@@ -0,0 +1,566 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include "loop.h"
+#include "critical.h"
+#include <board.h>
+#include <pit/pit.h>
+#include <pmc/pmc.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// PIT counts a period must still have left to be stretched or shortened:
+/// it must not end between the read of the counter and the write of the new
+/// period.
+#define PIT_MARGIN              64
+
+//------------------------------------------------------------------------------
+//         Local types
+//------------------------------------------------------------------------------
+
+/// Posted event.
+typedef struct {
+
+    LoopHandler handler;
+    void *pArgument;
+
+} Event;
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+/// Ticks counted by LOOP_Tick().
+static volatile unsigned int ticks;
+
+/// Event queue. Several interrupt handlers may post, so both ends are only
+/// moved with the interrupts masked.
+static Event queue[LOOP_QUEUE_SIZE];
+static volatile unsigned int head;
+static volatile unsigned int tail;
+
+/// Timing wheel, and the timers already due that run on the next passes.
+/// Only the loop touches them.
+static LoopTimer *wheel[LOOP_WHEEL_LEVELS][LOOP_WHEEL_SLOTS];
+static LoopTimer *pDue;
+
+/// Next tick the wheel reaches, and the level it still has a slot to move
+/// down from at that tick, 0 once only the first level is left.
+static unsigned int wheelTime;
+static unsigned int cascade;
+
+/// Timers started.
+static unsigned int timers;
+
+/// Called when there is nothing to do.
+static void (*pIdleHook)(void);
+
+/// PIT counts per tick, read from the PIT on first use.
+static unsigned int period;
+
+/// Ticks the current PIT period is worth, more than 1 while it is stretched,
+/// and how many of them LOOP_Tick() does not need to count any more.
+static volatile unsigned int stretch = 1;
+static volatile unsigned int credited;
+
+/// Time spent idle and wake ups since the last LOOP_GetLoad(), and the time
+/// it was called.
+static unsigned int idleTime;
+static unsigned int wakeups;
+static unsigned int loadStart;
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Returns the PIT counts per tick.
+//------------------------------------------------------------------------------
+static unsigned int Period(void)
+{
+    if (period == 0) {
+
+        period = (PIT_GetMode() & AT91C_PITC_PIV) + 1;
+    }
+    return period;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the time in PIT counts, modulo 2^32. Must be called with the
+/// interrupts masked.
+//------------------------------------------------------------------------------
+static unsigned int Now(void)
+{
+    unsigned int piir = PIT_GetPIIR();
+
+    // The counter runs from the start of the current period, which the tick
+    // count reaches once the periods not counted yet and the ticks counted
+    // ahead are taken into account
+    return (ticks - credited + (piir >> 20) * stretch) * Period()
+           + (piir & AT91C_PITC_CPIV);
+}
+
+//------------------------------------------------------------------------------
+/// Returns the highest level with a slot to move down when the wheel reaches
+/// a tick: level n turns over every 2^(n * LOOP_WHEEL_BITS) ticks.
+//------------------------------------------------------------------------------
+static unsigned int Cascade(unsigned int time)
+{
+    unsigned int level = 0;
+
+    while (level < LOOP_WHEEL_LEVELS - 1
+           && (time & ((1 << ((level + 1) * LOOP_WHEEL_BITS)) - 1)) == 0) {
+
+        level++;
+    }
+    return level;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the slot of a level the wheel is in at a given time.
+//------------------------------------------------------------------------------
+static LoopTimer **Slot(unsigned int level, unsigned int time)
+{
+    return &wheel[level][(time >> (level * LOOP_WHEEL_BITS))
+                         & (LOOP_WHEEL_SLOTS - 1)];
+}
+
+//------------------------------------------------------------------------------
+/// Puts a timer at the head of a list.
+//------------------------------------------------------------------------------
+static void Link(LoopTimer **ppList, LoopTimer *pTimer)
+{
+    pTimer->pNext = *ppList;
+    pTimer->ppPrev = ppList;
+    if (*ppList) {
+
+        (*ppList)->ppPrev = &pTimer->pNext;
+    }
+    *ppList = pTimer;
+}
+
+//------------------------------------------------------------------------------
+/// Takes a timer out of its list.
+//------------------------------------------------------------------------------
+static void Unlink(LoopTimer *pTimer)
+{
+    *pTimer->ppPrev = pTimer->pNext;
+    if (pTimer->pNext) {
+
+        pTimer->pNext->ppPrev = pTimer->ppPrev;
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Puts a timer in the slot of its expiry, on the lowest level that reaches
+/// that far from the tick the wheel is at, or with the due ones.
+//------------------------------------------------------------------------------
+static void Insert(LoopTimer *pTimer)
+{
+    unsigned int expires = pTimer->expires;
+    unsigned int ahead = expires - wheelTime;
+    unsigned int level = 0;
+
+    if ((int) ahead < 0) {
+
+        Link(&pDue, pTimer);
+        return;
+    }
+    if (ahead >= 1 << (LOOP_WHEEL_LEVELS * LOOP_WHEEL_BITS)) {
+
+        // Out of range: parked in the last slot the wheel reaches
+        ahead = (1 << (LOOP_WHEEL_LEVELS * LOOP_WHEEL_BITS)) - 1;
+        expires = wheelTime + ahead;
+    }
+    while (ahead >> ((level + 1) * LOOP_WHEEL_BITS)) {
+
+        level++;
+    }
+    Link(Slot(level, expires), pTimer);
+}
+
+//------------------------------------------------------------------------------
+/// Tells whether the wheel has to catch up with the tick count, or a timer
+/// is due.
+//------------------------------------------------------------------------------
+static unsigned char IsBehind(void)
+{
+    return pDue || (int) (ticks - wheelTime) >= 0;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the ticks until the loop has work again, from a wheel caught up
+/// with the tick count: until a timer expires, or timers move down a level.
+/// \param limit  Ticks looked ahead at most.
+/// \return Ticks, from 1 to the limit.
+//------------------------------------------------------------------------------
+static unsigned int Ahead(unsigned int limit)
+{
+    unsigned int time = wheelTime;
+    unsigned int level = cascade;
+
+    if (timers == 0) {
+
+        return limit;
+    }
+    while (time - ticks < limit) {
+
+        while (level && !*Slot(level, time)) {
+
+            level--;
+        }
+        if (level || *Slot(0, time)) {
+
+            break;
+        }
+        time++;
+        level = Cascade(time);
+    }
+    return time - ticks;
+}
+
+//------------------------------------------------------------------------------
+/// Runs the oldest posted event.
+/// \return 1 if there was one.
+//------------------------------------------------------------------------------
+static unsigned char Dispatch(void)
+{
+    Event event;
+    unsigned int cpsr;
+
+    cpsr = CRITICAL_Lock();
+    if (tail == head) {
+
+        CRITICAL_Unlock(cpsr);
+        return 0;
+    }
+    event = queue[tail % LOOP_QUEUE_SIZE];
+    tail++;
+    CRITICAL_Unlock(cpsr);
+
+    event.handler(event.pArgument);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Runs a timer, after starting its next period.
+//------------------------------------------------------------------------------
+static void Run(LoopTimer *pTimer)
+{
+    Unlink(pTimer);
+    if (pTimer->period) {
+
+        // Counted from the expiry, the period does not drift with the time
+        // the handlers take
+        pTimer->expires += pTimer->period;
+        Insert(pTimer);
+    }
+    else {
+
+        pTimer->active = 0;
+        timers--;
+    }
+    pTimer->handler(pTimer->pArgument);
+}
+
+//------------------------------------------------------------------------------
+/// Brings the wheel closer to the tick count, and runs the first timer that
+/// expired on the way.
+/// \return 1 if a timer ran or the wheel is still behind.
+//------------------------------------------------------------------------------
+static unsigned char Expire(void)
+{
+    unsigned int work = LOOP_WHEEL_WORK;
+    LoopTimer *pTimer;
+
+    if (pDue) {
+
+        Run(pDue);
+        return 1;
+    }
+    while ((int) (ticks - wheelTime) >= 0) {
+
+        if (work-- == 0) {
+
+            return 1;
+        }
+        if (cascade) {
+
+            // Down from the slot of the level turning over, one timer at a
+            // time, before the first level slot of that tick runs
+            pTimer = *Slot(cascade, wheelTime);
+            if (pTimer) {
+
+                Unlink(pTimer);
+                Insert(pTimer);
+            }
+            else {
+
+                cascade--;
+            }
+        }
+        else if ((pTimer = *Slot(0, wheelTime)) != 0) {
+
+            Run(pTimer);
+            return 1;
+        }
+        else {
+
+            wheelTime++;
+            cascade = Cascade(wheelTime);
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Empties the event queue and the timing wheel.
+/// \param pIdle  Function called, with the interrupts masked, when there is
+///               nothing to do; it should return once an interrupt is
+///               pending. 0 to spin.
+//------------------------------------------------------------------------------
+void LOOP_Initialize(void (*pIdle)(void))
+{
+    unsigned int level, slot;
+
+    head = tail = 0;
+    for (level = 0; level < LOOP_WHEEL_LEVELS; level++) {
+
+        for (slot = 0; slot < LOOP_WHEEL_SLOTS; slot++) {
+
+            wheel[level][slot] = 0;
+        }
+    }
+    pDue = 0;
+    wheelTime = ticks;
+    cascade = Cascade(wheelTime);
+    timers = 0;
+    pIdleHook = pIdle;
+}
+
+//------------------------------------------------------------------------------
+/// Advances the time of the timers. Must be called from one periodic
+/// interrupt handler.
+/// \param periods  Periods elapsed since the last call, usually 1.
+//------------------------------------------------------------------------------
+void LOOP_Tick(unsigned int periods)
+{
+    ticks += periods * stretch - credited;
+    if (stretch != 1) {
+
+        // Back to one tick per period
+        PIT_SetPIV(period - 1);
+        stretch = 1;
+        credited = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Returns the ticks counted since the start.
+//------------------------------------------------------------------------------
+unsigned int LOOP_GetTicks(void)
+{
+    return ticks;
+}
+
+//------------------------------------------------------------------------------
+/// Posts an event, from an interrupt handler or from the loop.
+/// \param handler  Function the loop calls.
+/// \param pArgument  Argument given to the handler.
+/// \return 1 if the event was queued, 0 if the queue is full.
+//------------------------------------------------------------------------------
+unsigned char LOOP_Post(LoopHandler handler, void *pArgument)
+{
+    unsigned int cpsr;
+
+    cpsr = CRITICAL_Lock();
+    if (head - tail >= LOOP_QUEUE_SIZE) {
+
+        CRITICAL_Unlock(cpsr);
+        return 0;
+    }
+    queue[head % LOOP_QUEUE_SIZE].handler = handler;
+    queue[head % LOOP_QUEUE_SIZE].pArgument = pArgument;
+    head++;
+    CRITICAL_Unlock(cpsr);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Starts a timer, or restarts it if it is already started. Must be called
+/// from the loop (a handler) or before LOOP_Run().
+/// \param pTimer  Timer.
+/// \param handler  Function called when the timer expires.
+/// \param pArgument  Argument given to the handler.
+/// \param delay  Ticks before the first expiry, 0 for the next pass of the
+///               loop.
+/// \param period  Ticks between the next expiries, 0 for a one-shot timer.
+//------------------------------------------------------------------------------
+void LOOP_StartTimer(
+    LoopTimer *pTimer,
+    LoopHandler handler,
+    void *pArgument,
+    unsigned int delay,
+    unsigned int period)
+{
+    LOOP_StopTimer(pTimer);
+    pTimer->handler = handler;
+    pTimer->pArgument = pArgument;
+    pTimer->expires = ticks + delay;
+    pTimer->period = period;
+    pTimer->active = 1;
+    timers++;
+    Insert(pTimer);
+}
+
+//------------------------------------------------------------------------------
+/// Stops a timer; does nothing if it is not started. Must be called from the
+/// loop.
+/// \param pTimer  Timer.
+//------------------------------------------------------------------------------
+void LOOP_StopTimer(LoopTimer *pTimer)
+{
+    if (!pTimer->active) {
+
+        return;
+    }
+    Unlink(pTimer);
+    pTimer->active = 0;
+    timers--;
+}
+
+//------------------------------------------------------------------------------
+/// Runs the posted events and the expired timers, one at a time, and idles
+/// in between. Never returns.
+//------------------------------------------------------------------------------
+void LOOP_Run(void)
+{
+    unsigned int cpsr, start;
+
+    while (1) {
+
+        // Events first, a timer can always wait for the next pass
+        if (Dispatch() || Expire()) {
+
+            continue;
+        }
+
+        // Checked again with the interrupts masked: an event posted or a
+        // tick counted now wakes the idle hook up instead of being missed
+        cpsr = CRITICAL_Lock();
+        if (tail == head && !IsBehind() && pIdleHook) {
+
+            start = Now();
+            CRITICAL_Suspend();
+            pIdleHook();
+            CRITICAL_Resume();
+            idleTime += Now() - start;
+            wakeups++;
+        }
+        CRITICAL_Unlock(cpsr);
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Idle hook that stops the core until the next interrupt, and stretches the
+/// PIT period to the next timer deadline so that no tick interrupt comes
+/// before. Give it to LOOP_Initialize().
+//------------------------------------------------------------------------------
+void LOOP_IdleTickless(void)
+{
+    unsigned int piir, elapsed, count, end;
+
+    // Ticks to sleep, as many as one PIT period can hold
+    count = Ahead((AT91C_PITC_PIV + 1) / Period());
+
+    // A pending tick or a period about to end is left alone, and so is a
+    // period still being shortened after the previous wake up
+    piir = PIT_GetPIIR();
+    elapsed = piir & AT91C_PITC_CPIV;
+    if (count > 1 && stretch == 1 && (piir >> 20) == 0
+        && period - elapsed > PIT_MARGIN) {
+
+        PIT_SetPIV(count * period - 1);
+        stretch = count;
+    }
+
+    PMC_DisableProcessorClock();
+
+    // Woken up before the deadline: count the ticks slept now, and end the
+    // period at the next tick boundary, where LOOP_Tick() counts the rest
+    piir = PIT_GetPIIR();
+    if (stretch != 1 && credited == 0 && (piir >> 20) == 0) {
+
+        elapsed = piir & AT91C_PITC_CPIV;
+        end = elapsed / period + 1;
+        if (end * period - elapsed <= PIT_MARGIN) {
+
+            end++;
+        }
+
+        // Unless the deadline is that close anyway
+        if (end < stretch) {
+
+            PIT_SetPIV(end * period - 1);
+            credited = end - 1;
+            ticks += credited;
+            stretch = end;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Returns the load of the core since the previous call, and starts a new
+/// measurement.
+/// \param pLoad  Time elapsed, time idle and number of wake ups.
+//------------------------------------------------------------------------------
+void LOOP_GetLoad(LoopLoad *pLoad)
+{
+    unsigned int cpsr, now;
+
+    cpsr = CRITICAL_Lock();
+    now = Now();
+    pLoad->total = now - loadStart;
+    pLoad->idle = idleTime;
+    pLoad->wakeups = wakeups;
+    loadStart = now;
+    idleTime = 0;
+    wakeups = 0;
+    CRITICAL_Unlock(cpsr);
+}
@@ -0,0 +1,176 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+/// \unit
+///
+/// !!!Purpose
+///
+/// Cooperative, run-to-completion event loop with software timers, instead
+/// of main loops that poll and burn the time left in busy waits.
+///
+/// Work reaches the loop in two ways:
+///    - events posted with LOOP_Post(), from an interrupt handler or from
+///      the loop itself, run in the order they were posted;
+///    - timers started with LOOP_StartTimer() run once after a delay, or
+///      periodically, counted in ticks of a periodic interrupt such as the
+///      PIT, which calls LOOP_Tick().
+/// Each handler runs to completion before the next one starts, so handlers
+/// share data and peripherals (the LCD, for example) without locking; only
+/// data written by interrupt handlers still needs care.
+///
+/// The timers sit in a hierarchical timing wheel: LOOP_WHEEL_LEVELS levels
+/// of LOOP_WHEEL_SLOTS lists, the first one slot per tick, each next one
+/// slot per turn of the level below. Starting and stopping a timer takes
+/// the same few steps whatever the number of timers started. When the first
+/// level turns over, the timers of the next slot above move down to the
+/// level where they belong, so a timer moves at most once per level. The
+/// loop does at most LOOP_WHEEL_WORK of these moves and empty slot steps per
+/// pass before it checks the events again, so a burst of timers never holds
+/// back an event; LOOP_Tick() itself only counts, and adds no jitter to the
+/// interrupt that calls it. Timers that expire at the same tick run in no
+/// particular order.
+///
+/// When no event is pending and no timer is due, the loop calls the idle
+/// hook with the interrupts masked, so nothing posted between the check and
+/// the hook is missed. PMC_DisableProcessorClock() makes a good hook: the
+/// core stops until the next interrupt, which is served as soon as the loop
+/// unmasks the interrupts again.
+///
+/// LOOP_IdleTickless() also stops the core, and saves the PIT interrupts
+/// that would only count ticks: it stretches the current PIT period to the
+/// next timer deadline (at most 2^20 PIT counts, 350 ms at 48 MHz), so the
+/// core sleeps through it in one piece. An interrupt that wakes the core up
+/// earlier ends the stretched period at the next tick boundary; the tick
+/// count stays exact either way. Code that counts the PIT interrupts itself,
+/// instead of running from a loop timer, sees fewer of them.
+///
+/// The loop measures the time spent in the idle hook against the PIT, so
+/// LOOP_GetLoad() tells how busy the core was and how often it woke up.
+///
+/// !!!Usage
+///
+/// -# Call LOOP_Initialize() with the idle hook, or 0 to spin.
+/// -# Call LOOP_Tick() from the PIT interrupt with the number of periods
+///    elapsed (the PICNT field of the PIT value register).
+/// -# Start timers with LOOP_StartTimer(), post events with LOOP_Post().
+/// -# Call LOOP_Run(), which never returns.
+//------------------------------------------------------------------------------
+
+#ifndef LOOP_H
+#define LOOP_H
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Events the queue holds, a power of two.
+#define LOOP_QUEUE_SIZE         16
+
+/// Levels of the timing wheel, and slots per level as a power of two. A
+/// timer further ahead than the wheel covers (2^20 ticks, almost 3 hours at
+/// 100 Hz) waits in the last slot of the last level until it comes in range.
+#define LOOP_WHEEL_LEVELS       4
+#define LOOP_WHEEL_BITS         5
+#define LOOP_WHEEL_SLOTS        (1 << LOOP_WHEEL_BITS)
+
+/// Timer moves and empty slot steps the loop makes per pass at most.
+#define LOOP_WHEEL_WORK         16
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// Event or timer handler.
+typedef void (*LoopHandler)(void *pArgument);
+
+/// Software timer, owned by the caller; its fields belong to the loop while
+/// it is started.
+typedef struct _LoopTimer {
+
+    /// Next timer in the same slot, and the pointer to this one.
+    struct _LoopTimer *pNext;
+    struct _LoopTimer **ppPrev;
+
+    /// Function called when the timer expires, and its argument.
+    LoopHandler handler;
+    void *pArgument;
+
+    /// Tick count the timer expires at.
+    unsigned int expires;
+
+    /// Period in ticks, 0 for a one-shot timer.
+    unsigned int period;
+
+    /// 1 while the timer is started.
+    unsigned char active;
+
+} LoopTimer;
+
+/// Load of the core since the previous LOOP_GetLoad(), in PIT counts
+/// (MCK / 16); the counts wrap after 2^32, 23 minutes at 48 MHz.
+typedef struct {
+
+    /// Time elapsed, and spent in the idle hook.
+    unsigned int total;
+    unsigned int idle;
+
+    /// Calls of the idle hook, each ended by an interrupt.
+    unsigned int wakeups;
+
+} LoopLoad;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void LOOP_Initialize(void (*pIdle)(void));
+
+extern void LOOP_Tick(unsigned int periods);
+
+extern unsigned int LOOP_GetTicks(void);
+
+extern unsigned char LOOP_Post(LoopHandler handler, void *pArgument);
+
+extern void LOOP_StartTimer(
+    LoopTimer *pTimer,
+    LoopHandler handler,
+    void *pArgument,
+    unsigned int delay,
+    unsigned int period);
+
+extern void LOOP_StopTimer(LoopTimer *pTimer);
+
+extern void LOOP_Run(void);
+
+extern void LOOP_IdleTickless(void);
+
+extern void LOOP_GetLoad(LoopLoad *pLoad);
+
+#endif //#ifndef LOOP_H
@@ -0,0 +1,176 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include "prng.h"
+
+//------------------------------------------------------------------------------
+//         Local macros
+//------------------------------------------------------------------------------
+
+/// Rotates a 32-bit value left.
+#define ROTL(x, k)      (((x) << (k)) | ((x) >> (32 - (k))))
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Advances a splitmix32 sequence and returns its next output. Only used to
+/// expand a seed into a full generator state.
+/// \param pX  Sequence state.
+//------------------------------------------------------------------------------
+static unsigned int SplitMix32(unsigned int *pX)
+{
+    unsigned int z;
+
+    *pX += 0x9E3779B9;
+    z = *pX;
+    z = (z ^ (z >> 16)) * 0x85EBCA6B;
+    z = (z ^ (z >> 13)) * 0xC2B2AE35;
+    return z ^ (z >> 16);
+}
+
+//------------------------------------------------------------------------------
+//         Exported functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Seeds a generator stream. The same seed and stream always give the same
+/// sequence.
+/// \param pPrng  Generator stream.
+/// \param seed  Seed value, any value is valid.
+/// \param stream  Stream number, distinguishes generators sharing a seed.
+//------------------------------------------------------------------------------
+void PRNG_Seed(Prng *pPrng, unsigned int seed, unsigned int stream)
+{
+    unsigned int x = seed;
+    unsigned int i;
+
+    // Mix the stream number in before expanding, so that (seed, stream)
+    // pairs do not map to shifted copies of one sequence
+    x ^= SplitMix32(&stream);
+    for (i = 0; i < 4; i++) {
+
+        pPrng->s[i] = SplitMix32(&x);
+    }
+
+    // The all-zero state is the only invalid one
+    if ((pPrng->s[0] | pPrng->s[1] | pPrng->s[2] | pPrng->s[3]) == 0) {
+
+        pPrng->s[0] = 1;
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Returns the next 32-bit value of a stream.
+/// \param pPrng  Generator stream.
+//------------------------------------------------------------------------------
+unsigned int PRNG_Next(Prng *pPrng)
+{
+    unsigned int *s = pPrng->s;
+    unsigned int result = ROTL(s[1] * 5, 7) * 9;
+    unsigned int t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = ROTL(s[3], 11);
+
+    return result;
+}
+
+//------------------------------------------------------------------------------
+/// Returns a uniformly distributed value in [0, n), without division on the
+/// normal path (Lemire's multiply-shift with rejection).
+/// \param pPrng  Generator stream.
+/// \param n  Number of possible values, must not be 0.
+//------------------------------------------------------------------------------
+unsigned int PRNG_Range(Prng *pPrng, unsigned int n)
+{
+    unsigned long long m = (unsigned long long) PRNG_Next(pPrng) * n;
+    unsigned int low = (unsigned int) m;
+    unsigned int threshold;
+
+    // Values whose low word falls under 2^32 mod n are over-represented and
+    // drawn again. The modulo only runs when low < n, that is with a
+    // probability of n / 2^32.
+    if (low < n) {
+
+        threshold = -n % n;
+        while (low < threshold) {
+
+            m = (unsigned long long) PRNG_Next(pPrng) * n;
+            low = (unsigned int) m;
+        }
+    }
+    return (unsigned int) (m >> 32);
+}
+
+//------------------------------------------------------------------------------
+/// Empties a bag, the next draw refills and shuffles it.
+/// \param pBag  Bag to initialize.
+//------------------------------------------------------------------------------
+void PRNG_BagInit(PrngBag *pBag)
+{
+    pBag->count = 0;
+}
+
+//------------------------------------------------------------------------------
+/// Draws the next value of a bag, refilling it with a fresh Fisher-Yates
+/// shuffle of 0..PRNG_BAG_SIZE-1 when it is empty.
+/// \param pPrng  Generator stream used for the shuffle.
+/// \param pBag  Bag to draw from.
+//------------------------------------------------------------------------------
+unsigned int PRNG_BagNext(Prng *pPrng, PrngBag *pBag)
+{
+    unsigned int i, j, tmp;
+
+    if (pBag->count == 0) {
+
+        for (i = 0; i < PRNG_BAG_SIZE; i++) {
+
+            pBag->values[i] = i;
+        }
+        for (i = PRNG_BAG_SIZE - 1; i > 0; i--) {
+
+            j = PRNG_Range(pPrng, i + 1);
+            tmp = pBag->values[i];
+            pBag->values[i] = pBag->values[j];
+            pBag->values[j] = tmp;
+        }
+        pBag->count = PRNG_BAG_SIZE;
+    }
+    return pBag->values[--pBag->count];
+}
@@ -0,0 +1,105 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+/// \unit
+///
+/// !!!Purpose
+///
+/// Fast pseudo-random number generator, as a replacement for rand.c.
+///
+/// The generator is xoshiro128** (period 2^128 - 1). It only uses shifts,
+/// rotations, XORs and multiplications by 5 and 9, which compile to shift and
+/// add instructions on the ARM7, and needs no division.
+///
+/// Every #Prng structure is an independent stream: PRNG_Seed() spreads a
+/// seed and a stream number over the 128-bit state with splitmix32, so two
+/// streams seeded with the same seed and different stream numbers (or the
+/// other way round) produce unrelated sequences. A module that owns its
+/// stream is not disturbed by other modules drawing numbers, which keeps
+/// recorded sessions reproducible.
+///
+/// !!!Usage
+///
+/// -# Seed a stream with PRNG_Seed().
+/// -# Draw 32-bit values with PRNG_Next(), or values in [0, n) with
+///    PRNG_Range(). PRNG_Range() maps the value with a 32x32->64 multiply and
+///    rejects the few values that would bias the result.
+/// -# For piece sequences, initialize a #PrngBag with PRNG_BagInit() and draw
+///    from it with PRNG_BagNext(): every run of PRNG_BAG_SIZE draws returns
+///    each value 0..PRNG_BAG_SIZE-1 exactly once.
+//------------------------------------------------------------------------------
+
+#ifndef PRNG_H
+#define PRNG_H
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Number of values in a bag.
+#define PRNG_BAG_SIZE   7
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// Generator stream.
+typedef struct {
+
+    unsigned int s[4];
+
+} Prng;
+
+/// Shuffled bag of PRNG_BAG_SIZE values.
+typedef struct {
+
+    /// Values left in the bag, drawn from the end.
+    unsigned char values[PRNG_BAG_SIZE];
+
+    /// Number of values left.
+    unsigned char count;
+
+} PrngBag;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void PRNG_Seed(Prng *pPrng, unsigned int seed, unsigned int stream);
+
+extern unsigned int PRNG_Next(Prng *pPrng);
+
+extern unsigned int PRNG_Range(Prng *pPrng, unsigned int n);
+
+extern void PRNG_BagInit(PrngBag *pBag);
+
+extern unsigned int PRNG_BagNext(Prng *pPrng, PrngBag *pBag);
+
+#endif //#ifndef PRNG_H
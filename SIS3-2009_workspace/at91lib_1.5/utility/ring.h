@@ -0,0 +1,416 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+/// \unit
+///
+/// !!!Purpose
+///
+/// Single producer, single consumer ring buffers, to move data between an
+/// interrupt handler, or a PDC, and the main program without any critical
+/// section.
+///
+/// The ring holds a power of two elements of any size. The producer only
+/// writes the head index and the consumer only the tail index, both free
+/// running, and each publishes its index with a single store of an aligned
+/// word once the elements are written or read, which is atomic on the ARM7.
+/// Either side may thus be interrupted by the other at any point.
+///
+/// Besides the copies of RING_Push() and RING_Pop(), the free space and the
+/// data can be used in place: RING_WriteRegion() and RING_ReadRegion() give
+/// the contiguous part of them, up to the end of the buffer, and
+/// RING_Produce() and RING_Consume() publish what was written or read.
+/// RING_ReceivePdc() and RING_TransmitPdc() hand these regions to a PDC, for
+/// a ring that the PDC fills or empties.
+///
+/// !!!Usage
+///
+/// -# Declare a ring with RING_DECLARE(), or give RING_Initialize() a buffer
+///    of a power of two elements.
+/// -# The producer calls RING_Push(), or RING_WriteRegion() then
+///    RING_Produce(); the consumer RING_Pop(), or RING_ReadRegion() then
+///    RING_Consume(). Each side must only be used from one place at a time.
+/// -# For a PDC, call RING_ReceivePdc() or RING_TransmitPdc() from the loop
+///    or from the end of transfer interrupt, as the producer or consumer.
+//------------------------------------------------------------------------------
+
+#ifndef RING_H
+#define RING_H
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include <board.h>
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Keeps the compiler from moving the accesses to the elements across the
+/// store of an index.
+#define RING_BARRIER()          asm volatile ("" : : : "memory")
+
+/// Declares a ring named name of capacity elements of the given type, and its
+/// buffer; the capacity must be a power of two, or the buffer does not build.
+#define RING_DECLARE(name, type, capacity) \
+    static type name##Buffer[((capacity) & ((capacity) - 1)) ? -1 : (capacity)]; \
+    static Ring name = {(unsigned char *) name##Buffer, (capacity) - 1, \
+                        sizeof(type), 0, 0}
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// Ring buffer, owned by the caller.
+typedef struct {
+
+    /// Elements, and their number less one, the capacity being a power of
+    /// two.
+    unsigned char *pBuffer;
+    unsigned int mask;
+
+    /// Size of an element, in bytes.
+    unsigned int elementSize;
+
+    /// Elements written and read since the start, only changed by the
+    /// producer and the consumer respectively.
+    volatile unsigned int head;
+    volatile unsigned int tail;
+
+} Ring;
+
+//------------------------------------------------------------------------------
+//         Inline functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Sets up an empty ring.
+/// \param pRing  Ring.
+/// \param pBuffer  Buffer of the elements.
+/// \param capacity  Elements the buffer holds, a power of two.
+/// \param elementSize  Size of an element, in bytes.
+//------------------------------------------------------------------------------
+static inline void RING_Initialize(
+    Ring *pRing,
+    void *pBuffer,
+    unsigned int capacity,
+    unsigned int elementSize)
+{
+    pRing->pBuffer = (unsigned char *) pBuffer;
+    pRing->mask = capacity - 1;
+    pRing->elementSize = elementSize;
+    pRing->head = pRing->tail = 0;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the number of elements in a ring.
+/// \param pRing  Ring.
+//------------------------------------------------------------------------------
+static inline unsigned int RING_Count(const Ring *pRing)
+{
+    return pRing->head - pRing->tail;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the number of elements a ring has room for.
+/// \param pRing  Ring.
+//------------------------------------------------------------------------------
+static inline unsigned int RING_Space(const Ring *pRing)
+{
+    return pRing->mask + 1 - (pRing->head - pRing->tail);
+}
+
+//------------------------------------------------------------------------------
+/// Gives the free space of a ring that is contiguous from the head, for the
+/// producer.
+/// \param pRing  Ring.
+/// \param ppData  Where to store the address of the free space.
+/// \return Number of elements that can be written there.
+//------------------------------------------------------------------------------
+static inline unsigned int RING_WriteRegion(const Ring *pRing, void **ppData)
+{
+    unsigned int head = pRing->head;
+    unsigned int index = head & pRing->mask;
+    unsigned int space = pRing->mask + 1 - (head - pRing->tail);
+    unsigned int length = pRing->mask + 1 - index;
+
+    *ppData = pRing->pBuffer + index * pRing->elementSize;
+    return (space < length) ? space : length;
+}
+
+//------------------------------------------------------------------------------
+/// Publishes elements written to the free space, for the producer.
+/// \param pRing  Ring.
+/// \param count  Number of elements written, at most what RING_WriteRegion()
+///               returned.
+//------------------------------------------------------------------------------
+static inline void RING_Produce(Ring *pRing, unsigned int count)
+{
+    RING_BARRIER();
+    pRing->head += count;
+}
+
+//------------------------------------------------------------------------------
+/// Gives the elements of a ring that are contiguous from the tail, for the
+/// consumer.
+/// \param pRing  Ring.
+/// \param ppData  Where to store the address of the elements.
+/// \return Number of elements that can be read there.
+//------------------------------------------------------------------------------
+static inline unsigned int RING_ReadRegion(const Ring *pRing, void **ppData)
+{
+    unsigned int tail = pRing->tail;
+    unsigned int index = tail & pRing->mask;
+    unsigned int count = pRing->head - tail;
+    unsigned int length = pRing->mask + 1 - index;
+
+    *ppData = pRing->pBuffer + index * pRing->elementSize;
+    return (count < length) ? count : length;
+}
+
+//------------------------------------------------------------------------------
+/// Releases elements read, for the consumer.
+/// \param pRing  Ring.
+/// \param count  Number of elements read, at most what RING_ReadRegion()
+///               returned.
+//------------------------------------------------------------------------------
+static inline void RING_Consume(Ring *pRing, unsigned int count)
+{
+    RING_BARRIER();
+    pRing->tail += count;
+}
+
+//------------------------------------------------------------------------------
+/// Copies elements into a ring, as many as it has room for.
+/// \param pRing  Ring.
+/// \param pData  Elements.
+/// \param count  Number of elements.
+/// \return Number of elements copied.
+//------------------------------------------------------------------------------
+static inline unsigned int RING_Push(
+    Ring *pRing,
+    const void *pData,
+    unsigned int count)
+{
+    const unsigned char *pSource = (const unsigned char *) pData;
+    unsigned char *pDestination;
+    unsigned int done = 0, length, size;
+
+    // At most two regions, before and after the end of the buffer
+    while (done < count) {
+
+        length = RING_WriteRegion(pRing, (void **) &pDestination);
+        if (length == 0) {
+
+            break;
+        }
+        if (length > count - done) {
+
+            length = count - done;
+        }
+        for (size = length * pRing->elementSize; size > 0; size--) {
+
+            *pDestination++ = *pSource++;
+        }
+        RING_Produce(pRing, length);
+        done += length;
+    }
+    return done;
+}
+
+//------------------------------------------------------------------------------
+/// Copies elements out of a ring, as many as it holds.
+/// \param pRing  Ring.
+/// \param pData  Destination of the elements.
+/// \param count  Number of elements wanted.
+/// \return Number of elements copied.
+//------------------------------------------------------------------------------
+static inline unsigned int RING_Pop(Ring *pRing, void *pData, unsigned int count)
+{
+    unsigned char *pDestination = (unsigned char *) pData;
+    const unsigned char *pSource;
+    unsigned int done = 0, length, size;
+
+    while (done < count) {
+
+        length = RING_ReadRegion(pRing, (void **) &pSource);
+        if (length == 0) {
+
+            break;
+        }
+        if (length > count - done) {
+
+            length = count - done;
+        }
+        for (size = length * pRing->elementSize; size > 0; size--) {
+
+            *pDestination++ = *pSource++;
+        }
+        RING_Consume(pRing, length);
+        done += length;
+    }
+    return done;
+}
+
+//------------------------------------------------------------------------------
+/// Produces what the receive channel of a PDC wrote into a ring, and keeps
+/// both of its banks on the free space, as the producer. The PDC counts in
+/// elements, which must be of 1, 2 or 4 bytes, and it always leaves one
+/// free so that its pointer tells how much it wrote.
+/// \param pRing  Ring.
+/// \param pPdc  PDC of the peripheral.
+/// \return Number of elements received.
+//------------------------------------------------------------------------------
+static inline unsigned int RING_ReceivePdc(Ring *pRing, AT91PS_PDC pPdc)
+{
+    unsigned int shift = pRing->elementSize >> 1;
+    unsigned int capacity = pRing->mask + 1;
+    unsigned int pointer, counter, nextCounter;
+    unsigned int offset, received = 0, free, start, length;
+
+    // Every transfer moves the pointer, so the counters read while it stays
+    // still go with it
+    do {
+        pointer = pPdc->PDC_RPR;
+        counter = pPdc->PDC_RCR;
+        nextCounter = pPdc->PDC_RNCR;
+    }
+    while (pointer != pPdc->PDC_RPR);
+
+    offset = (pointer - (unsigned int) pRing->pBuffer) >> shift;
+    if (offset <= capacity) {
+
+        received = (offset - pRing->head) & pRing->mask;
+        RING_Produce(pRing, received);
+    }
+    else {
+
+        // The PDC was not given this ring yet
+        offset = pRing->head;
+        counter = nextCounter = 0;
+    }
+
+    // Give the next free region to the first bank that is idle
+    if (nextCounter == 0) {
+
+        start = (offset + counter) & pRing->mask;
+        free = RING_Space(pRing) - 1;
+        free = (free > counter) ? free - counter : 0;
+        length = capacity - start;
+        if (free < length) {
+
+            length = free;
+        }
+        if (length > 0) {
+
+            if (pPdc->PDC_RCR == 0) {
+
+                pPdc->PDC_RPR = (unsigned int) (pRing->pBuffer + (start << shift));
+                pPdc->PDC_RCR = length;
+            }
+            else {
+
+                pPdc->PDC_RNPR = (unsigned int) (pRing->pBuffer + (start << shift));
+                pPdc->PDC_RNCR = length;
+            }
+            pPdc->PDC_PTCR = AT91C_PDC_RXTEN;
+        }
+    }
+    return received;
+}
+
+//------------------------------------------------------------------------------
+/// Consumes what the transmit channel of a PDC sent from a ring, and keeps
+/// both of its banks on the data left, as the consumer. The PDC counts in
+/// elements, which must be of 1, 2 or 4 bytes, and is never given the whole
+/// ring at once so that its pointer tells how much it sent.
+/// \param pRing  Ring.
+/// \param pPdc  PDC of the peripheral.
+/// \return Number of elements sent.
+//------------------------------------------------------------------------------
+static inline unsigned int RING_TransmitPdc(Ring *pRing, AT91PS_PDC pPdc)
+{
+    unsigned int shift = pRing->elementSize >> 1;
+    unsigned int capacity = pRing->mask + 1;
+    unsigned int pointer, counter, nextCounter;
+    unsigned int offset, sent = 0, start, length, limit;
+
+    do {
+        pointer = pPdc->PDC_TPR;
+        counter = pPdc->PDC_TCR;
+        nextCounter = pPdc->PDC_TNCR;
+    }
+    while (pointer != pPdc->PDC_TPR);
+
+    offset = (pointer - (unsigned int) pRing->pBuffer) >> shift;
+    if (offset <= capacity) {
+
+        sent = (offset - pRing->tail) & pRing->mask;
+        RING_Consume(pRing, sent);
+    }
+    else {
+
+        offset = pRing->tail;
+        counter = nextCounter = 0;
+    }
+
+    if (nextCounter == 0) {
+
+        start = (offset + counter) & pRing->mask;
+        length = RING_Count(pRing);
+        length = (length > counter) ? length - counter : 0;
+        limit = capacity - start;
+        if (limit + counter > pRing->mask) {
+
+            limit = pRing->mask - counter;
+        }
+        if (length > limit) {
+
+            length = limit;
+        }
+        if (length > 0) {
+
+            if (pPdc->PDC_TCR == 0) {
+
+                pPdc->PDC_TPR = (unsigned int) (pRing->pBuffer + (start << shift));
+                pPdc->PDC_TCR = length;
+            }
+            else {
+
+                pPdc->PDC_TNPR = (unsigned int) (pRing->pBuffer + (start << shift));
+                pPdc->PDC_TNCR = length;
+            }
+            pPdc->PDC_PTCR = AT91C_PDC_TXTEN;
+        }
+    }
+    return sent;
+}
+
+#endif //#ifndef RING_H
@@ -0,0 +1,140 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include "sst.h"
+#include "critical.h"
+#include <board.h>
+#include <aic/aic.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// Interrupt sources of the AIC.
+#define SST_SOURCES             32
+
+/// Source number of the interrupt being served, in AIC_ISR.
+#define AIC_ISR_IRQID           0x1F
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+/// Task of each interrupt source.
+static SstTask *pTasks[SST_SOURCES];
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Interrupt handler of every task source: runs the events queued for the
+/// task of the source being served, until the queue is empty. Events posted
+/// meanwhile set the source pending again, which only costs an empty pass.
+//------------------------------------------------------------------------------
+static void Dispatch(void)
+{
+    SstTask *pTask = pTasks[AT91C_BASE_AIC->AIC_ISR & AIC_ISR_IRQID];
+    void *pEvent;
+
+    while (pTask->tail != pTask->head) {
+
+        pEvent = pTask->pQueue[pTask->tail & (pTask->size - 1)];
+        pTask->tail++;
+        pTask->handler(pEvent);
+    }
+}
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Creates a task and enables its interrupt source.
+/// \param pTask  Task.
+/// \param source  Interrupt source (AT91C_ID_xxx) of a peripheral that is not
+///                used, so that only SST_Post() sets it pending.
+/// \param priority  AIC priority, from AT91C_AIC_PRIOR_LOWEST to
+///                  AT91C_AIC_PRIOR_HIGHEST.
+/// \param handler  Function called for each event.
+/// \param pQueue  Queue of the events.
+/// \param size  Events the queue holds, a power of two.
+//------------------------------------------------------------------------------
+void SST_CreateTask(
+    SstTask *pTask,
+    unsigned int source,
+    unsigned int priority,
+    SstHandler handler,
+    void **pQueue,
+    unsigned int size)
+{
+    pTask->handler = handler;
+    pTask->pQueue = pQueue;
+    pTask->size = size;
+    pTask->head = pTask->tail = 0;
+    pTask->source = source;
+    pTasks[source] = pTask;
+
+    // Edge triggered, so setting the source pending latches it until the
+    // dispatcher is called
+    AIC_ConfigureIT(source,
+                    AT91C_AIC_SRCTYPE_INT_POSITIVE_EDGE
+                    | (priority & AT91C_AIC_PRIOR),
+                    Dispatch);
+    AIC_EnableIT(source);
+}
+
+//------------------------------------------------------------------------------
+/// Posts an event to a task. The task runs once the poster returns, or
+/// right away if it has a higher priority than the poster.
+/// \param pTask  Task.
+/// \param pEvent  Event given to the task handler.
+/// \return 1 if the event was queued, 0 if the queue is full.
+//------------------------------------------------------------------------------
+unsigned char SST_Post(SstTask *pTask, void *pEvent)
+{
+    unsigned int cpsr;
+
+    cpsr = CRITICAL_Lock();
+    if (pTask->head - pTask->tail >= pTask->size) {
+
+        CRITICAL_Unlock(cpsr);
+        return 0;
+    }
+    pTask->pQueue[pTask->head & (pTask->size - 1)] = pEvent;
+    pTask->head++;
+    CRITICAL_Unlock(cpsr);
+
+    AT91C_BASE_AIC->AIC_ISCR = 1 << pTask->source;
+    return 1;
+}
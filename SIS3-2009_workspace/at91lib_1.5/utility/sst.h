@@ -0,0 +1,106 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+/// \unit
+///
+/// !!!Purpose
+///
+/// Preemptive, run-to-completion tasks on the priority levels of the AIC,
+/// in the manner of the Super Simple Tasker: no task has a stack of its own,
+/// and there is no scheduler besides the AIC itself.
+///
+/// Each task is given an interrupt source that its peripheral does not use
+/// (TC2 or SSC, for example), and the priority of that source. Posting an
+/// event to a task queues it and sets the source pending through AIC_ISCR;
+/// the AIC then calls the dispatcher of the task as soon as nothing of the
+/// same or a higher priority runs, and the dispatcher hands the queued
+/// events to the task handler one after the other. As board_cstartup.S runs
+/// the interrupt handlers in Supervisor mode with the interrupts enabled, a
+/// task of higher priority, or an interrupt, preempts a task the same way
+/// it would preempt the main program, on the same stack, so a control task
+/// at a high level runs in time even while a long LCD render goes on in the
+/// main loop, which is the idle task below every level.
+///
+/// A task handler must return; it shares data with the tasks of other
+/// levels like an interrupt handler does. Interrupt handlers configured at
+/// a higher priority than a task preempt it too.
+///
+/// !!!Usage
+///
+/// -# Give every task a queue of a power of two entries, and create it with
+///    SST_CreateTask(), with its interrupt source and AIC priority.
+/// -# Post events with SST_Post(), from the main program, an interrupt
+///    handler or another task.
+//------------------------------------------------------------------------------
+
+#ifndef SST_H
+#define SST_H
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// Task handler, called once per event posted.
+typedef void (*SstHandler)(void *pEvent);
+
+/// Task, owned by the caller.
+typedef struct {
+
+    /// Function that handles the events.
+    SstHandler handler;
+
+    /// Queue of the events posted, and its size, a power of two. Several
+    /// levels may post, so the head only moves with the interrupts masked;
+    /// only the task moves the tail.
+    void **pQueue;
+    unsigned int size;
+    volatile unsigned int head;
+    volatile unsigned int tail;
+
+    /// Interrupt source that activates the task.
+    unsigned int source;
+
+} SstTask;
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void SST_CreateTask(
+    SstTask *pTask,
+    unsigned int source,
+    unsigned int priority,
+    SstHandler handler,
+    void **pQueue,
+    unsigned int size);
+
+extern unsigned char SST_Post(SstTask *pTask, void *pEvent);
+
+#endif //#ifndef SST_H
@@ -0,0 +1,154 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include "timestamp.h"
+#include "assert.h"
+#include <tc/tc.h>
+#include <pmc/pmc.h>
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// TC0 counts on each side of its wrap during which TC1 may or may not have
+/// counted the turn yet: TIOA0 rises when TC0 reaches 0xFFFF, and goes
+/// through the synchronisation of the XC1 input before TC1 counts the edge.
+#define TIMESTAMP_LAG           4
+
+/// Reads of the counters before TIMESTAMP_Now() gives up. A running TC0
+/// leaves the wrap window within a few reads; a stopped one reads 0, inside
+/// it, forever.
+#define TIMESTAMP_RETRIES       64
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Configures TC0 and TC1 as a 32-bit counter at MCK / 2 and starts it from 0.
+//------------------------------------------------------------------------------
+void TIMESTAMP_Initialize(void)
+{
+    AT91S_TC *pLow = AT91C_BASE_TC0;
+    AT91S_TC *pHigh = AT91C_BASE_TC1;
+
+    PMC_EnablePeripheral(AT91C_ID_TC0);
+    PMC_EnablePeripheral(AT91C_ID_TC1);
+
+    // TC0 wraps at RC, setting TIOA0 there and clearing it half way
+    TC_Configure(pLow, AT91C_TC_CLKS_TIMER_DIV1_CLOCK
+                       | AT91C_TC_WAVE
+                       | AT91C_TC_WAVESEL_UP_AUTO
+                       | AT91C_TC_ACPA_CLEAR
+                       | AT91C_TC_ACPC_SET);
+    pLow->TC_RA = 0x8000;
+    pLow->TC_RC = 0xFFFF;
+
+    // TC1 counts the rising edges of TIOA0
+    AT91C_BASE_TCB->TCB_BMR = (AT91C_BASE_TCB->TCB_BMR & ~AT91C_TCB_TC1XC1S)
+                              | AT91C_TCB_TC1XC1S_TIOA0;
+    TC_Configure(pHigh, AT91C_TC_CLKS_XC1);
+
+    // Enable both clocks, then reset both counters at once
+    pLow->TC_CCR = AT91C_TC_CLKEN;
+    pHigh->TC_CCR = AT91C_TC_CLKEN;
+    AT91C_BASE_TCB->TCB_BCR = AT91C_TCB_SYNC;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the time stamp, in MCK / 2 counts since TIMESTAMP_Initialize().
+/// The high half is read again until it did not change around the read of
+/// the low half; the few counts around the wrap of TC0 are waited out, TC1
+/// counts the turn somewhere among them. If the counters are not running,
+/// TIMESTAMP_Initialize() was not called: the sanity check fails, or without
+/// it the frozen value is returned rather than waiting forever.
+//------------------------------------------------------------------------------
+unsigned int TIMESTAMP_Now(void)
+{
+    unsigned int high;
+    unsigned int low;
+    unsigned int retries = TIMESTAMP_RETRIES;
+
+    do {
+        high = AT91C_BASE_TC1->TC_CV;
+        low = AT91C_BASE_TC0->TC_CV;
+        if (--retries == 0) {
+
+            SANITY_CHECK((AT91C_BASE_TC0->TC_SR & AT91C_TC_CLKSTA) != 0);
+            break;
+        }
+    }
+    while ((low < TIMESTAMP_LAG)
+           || (low > 0xFFFF - TIMESTAMP_LAG)
+           || (high != AT91C_BASE_TC1->TC_CV));
+
+    return (high << 16) | low;
+}
+
+//------------------------------------------------------------------------------
+/// Converts time stamp counts to microseconds.
+/// \param counts  Interval between two time stamps.
+/// \return Microseconds, rounded down.
+//------------------------------------------------------------------------------
+unsigned int TIMESTAMP_ToUs(unsigned int counts)
+{
+    return counts / (TIMESTAMP_FREQUENCY / 1000000);
+}
+
+//------------------------------------------------------------------------------
+/// Waits until the time stamp reaches a deadline; returns at once if it is
+/// already past, by less than 2^31 counts.
+/// \param deadline  Time stamp to wait for.
+//------------------------------------------------------------------------------
+void TIMESTAMP_WaitUntil(unsigned int deadline)
+{
+    while ((int) (TIMESTAMP_Now() - deadline) < 0);
+}
+
+//------------------------------------------------------------------------------
+/// Waits for a number of microseconds, up to 89 seconds at 48 MHz.
+/// \param us  Microseconds to wait.
+//------------------------------------------------------------------------------
+void TIMESTAMP_WaitUs(unsigned int us)
+{
+    TIMESTAMP_WaitUntil(TIMESTAMP_Now() + TIMESTAMP_US(us));
+}
+
+//------------------------------------------------------------------------------
+/// Waits for a number of milliseconds, up to 89 seconds at 48 MHz.
+/// \param ms  Milliseconds to wait.
+//------------------------------------------------------------------------------
+void TIMESTAMP_WaitMs(unsigned int ms)
+{
+    TIMESTAMP_WaitUntil(TIMESTAMP_Now() + TIMESTAMP_MS(ms));
+}
@@ -0,0 +1,93 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support 
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+/// \unit
+///
+/// !!!Purpose
+///
+/// Free-running 32-bit time stamp at MCK / 2 (24 MHz, 24 counts per
+/// microsecond at 48 MHz) built on two chained Timer Counters, and busy
+/// waits that run to a deadline on it instead of counting loop iterations.
+///
+/// TC0 counts MCK / 2 from 0 to 0xFFFF and raises TIOA0 once per turn; TC1,
+/// clocked by TIOA0 through XC1, counts the turns. Reading both counters
+/// takes a few bus accesses and no interrupt, so the time stamp works with
+/// the interrupts masked and from any interrupt handler. It wraps after
+/// 2^32 counts (179 s at 48 MHz): compare time stamps by subtracting them,
+/// and keep the intervals measured or waited shorter than half of that.
+///
+/// !!!Usage
+///
+/// -# Call TIMESTAMP_Initialize() once, before anything waits or measures
+///    time; it uses TC0 and TC1 and enables their peripheral clocks.
+/// -# Read the time with TIMESTAMP_Now(), convert intervals to microseconds
+///    with TIMESTAMP_ToUs(), and durations to counts with TIMESTAMP_US()
+///    and TIMESTAMP_MS().
+/// -# Wait with TIMESTAMP_WaitUs() or TIMESTAMP_WaitMs(), or with
+///    TIMESTAMP_WaitUntil() to keep a series of waits free of drift.
+//------------------------------------------------------------------------------
+
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include <board.h>
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Time stamp counts per second.
+#define TIMESTAMP_FREQUENCY     (BOARD_MCK / 2)
+
+/// Counts in a duration given in microseconds or milliseconds.
+#define TIMESTAMP_US(us)        ((us) * (TIMESTAMP_FREQUENCY / 1000000))
+#define TIMESTAMP_MS(ms)        ((ms) * (TIMESTAMP_FREQUENCY / 1000))
+
+//------------------------------------------------------------------------------
+//         Global functions
+//------------------------------------------------------------------------------
+
+extern void TIMESTAMP_Initialize(void);
+
+extern unsigned int TIMESTAMP_Now(void);
+
+extern unsigned int TIMESTAMP_ToUs(unsigned int counts);
+
+extern void TIMESTAMP_WaitUntil(unsigned int deadline);
+
+extern void TIMESTAMP_WaitUs(unsigned int us);
+
+extern void TIMESTAMP_WaitMs(unsigned int ms);
+
+#endif //#ifndef TIMESTAMP_H